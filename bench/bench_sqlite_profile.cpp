@@ -0,0 +1,130 @@
+// SQLite amalgamation throughput under one compile profile. bench/CMakeLists.txt builds this
+// once per profile (bench_sqlite_profile_default, bench_sqlite_profile_perf) so the two runs
+// differ only in the options from src/sqlite/driver/sqlite_profiles.cmake. Statements are
+// prepared per call, as SQLite::executeQuery does.
+//
+//   bench_sqlite_profile [rows] [queries_per_thread]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sqlite3.h"
+
+#ifndef BENCH_SQLITE_PROFILE
+#define BENCH_SQLITE_PROFILE "unknown"
+#endif
+
+namespace {
+    const std::string kPath = std::string("bench_profile_") + BENCH_SQLITE_PROFILE + ".db";
+
+    sqlite3* openDb(int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) {
+        sqlite3* db = nullptr;
+        sqlite3_open_v2(kPath.c_str(), &db, flags, nullptr);
+        sqlite3_busy_timeout(db, 5000);
+        return db;
+    }
+
+    // Prepares, binds the integers, steps to the end and finalizes; returns rows read
+    int runStatement(sqlite3* db, const char* sql, const std::vector<long long>& ints = {},
+                     const std::string* text = nullptr) {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+            std::fprintf(stderr, "prepare failed: %s\n", sqlite3_errmsg(db));
+            return 0;
+        }
+        int param = 1;
+        for (long long value : ints) sqlite3_bind_int64(stmt, param++, value);
+        if (text)
+            sqlite3_bind_text(stmt, param, text->c_str(), -1, SQLITE_TRANSIENT);
+        int rows = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            for (int c = 0; c < sqlite3_column_count(stmt); ++c) sqlite3_column_text(stmt, c);
+            ++rows;
+        }
+        sqlite3_finalize(stmt);
+        return rows;
+    }
+
+    double opsPerSecond(int ops, const std::function<void()>& work) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return ops / elapsed.count();
+    }
+
+    // Rows inserted one statement at a time, committed every 100 rows, in WAL mode
+    double insertRows(int rows) {
+        std::remove(kPath.c_str());
+        sqlite3* db = openDb();
+        sqlite3_exec(db,
+                     "PRAGMA journal_mode=WAL;"
+                     "CREATE TABLE items(id INTEGER PRIMARY KEY, name TEXT, score REAL);",
+                     nullptr, nullptr, nullptr);
+        double rate = opsPerSecond(rows, [&] {
+            for (int i = 0; i < rows; ++i) {
+                if (i % 100 == 0)
+                    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+                std::string name = "item-" + std::to_string(i);
+                runStatement(db, "INSERT INTO items(id, score, name) VALUES (?, ? / 2.0, ?)",
+                             {i, i}, &name);
+                if (i % 100 == 99 || i == rows - 1)
+                    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+            }
+        });
+        sqlite3_exec(db, "ANALYZE;", nullptr, nullptr, nullptr);
+        sqlite3_close(db);
+        return rate;
+    }
+
+    // Same query mix on one read-only connection per thread
+    double readQueries(int threads, int rows, int queries, const char* sql, int params) {
+        std::vector<std::thread> pool;
+        return opsPerSecond(threads * queries, [&] {
+            for (int t = 0; t < threads; ++t) {
+                pool.emplace_back([&, t] {
+                    sqlite3* db = openDb(SQLITE_OPEN_READONLY);
+                    for (int q = 0; q < queries; ++q) {
+                        long long from = (t * 7919LL + q * 104729LL) % rows;
+                        std::vector<long long> ints{from, from + 100};
+                        ints.resize(params);
+                        runStatement(db, sql, ints);
+                    }
+                    sqlite3_close(db);
+                });
+            }
+            for (auto& th : pool) th.join();
+        });
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rows = argc > 1 ? std::stoi(argv[1]) : 100000;
+    int queries = argc > 2 ? std::stoi(argv[2]) : 2000;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    std::printf("profile %s, SQLite %s, threadsafe=%d, %d rows\n", BENCH_SQLITE_PROFILE,
+                sqlite3_libversion(), sqlite3_threadsafe(), rows);
+    std::printf("%-28s %14s\n", "workload", "ops/s");
+    std::printf("%-28s %14.0f\n", "insert (100 per commit)", insertRows(rows));
+    std::printf("%-28s %14.0f\n", "point select, 1 thread",
+                readQueries(1, rows, queries, "SELECT id, name, score FROM items WHERE id = ?", 1));
+    std::printf("%-28s %14.0f\n", ("point select, " + std::to_string(threads) + " threads").c_str(),
+                readQueries(threads, rows, queries,
+                            "SELECT id, name, score FROM items WHERE id = ?", 1));
+    std::printf("%-28s %14.0f\n", "range + LIKE",
+                readQueries(1, rows, queries / 4,
+                            "SELECT id, name FROM items WHERE id BETWEEN ? AND ? "
+                            "AND name LIKE 'item-1%'",
+                            2));
+    std::printf("%-28s %14.0f\n", "group by (full scan)",
+                readQueries(1, rows, std::max(1, queries / 200),
+                            "SELECT id % 16, COUNT(*), AVG(score) FROM items GROUP BY 1", 0));
+
+    std::remove(kPath.c_str());
+    return 0;
+}
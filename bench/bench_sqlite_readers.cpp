@@ -0,0 +1,102 @@
+// Parallel SELECT throughput: single SQLite connection vs. WAL reader pool.
+//
+//   bench_sqlite_readers [rows] [queries_per_thread]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "factory.h"
+#include "log_armory/src/factory.h"
+#include "log_armory/src/logger.h"
+#include "querybuilder/query_builder.h"
+#include "sqlite/driver/sqlite3.h"
+
+namespace {
+    const char* kPath = "bench_readers.db";
+
+    void createFixture(int rows) {
+        std::remove(kPath);
+        sqlite3* db = nullptr;
+        sqlite3_open(kPath, &db);
+        sqlite3_exec(db,
+                     "CREATE TABLE items(id INTEGER PRIMARY KEY, name TEXT, score REAL);"
+                     "BEGIN;",
+                     nullptr, nullptr, nullptr);
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(db, "INSERT INTO items(id, name, score) VALUES (?, ?, ?)", -1, &stmt,
+                           nullptr);
+        for (int i = 0; i < rows; ++i) {
+            std::string name = "item-" + std::to_string(i);
+            sqlite3_bind_int(stmt, 1, i);
+            sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_double(stmt, 3, i * 0.5);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        sqlite3_close(db);
+    }
+
+    double run(ILogger* logger, int readers, int threads, int rows, int queries) {
+        ConnectionConfig cfg;
+        cfg.path = kPath;
+        cfg.sqlite_readers = readers;
+        std::unique_ptr<IDatabase> db =
+            DatabaseFactory::createDatabase(DatabaseType::sqlite, cfg, logger);
+        db->open();
+
+        std::atomic<long> returned{0};
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] {
+                for (int q = 0; q < queries; ++q) {
+                    int from = (t * 7919 + q * 104729) % rows;
+                    QueryBuilder qb;
+                    qb.table("items")
+                        .select("id")
+                        .select("name")
+                        .select("score")
+                        .where("id >= " + std::to_string(from))
+                        .where("id < " + std::to_string(from + 100));
+                    returned += static_cast<long>(db->select(qb).rows());
+                }
+            });
+        }
+        for (auto& th : pool) th.join();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        db->close();
+        return (threads * queries) / elapsed.count();
+    }
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rows = argc > 1 ? std::stoi(argv[1]) : 200000;
+    int queries = argc > 2 ? std::stoi(argv[2]) : 2000;
+
+    LogConfig lcfg;
+    lcfg.filePath = ".";
+    lcfg.maxLogRotate = 1;
+    lcfg.logLevel = LogLevel::error;
+    ILogger* logger = LoggerFactory::createLogger(LoggerType::Spdlog, lcfg);
+
+    createFixture(rows);
+
+    int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::printf("%8s %16s %16s %8s\n", "threads", "single (q/s)", "pool (q/s)", "speedup");
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        double single = run(logger, 0, threads, rows, queries);
+        double pooled = run(logger, threads, threads, rows, queries);
+        std::printf("%8d %16.0f %16.0f %7.2fx\n", threads, single, pooled, pooled / single);
+    }
+
+    std::remove(kPath);
+    return 0;
+}
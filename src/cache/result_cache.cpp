@@ -0,0 +1,170 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+ResultCache::ResultCache(std::chrono::milliseconds ttl, size_t capacity)
+    : ttl_(ttl), capacity_(capacity ? capacity : 1) {}
+
+QueryResult ResultCache::select(IDatabase& db, const QueryBuilder& qb) {
+    if (auto hit = get(qb))
+        return std::move(*hit);
+
+    uint64_t epoch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        epoch = epoch_;
+    }
+    QueryResult result = db.select(qb);
+    if (!result.columns().empty())
+        store(qb, result, epoch);
+    return result;
+}
+
+std::optional<QueryResult> ResultCache::get(const QueryBuilder& qb) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(keyOf(qb));
+    if (it == index_.end())
+        return std::nullopt;
+    if (Clock::now() >= it->second->expires) {
+        erase(it->second);
+        return std::nullopt;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    QueryResult copy = it->second->result;
+    copy.set_memory_category(MemoryAccountant::Category::Results);
+    return copy;
+}
+
+void ResultCache::put(const QueryBuilder& qb, QueryResult result) {
+    uint64_t epoch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        epoch = epoch_;
+    }
+    store(qb, std::move(result), epoch);
+}
+
+void ResultCache::store(const QueryBuilder& qb, QueryResult result, uint64_t epoch) {
+    std::vector<std::string> tables = tablesOf(qb);
+    std::string key = keyOf(qb);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cleared_at_ > epoch)
+        return;
+    for (const auto& table : tables) {
+        auto at = invalidated_at_.find(table);
+        if (at != invalidated_at_.end() && at->second > epoch)
+            return;
+    }
+
+    if (auto it = index_.find(key); it != index_.end())
+        erase(it->second);
+    while (lru_.size() >= capacity_) erase(std::prev(lru_.end()));
+
+    result.set_memory_category(MemoryAccountant::Category::Cache);
+    lru_.push_front(Entry{key, std::move(result), tables, Clock::now() + ttl_});
+    index_[key] = lru_.begin();
+    for (const auto& table : tables) by_table_.emplace(table, key);
+}
+
+void ResultCache::invalidate(const std::string& table) {
+    std::string name = tableName(table);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        invalidated_at_[name] = ++epoch_;
+        auto [first, last] = by_table_.equal_range(name);
+        std::vector<std::string> keys;
+        for (auto it = first; it != last; ++it) keys.push_back(it->second);
+        for (const auto& key : keys)
+            if (auto it = index_.find(key); it != index_.end())
+                erase(it->second);
+    }
+    notify(name);
+}
+
+void ResultCache::clear() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cleared_at_ = ++epoch_;
+        lru_.clear();
+        index_.clear();
+        by_table_.clear();
+    }
+    notify("");
+}
+
+uint64_t ResultCache::onInvalidate(const std::string& table, InvalidateFn fn) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    listeners_[next_listener_] = Listener{tableName(table), std::move(fn)};
+    return next_listener_++;
+}
+
+void ResultCache::removeListener(uint64_t id) {
+    std::lock_guard<std::mutex> lock(listeners_mutex_);
+    listeners_.erase(id);
+}
+
+size_t ResultCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
+
+void ResultCache::notify(const std::string& table) {
+    std::vector<InvalidateFn> due;
+    {
+        std::lock_guard<std::mutex> lock(listeners_mutex_);
+        for (const auto& [id, listener] : listeners_)
+            if (table.empty() || listener.table == table)
+                due.push_back(listener.fn);
+    }
+    for (const auto& fn : due) fn(table);
+}
+
+void ResultCache::erase(std::list<Entry>::iterator it) {
+    for (const auto& table : it->tables) {
+        auto [first, last] = by_table_.equal_range(table);
+        for (auto ref = first; ref != last; ++ref) {
+            if (ref->second == it->key) {
+                by_table_.erase(ref);
+                break;
+            }
+        }
+    }
+    index_.erase(it->key);
+    lru_.erase(it);
+}
+
+std::string ResultCache::tableName(const std::string& ref) {
+    size_t begin = ref.find_first_not_of(' ');
+    if (begin == std::string::npos)
+        return "";
+    std::string name = ref.substr(begin, ref.find(' ', begin) - begin);
+    if (size_t dot = name.rfind('.'); dot != std::string::npos)
+        name = name.substr(dot + 1);
+    name.erase(std::remove(name.begin(), name.end(), '"'), name.end());
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return name;
+}
+
+std::string ResultCache::keyOf(const QueryBuilder& qb) {
+    // NUL cannot appear in SQL text, so it separates the values unambiguously
+    std::string key = qb.str();
+    for (const auto& param : qb.getParams()) {
+        key += '\0';
+        key += param ? "v" + *param : "n";
+    }
+    if (qb.getShardKey())
+        key += '\0' + *qb.getShardKey();
+    return key;
+}
+
+std::vector<std::string> ResultCache::tablesOf(const QueryBuilder& qb) {
+    std::vector<std::string> tables{tableName(qb.getTable())};
+    for (const auto& join : qb.getJoins()) tables.push_back(tableName(join.table));
+    std::sort(tables.begin(), tables.end());
+    tables.erase(std::unique(tables.begin(), tables.end()), tables.end());
+    return tables;
+}
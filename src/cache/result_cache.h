@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "database.h"
+
+// Select results kept in process, keyed by SQL and bound parameters and tagged with the tables
+// they read (FROM and JOIN). Entries expire after ttl, and invalidate(table) drops every entry
+// reading that table, so a change feed (PgChangeListener, SQLite change hooks) lets the TTL be
+// long without serving stale rows. The least recently used entry goes first when full.
+class ResultCache {
+  public:
+    // Called with the table name after its entries were dropped; empty name = everything
+    using InvalidateFn = std::function<void(const std::string& table)>;
+
+    explicit ResultCache(std::chrono::milliseconds ttl, size_t capacity = 1024);
+
+    // Cached result of qb, or db.select(qb) stored for next time. Failed selects (no columns)
+    // are not cached.
+    QueryResult select(IDatabase& db, const QueryBuilder& qb);
+
+    std::optional<QueryResult> get(const QueryBuilder& qb);
+    void put(const QueryBuilder& qb, QueryResult result);
+
+    // Table names are compared without schema, alias or case: "public.Users u" is "users"
+    void invalidate(const std::string& table);
+    void clear();
+
+    // Registers a derived in-process view of table to rebuild on invalidation; returns an id
+    // for removeListener(). Listeners run on the invalidating thread, outside the cache lock.
+    uint64_t onInvalidate(const std::string& table, InvalidateFn fn);
+    void removeListener(uint64_t id);
+
+    size_t size() const;
+    static std::string tableName(const std::string& ref);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string key;
+        QueryResult result;
+        std::vector<std::string> tables;
+        Clock::time_point expires;
+    };
+
+    static std::string keyOf(const QueryBuilder& qb);
+    static std::vector<std::string> tablesOf(const QueryBuilder& qb);
+    // Stores unless one of the tables was invalidated after epoch (the result may be stale)
+    void store(const QueryBuilder& qb, QueryResult result, uint64_t epoch);
+    void erase(std::list<Entry>::iterator it);
+    void notify(const std::string& table);
+
+    const std::chrono::milliseconds ttl_;
+    const size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;  // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    std::unordered_multimap<std::string, std::string> by_table_;  // table -> key
+    std::map<std::string, uint64_t> invalidated_at_;              // table -> epoch
+    uint64_t epoch_ = 0;
+    uint64_t cleared_at_ = 0;
+
+    struct Listener {
+        std::string table;
+        InvalidateFn fn;
+    };
+    std::mutex listeners_mutex_;
+    std::map<uint64_t, Listener> listeners_;
+    uint64_t next_listener_ = 0;
+};
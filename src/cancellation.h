@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Cooperative cancellation flag. Copies share one state, so the caller keeps a token and hands
+// a copy to the query (QueryBuilder::cancelledBy); cancel() may be called from any thread.
+class CancellationToken {
+  public:
+    CancellationToken() : state_(std::make_shared<State>()) {}
+
+    void cancel() const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->cancelled.exchange(true))
+            return;
+        for (auto& [id, fn] : state_->callbacks) fn();
+    }
+
+    bool cancelled() const { return state_->cancelled; }
+
+    // Backends register how to abort the query in flight; fn runs on cancel(), or right away
+    // when already cancelled. removeCallback() waits for a running callback to return.
+    uint64_t onCancel(std::function<void()> fn) const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->cancelled) {
+            fn();
+            return state_->next_id++;
+        }
+        state_->callbacks[state_->next_id] = std::move(fn);
+        return state_->next_id++;
+    }
+
+    void removeCallback(uint64_t id) const {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->callbacks.erase(id);
+    }
+
+  private:
+    struct State {
+        std::atomic<bool> cancelled{false};
+        std::mutex mutex;
+        std::map<uint64_t, std::function<void()>> callbacks;
+        uint64_t next_id = 0;
+    };
+
+    std::shared_ptr<State> state_;
+};
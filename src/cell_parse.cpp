@@ -0,0 +1,202 @@
+#include "cell_parse.h"
+
+#include <charconv>
+#include <cstring>
+#include <iterator>
+
+namespace {
+    constexpr uint64_t kMaxExactMantissa = uint64_t{1} << 53;
+
+    // Powers of ten a double holds exactly
+    constexpr double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                 1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    template <typename T>
+    bool fromChars(std::string_view text, T& value) {
+        const char* end = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(text.data(), end, value);
+        return !text.empty() && ec == std::errc() && ptr == end;
+    }
+
+    bool isDigit(char ch) { return ch >= '0' && ch <= '9'; }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Eight ASCII bytes, first character in the low byte
+    bool eightDigits(uint64_t chunk) {
+        return ((chunk & 0xF0F0F0F0F0F0F0F0) |
+                (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+               0x3333333333333333;
+    }
+
+    // Adjacent digits are combined pairwise within the word: 8 -> 4 -> 2 -> 1 lanes
+    uint32_t eightDigitsValue(uint64_t chunk) {
+        constexpr uint64_t kMask = 0x000000FF000000FF;
+        constexpr uint64_t kMul1 = 100 + (uint64_t{1000000} << 32);
+        constexpr uint64_t kMul2 = 1 + (uint64_t{10000} << 32);
+        chunk -= 0x3030303030303030;
+        chunk = chunk * 10 + (chunk >> 8);
+        chunk = (((chunk & kMask) * kMul1) + (((chunk >> 16) & kMask) * kMul2)) >> 32;
+        return static_cast<uint32_t>(chunk);
+    }
+#endif
+
+    // Appends the digits at p to value (wrapping past 20 digits, callers count them) and
+    // returns the first non-digit
+    const char* readDigits(const char* p, const char* end, uint64_t& value) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        while (end - p >= 8) {
+            uint64_t chunk;
+            std::memcpy(&chunk, p, 8);
+            if (!eightDigits(chunk))
+                break;
+            value = value * 100000000 + eightDigitsValue(chunk);
+            p += 8;
+        }
+#endif
+        for (; p != end && isDigit(*p); ++p) value = value * 10 + static_cast<uint64_t>(*p - '0');
+        return p;
+    }
+
+    // Fixed-width decimal field of a timestamp
+    bool field(std::string_view text, size_t at, size_t len, int& value) {
+        if (at + len > text.size())
+            return false;
+        value = 0;
+        for (size_t i = at; i < at + len; ++i) {
+            if (!isDigit(text[i]))
+                return false;
+            value = value * 10 + (text[i] - '0');
+        }
+        return true;
+    }
+
+    template <typename T, typename Parse>
+    void parseAll(const std::optional<std::string_view>* cells, size_t n, T* values,
+                  uint8_t* valid, Parse parse) {
+        for (size_t i = 0; i < n; ++i) {
+            valid[i] = cells[i] && parse(*cells[i], values[i]);
+            if (!valid[i])
+                values[i] = T{};
+        }
+    }
+}  // namespace
+
+bool parseInt64(std::string_view text, int64_t& value) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    const bool negative = p != end && *p == '-';
+    p += negative;
+    const char* digits = p;
+    uint64_t magnitude = 0;
+    p = readDigits(p, end, magnitude);
+    if (p == digits || p != end)
+        return false;
+    if (p - digits > 19)
+        return fromChars(text, value);  // leading zeros, or out of range
+
+    const uint64_t limit = uint64_t{INT64_MAX} + negative;
+    if (magnitude > limit)
+        return false;
+    value = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+    return true;
+}
+
+bool parseDouble(std::string_view text, double& value) {
+    // [-]digits[.digits] whose digits fit a double's mantissa: one correctly rounded division
+    const char* p = text.data();
+    const char* end = p + text.size();
+    const bool negative = p != end && *p == '-';
+    p += negative;
+    const char* whole = p;
+    uint64_t mantissa = 0;
+    p = readDigits(p, end, mantissa);
+    const size_t whole_digits = static_cast<size_t>(p - whole);
+    size_t fraction_digits = 0;
+    bool plain = whole_digits > 0;
+    if (plain && p != end && *p == '.') {
+        const char* fraction = ++p;
+        p = readDigits(p, end, mantissa);
+        fraction_digits = static_cast<size_t>(p - fraction);
+        plain = fraction_digits > 0;
+    }
+    if (plain && p == end && whole_digits + fraction_digits <= 19 &&
+        mantissa <= kMaxExactMantissa && fraction_digits < std::size(kPow10)) {
+        double magnitude = static_cast<double>(mantissa) / kPow10[fraction_digits];
+        value = negative ? -magnitude : magnitude;
+        return true;
+    }
+    return fromChars(text, value);
+}
+
+bool parseTimestamp(std::string_view text, CellTime& value) {
+    using namespace std::chrono;
+    int y, mo, d;
+    if (!field(text, 0, 4, y) || !field(text, 5, 2, mo) || !field(text, 8, 2, d) ||
+        text[4] != '-' || text[7] != '-')
+        return false;
+    const year_month_day date{year{y}, month{static_cast<unsigned>(mo)},
+                              day{static_cast<unsigned>(d)}};
+    if (!date.ok())
+        return false;
+    value = time_point_cast<microseconds>(sys_days{date});
+    if (text.size() == 10)
+        return true;
+
+    int h, mi, s;
+    if ((text[10] != ' ' && text[10] != 'T') || !field(text, 11, 2, h) ||
+        !field(text, 14, 2, mi) || !field(text, 17, 2, s) || text[13] != ':' ||
+        text[16] != ':' || h > 23 || mi > 59 || s > 59)
+        return false;
+    value += hours{h} + minutes{mi} + seconds{s};
+
+    size_t at = 19;
+    if (at < text.size() && text[at] == '.') {
+        int64_t micros = 0;
+        size_t digits = 0;
+        for (++at; at < text.size() && isDigit(text[at]); ++at, ++digits)
+            if (digits < 6)
+                micros = micros * 10 + (text[at] - '0');
+        if (digits == 0)
+            return false;
+        for (; digits < 6; ++digits) micros *= 10;
+        value += microseconds{micros};
+    }
+
+    if (at < text.size() && text[at] == 'Z') {
+        ++at;
+    } else if (at < text.size() && (text[at] == '+' || text[at] == '-')) {
+        const int sign = text[at] == '-' ? -1 : 1;
+        int oh = 0, om = 0, os = 0;
+        if (!field(text, at + 1, 2, oh))
+            return false;
+        at += 3;
+        if (at < text.size() && text[at] == ':') {
+            if (!field(text, at + 1, 2, om))
+                return false;
+            at += 3;
+            if (at < text.size() && text[at] == ':') {
+                if (!field(text, at + 1, 2, os))
+                    return false;
+                at += 3;
+            }
+        }
+        value -= sign * (hours{oh} + minutes{om} + seconds{os});
+    }
+    return at == text.size();
+}
+
+void parseInt64s(const std::optional<std::string_view>* cells, size_t n, int64_t* values,
+                 uint8_t* valid) {
+    parseAll(cells, n, values, valid, parseInt64);
+}
+
+void parseDoubles(const std::optional<std::string_view>* cells, size_t n, double* values,
+                  uint8_t* valid) {
+    parseAll(cells, n, values, valid, parseDouble);
+}
+
+void parseTimestamps(const std::optional<std::string_view>* cells, size_t n, CellTime* values,
+                     uint8_t* valid) {
+    parseAll(cells, n, values, valid, parseTimestamp);
+}
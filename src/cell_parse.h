@@ -0,0 +1,29 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Numbers and timestamps out of text cells, as the drivers deliver them on the text protocol.
+// The whole cell must parse: "12abc", " 12" and "" are rejected. Integers take eight digits
+// per step (SWAR) and plain decimals short enough to be exact in a double skip the general
+// algorithm; every other form goes to std::from_chars, whose results they always equal.
+using CellTime = std::chrono::sys_time<std::chrono::microseconds>;
+
+bool parseInt64(std::string_view text, int64_t& value);
+bool parseDouble(std::string_view text, double& value);
+// "YYYY-MM-DD", optionally followed by " HH:MM:SS[.fraction]" ('T' also separates) and a zone
+// "Z", "+HH", "+HH:MM" or "+HH:MM:SS"; without a zone the time is taken as UTC. Fractions
+// below a microsecond are truncated.
+bool parseTimestamp(std::string_view text, CellTime& value);
+
+// Whole runs of cells at once: valid[i] is 0, and values[i] value-initialized, where cells[i]
+// is NULL (empty optional) or does not parse
+void parseInt64s(const std::optional<std::string_view>* cells, size_t n, int64_t* values,
+                 uint8_t* valid);
+void parseDoubles(const std::optional<std::string_view>* cells, size_t n, double* values,
+                  uint8_t* valid);
+void parseTimestamps(const std::optional<std::string_view>* cells, size_t n, CellTime* values,
+                     uint8_t* valid);
@@ -0,0 +1,485 @@
+#include "result_ops.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#ifndef DATABASE_ARMORY_NO_PARALLEL_STL
+#include <execution>
+#endif
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "cell_parse.h"
+
+namespace {
+    using Selection = ResultOps::Selection;
+    using Compare = ResultOps::Compare;
+    using Agg = ResultOps::Agg;
+
+    // Runs fn(block, begin, end) over [0, n) in kBlockRows pieces; blocks are independent, so
+    // large inputs run them in parallel (sequentially in builds without a parallel backend)
+    template <typename Fn>
+    void forEachBlock(size_t n, Fn&& fn) {
+        std::vector<size_t> blocks((n + ResultOps::kBlockRows - 1) / ResultOps::kBlockRows);
+        std::iota(blocks.begin(), blocks.end(), size_t{0});
+        auto run = [&](size_t b) {
+            const size_t begin = b * ResultOps::kBlockRows;
+            fn(b, begin, std::min(n, begin + ResultOps::kBlockRows));
+        };
+#ifndef DATABASE_ARMORY_NO_PARALLEL_STL
+        if (n >= ResultOps::kParallelRows) {
+            std::for_each(std::execution::par, blocks.begin(), blocks.end(), run);
+            return;
+        }
+#endif
+        std::for_each(blocks.begin(), blocks.end(), run);
+    }
+
+    size_t blockCount(size_t n) {
+        return (n + ResultOps::kBlockRows - 1) / ResultOps::kBlockRows;
+    }
+
+    Selection concat(std::vector<Selection>& parts) {
+        size_t total = 0;
+        for (const auto& part : parts) total += part.size();
+        Selection out;
+        out.reserve(total);
+        for (auto& part : parts) out.insert(out.end(), part.begin(), part.end());
+        return out;
+    }
+
+    // QueryResult::int64_column() and double_column(), with the blocks parsed in parallel
+    template <typename T, typename Parse>
+    ResultOps::Column<T> decode(const QueryResult& result, size_t col, Parse parse) {
+        ResultOps::Column<T> column;
+        column.values.resize(result.rows());
+        column.valid.resize(result.rows());
+        forEachBlock(result.rows(), [&](size_t, size_t begin, size_t end) {
+            (result.*parse)(col, begin, end - begin, column.values.data() + begin,
+                            column.valid.data() + begin);
+        });
+        return column;
+    }
+
+    // Calls fn with the comparator for op, so the loop inside fn is compiled once per operator
+    // and holds no switch
+    template <typename T, typename Fn>
+    void withComparator(Compare op, Fn&& fn) {
+        switch (op) {
+            case Compare::Eq:
+                return fn(std::equal_to<T>());
+            case Compare::Ne:
+                return fn(std::not_equal_to<T>());
+            case Compare::Lt:
+                return fn(std::less<T>());
+            case Compare::Le:
+                return fn(std::less_equal<T>());
+            case Compare::Gt:
+                return fn(std::greater<T>());
+            case Compare::Ge:
+                return fn(std::greater_equal<T>());
+        }
+    }
+
+    template <typename T>
+    Selection filterColumn(const ResultOps::Column<T>& column, Compare op, T value,
+                           const Selection* within) {
+        const size_t n = within ? within->size() : column.values.size();
+        std::vector<Selection> parts(blockCount(n));
+        forEachBlock(n, [&](size_t b, size_t begin, size_t end) {
+            const size_t len = end - begin;
+            const T* values = column.values.data() + begin;
+            const uint8_t* valid = column.valid.data() + begin;
+            std::vector<T> gathered;
+            std::vector<uint8_t> gathered_valid;
+            if (within) {
+                gathered.resize(len);
+                gathered_valid.resize(len);
+                for (size_t i = 0; i < len; ++i) {
+                    const uint32_t r = (*within)[begin + i];
+                    if (r < column.values.size()) {
+                        gathered[i] = column.values[r];
+                        gathered_valid[i] = column.valid[r];
+                    }
+                }
+                values = gathered.data();
+                valid = gathered_valid.data();
+            }
+
+            // Mask then compact, both without branches on the data
+            std::vector<uint8_t> mask(len);
+            withComparator<T>(op, [&](auto cmp) {
+                for (size_t i = 0; i < len; ++i)
+                    mask[i] = valid[i] & static_cast<uint8_t>(cmp(values[i], value));
+            });
+            Selection& out = parts[b];
+            out.resize(len);
+            size_t k = 0;
+            if (within) {
+                for (size_t i = 0; i < len; ++i) {
+                    out[k] = (*within)[begin + i];
+                    k += mask[i];
+                }
+            } else {
+                for (size_t i = 0; i < len; ++i) {
+                    out[k] = static_cast<uint32_t>(begin + i);
+                    k += mask[i];
+                }
+            }
+            out.resize(k);
+        });
+        return concat(parts);
+    }
+
+    template <typename T>
+    std::string formatNumber(T value) {
+        char buf[32];
+        auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+        return std::string(buf, end);
+    }
+
+    // Picks the k first rows by less: each block keeps its own k best, then those are merged
+    template <typename RowAt, typename Less>
+    Selection topRows(size_t n, size_t k, size_t rows, RowAt rowAt, Less less) {
+        std::vector<Selection> parts(blockCount(n));
+        forEachBlock(n, [&](size_t b, size_t begin, size_t end) {
+            Selection& part = parts[b];
+            for (size_t i = begin; i < end; ++i)
+                if (rowAt(i) < rows)
+                    part.push_back(rowAt(i));
+            const size_t keep = std::min(k, part.size());
+            std::partial_sort(part.begin(), part.begin() + keep, part.end(), less);
+            part.resize(keep);
+        });
+        Selection best = concat(parts);
+        const size_t keep = std::min(k, best.size());
+        std::partial_sort(best.begin(), best.begin() + keep, best.end(), less);
+        best.resize(keep);
+        return best;
+    }
+
+    // key(row) is empty for NULL; NULLs go last in either direction and ties keep row order
+    template <typename Key>
+    auto orderBy(Key key, bool descending) {
+        return [key, descending](uint32_t a, uint32_t b) {
+            auto x = key(a);
+            auto y = key(b);
+            if (x.has_value() != y.has_value())
+                return x.has_value();
+            if (x && *x != *y)
+                return descending ? *y < *x : *x < *y;
+            return a < b;
+        };
+    }
+
+    // Decoded input of one aggregate. valid is empty for COUNT(*); COUNT(col) only needs it.
+    struct AggInput {
+        bool integer = false;
+        std::vector<int64_t> ints;
+        std::vector<double> reals;
+        std::vector<uint8_t> valid;
+    };
+
+    struct Acc {
+        uint64_t n = 0;  // rows counted, or values seen for Sum/Min/Max
+        int64_t i = 0;
+        double d = 0;
+        bool overflow = false;  // integer Sum out of int64 range, carried on in d
+    };
+
+    double sumOf(const Acc& acc) {
+        return acc.overflow ? acc.d : static_cast<double>(acc.i);
+    }
+
+    void addInteger(Acc& acc, int64_t value) {
+        int64_t sum = 0;
+        if (acc.overflow) {
+            acc.d += static_cast<double>(value);
+        } else if (__builtin_add_overflow(acc.i, value, &sum)) {
+            acc.d = static_cast<double>(acc.i) + static_cast<double>(value);
+            acc.overflow = true;
+        } else {
+            acc.i = sum;
+        }
+    }
+
+    template <typename T>
+    void accumulate(Agg fn, Acc& acc, T value, T& slot) {
+        if (fn != Agg::Sum) {
+            if (acc.n == 0 || (fn == Agg::Min ? value < slot : slot < value))
+                slot = value;
+        } else if constexpr (std::is_same_v<T, int64_t>) {
+            addInteger(acc, value);
+        } else {
+            slot += value;
+        }
+        ++acc.n;
+    }
+
+    void merge(Agg fn, bool integer, Acc& into, const Acc& from) {
+        if (from.n == 0)
+            return;
+        if (fn == Agg::Count || into.n == 0) {
+            into = Acc{into.n + from.n, fn == Agg::Count ? 0 : from.i, from.d, from.overflow};
+            return;
+        }
+        if (fn == Agg::Sum && !integer) {
+            into.d += from.d;
+        } else if (fn == Agg::Sum) {
+            if (from.overflow) {
+                into.d = sumOf(into) + from.d;
+                into.overflow = true;
+            } else {
+                addInteger(into, from.i);
+            }
+        } else if (integer) {
+            into.i = fn == Agg::Min ? std::min(into.i, from.i) : std::max(into.i, from.i);
+        } else {
+            into.d = fn == Agg::Min ? std::min(into.d, from.d) : std::max(into.d, from.d);
+        }
+        into.n += from.n;
+    }
+
+    // Groups of one block, numbered in order of first appearance
+    struct Groups {
+        std::vector<std::optional<std::string_view>> keys;
+        std::vector<Acc> accs;  // group * aggregates + aggregate
+    };
+
+    const char* aggName(Agg fn) {
+        switch (fn) {
+            case Agg::Count:
+                return "count";
+            case Agg::Sum:
+                return "sum";
+            case Agg::Min:
+                return "min";
+            case Agg::Max:
+                return "max";
+        }
+        return "";
+    }
+}  // namespace
+
+ResultOps::Column<int64_t> ResultOps::int64s(const QueryResult& result, size_t col) {
+    return decode<int64_t>(result, col, &QueryResult::parse_int64s);
+}
+
+ResultOps::Column<double> ResultOps::doubles(const QueryResult& result, size_t col) {
+    Column<double> column = decode<double>(result, col, &QueryResult::parse_doubles);
+    // NaN has no order; treat it like NULL so comparisons and sorting stay consistent
+    for (size_t r = 0; r < column.values.size(); ++r)
+        column.valid[r] &= static_cast<uint8_t>(!std::isnan(column.values[r]));
+    return column;
+}
+
+ResultOps::Selection ResultOps::filter(const Column<int64_t>& column, Compare op, int64_t value,
+                                       const Selection* within) {
+    return filterColumn(column, op, value, within);
+}
+
+ResultOps::Selection ResultOps::filter(const Column<double>& column, Compare op, double value,
+                                       const Selection* within) {
+    return filterColumn(column, op, value, within);
+}
+
+ResultOps::Selection ResultOps::filter(const QueryResult& result, size_t col, Compare op,
+                                       std::string_view value, const Selection* within) {
+    if (result.column_type(col) == ColumnType::Int64) {
+        int64_t number = 0;
+        return parseInt64(value, number) ? filter(int64s(result, col), op, number, within)
+                                    : Selection{};
+    }
+    if (result.column_type(col) == ColumnType::Double) {
+        double number = 0;
+        return parseDouble(value, number) && !std::isnan(number)
+                   ? filter(doubles(result, col), op, number, within)
+                   : Selection{};
+    }
+
+    const size_t n = within ? within->size() : result.rows();
+    std::vector<Selection> parts(blockCount(n));
+    forEachBlock(n, [&](size_t b, size_t begin, size_t end) {
+        withComparator<int>(op, [&](auto cmp) {
+            for (size_t i = begin; i < end; ++i) {
+                const size_t r = within ? (*within)[i] : i;
+                if (r < result.rows() && !result.is_null(r, col) &&
+                    cmp(result.view(r, col).compare(value), 0))
+                    parts[b].push_back(static_cast<uint32_t>(r));
+            }
+        });
+    });
+    return concat(parts);
+}
+
+QueryResult ResultOps::groupBy(const QueryResult& result, size_t key,
+                               const std::vector<Aggregate>& aggregates,
+                               const Selection* within) {
+    const size_t naggs = aggregates.size();
+    std::vector<AggInput> inputs(naggs);
+    for (size_t a = 0; a < naggs; ++a) {
+        const Aggregate& agg = aggregates[a];
+        AggInput& input = inputs[a];
+        if (agg.col == kAllRows) {
+            if (agg.fn != Agg::Count)
+                input.valid.assign(result.rows(), 0);
+        } else if (agg.fn == Agg::Count) {
+            input.valid.resize(result.rows());
+            for (size_t r = 0; r < result.rows(); ++r)
+                input.valid[r] = !result.is_null(r, agg.col);
+        } else if (result.column_type(agg.col) == ColumnType::Int64) {
+            auto column = int64s(result, agg.col);
+            input.integer = true;
+            input.ints = std::move(column.values);
+            input.valid = std::move(column.valid);
+        } else {
+            auto column = doubles(result, agg.col);
+            input.reals = std::move(column.values);
+            input.valid = std::move(column.valid);
+        }
+    }
+
+    const size_t n = within ? within->size() : result.rows();
+    std::vector<Groups> blocks(blockCount(n));
+    forEachBlock(n, [&](size_t b, size_t begin, size_t end) {
+        Groups& groups = blocks[b];
+        std::unordered_map<std::optional<std::string_view>, uint32_t> ids;
+        std::vector<uint32_t> rows;
+        std::vector<uint32_t> gid;
+        for (size_t i = begin; i < end; ++i) {
+            const size_t r = within ? (*within)[i] : i;
+            if (r >= result.rows())
+                continue;
+            std::optional<std::string_view> value;
+            if (!result.is_null(r, key))
+                value = result.view(r, key);
+            auto [it, inserted] = ids.try_emplace(value, static_cast<uint32_t>(groups.keys.size()));
+            if (inserted)
+                groups.keys.push_back(value);
+            rows.push_back(static_cast<uint32_t>(r));
+            gid.push_back(it->second);
+        }
+
+        // One pass per aggregate over its own decoded column
+        groups.accs.resize(groups.keys.size() * naggs);
+        for (size_t a = 0; a < naggs; ++a) {
+            const Agg fn = aggregates[a].fn;
+            const AggInput& input = inputs[a];
+            for (size_t i = 0; i < rows.size(); ++i) {
+                const uint32_t r = rows[i];
+                if (!input.valid.empty() && !input.valid[r])
+                    continue;
+                Acc& acc = groups.accs[gid[i] * naggs + a];
+                if (fn == Agg::Count)
+                    ++acc.n;
+                else if (input.integer)
+                    accumulate(fn, acc, input.ints[r], acc.i);
+                else
+                    accumulate(fn, acc, input.reals[r], acc.d);
+            }
+        }
+    });
+
+    // Blocks merge in order, so groups keep the order of first appearance
+    Groups total;
+    std::unordered_map<std::optional<std::string_view>, uint32_t> ids;
+    for (const Groups& groups : blocks) {
+        for (size_t g = 0; g < groups.keys.size(); ++g) {
+            auto [it, inserted] =
+                ids.try_emplace(groups.keys[g], static_cast<uint32_t>(total.keys.size()));
+            if (inserted) {
+                total.keys.push_back(groups.keys[g]);
+                total.accs.resize(total.accs.size() + naggs);
+            }
+            for (size_t a = 0; a < naggs; ++a)
+                merge(aggregates[a].fn, inputs[a].integer, total.accs[it->second * naggs + a],
+                      groups.accs[g * naggs + a]);
+        }
+    }
+
+    // An integer Sum that left the int64 range in any group is Double for every group
+    std::vector<uint8_t> integral(naggs);
+    for (size_t a = 0; a < naggs; ++a) {
+        integral[a] = aggregates[a].fn == Agg::Count || inputs[a].integer;
+        if (aggregates[a].fn == Agg::Sum)
+            for (size_t g = 0; g < total.keys.size() && integral[a]; ++g)
+                integral[a] = !total.accs[g * naggs + a].overflow;
+    }
+
+    std::vector<std::string> columns{key < result.cols() ? result.columns()[key] : "key"};
+    std::vector<ColumnType> types{result.column_type(key)};
+    for (size_t a = 0; a < naggs; ++a) {
+        const Aggregate& agg = aggregates[a];
+        std::string of = agg.col == kAllRows  ? "*"
+                         : agg.col < result.cols() ? result.columns()[agg.col]
+                                                   : std::to_string(agg.col);
+        columns.push_back(std::string(aggName(agg.fn)) + "(" + of + ")");
+        types.push_back(integral[a] ? ColumnType::Int64 : ColumnType::Double);
+    }
+
+    QueryResult out({}, std::move(columns));
+    out.set_column_types(std::move(types));
+    std::vector<std::string> owned(naggs);
+    QueryResult::Cells cells(naggs + 1);
+    for (size_t g = 0; g < total.keys.size(); ++g) {
+        cells[0] = total.keys[g];
+        for (size_t a = 0; a < naggs; ++a) {
+            const Acc& acc = total.accs[g * naggs + a];
+            const Agg fn = aggregates[a].fn;
+            if (fn != Agg::Count && acc.n == 0) {
+                cells[a + 1] = std::nullopt;
+                continue;
+            }
+            owned[a] = fn == Agg::Count     ? formatNumber(acc.n)
+                       : integral[a]       ? formatNumber(acc.i)
+                       : inputs[a].integer ? formatNumber(sumOf(acc))
+                                           : formatNumber(acc.d);
+            cells[a + 1] = owned[a];
+        }
+        out.append_cells(cells);
+    }
+    return out;
+}
+
+ResultOps::Selection ResultOps::topK(const QueryResult& result, size_t col, size_t k,
+                                     bool descending, const Selection* within) {
+    const size_t n = within ? within->size() : result.rows();
+    auto rowAt = [within](size_t i) { return within ? (*within)[i] : static_cast<uint32_t>(i); };
+    if (k == 0 || n == 0)
+        return {};
+
+    if (result.column_type(col) == ColumnType::Int64) {
+        const Column<int64_t> column = int64s(result, col);
+        auto key = [&column](uint32_t r) {
+            return column.valid[r] ? std::optional<int64_t>(column.values[r]) : std::nullopt;
+        };
+        return topRows(n, k, result.rows(), rowAt, orderBy(key, descending));
+    }
+    if (result.column_type(col) == ColumnType::Double) {
+        const Column<double> column = doubles(result, col);
+        auto key = [&column](uint32_t r) {
+            return column.valid[r] ? std::optional<double>(column.values[r]) : std::nullopt;
+        };
+        return topRows(n, k, result.rows(), rowAt, orderBy(key, descending));
+    }
+    auto key = [&result, col](uint32_t r) {
+        return result.is_null(r, col) ? std::nullopt
+                                      : std::optional<std::string_view>(result.view(r, col));
+    };
+    return topRows(n, k, result.rows(), rowAt, orderBy(key, descending));
+}
+
+QueryResult ResultOps::take(const QueryResult& result, const Selection& rows) {
+    QueryResult out({}, result.columns());
+    out.set_column_types(result.column_types());
+    out.set_spill_policy(result.spill_policy());
+    for (uint32_t r : rows)
+        if (r < result.rows())
+            out.append_row(result, r);
+    return out;
+}
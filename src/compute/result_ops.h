@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "query_result.h"
+
+// Client-side filter, group-by and top-k over QueryResult columns, for post-processing rows
+// merged from several sources. Numeric columns are decoded once into contiguous typed arrays
+// and scanned with branch-free loops the compiler vectorizes. Inputs of kParallelRows rows or
+// more are cut into blocks of kBlockRows that run under std::execution::par; the output does
+// not depend on how the work was split.
+class ResultOps {
+  public:
+    // Row indexes into a QueryResult, ascending unless produced by topK()
+    using Selection = std::vector<uint32_t>;
+
+    enum class Compare { Eq, Ne, Lt, Le, Gt, Ge };
+    enum class Agg { Count, Sum, Min, Max };
+
+    static constexpr size_t kAllRows = SIZE_MAX;
+    struct Aggregate {
+        Agg fn;
+        size_t col = kAllRows;  // kAllRows only for Count: COUNT(*)
+    };
+
+    // valid[i] is 0 where the cell is NULL or does not parse as T
+    template <typename T>
+    using Column = QueryResult::TypedColumn<T>;
+
+    static constexpr size_t kBlockRows = size_t{1} << 14;
+    static constexpr size_t kParallelRows = size_t{1} << 16;
+
+    static Column<int64_t> int64s(const QueryResult& result, size_t col);
+    static Column<double> doubles(const QueryResult& result, size_t col);
+
+    // Rows whose value compares true against value; NULLs never match. within restricts the
+    // scan to an earlier selection, so filters chain.
+    static Selection filter(const Column<int64_t>& column, Compare op, int64_t value,
+                            const Selection* within = nullptr);
+    static Selection filter(const Column<double>& column, Compare op, double value,
+                            const Selection* within = nullptr);
+    // Compares as the column's type: Int64 and Double columns numerically, others as bytes
+    static Selection filter(const QueryResult& result, size_t col, Compare op,
+                            std::string_view value, const Selection* within = nullptr);
+
+    // One row per distinct value of key (NULL is a group of its own) in order of first
+    // appearance: the key, then one column per aggregate, named like "sum(amount)". Sum, Min
+    // and Max skip NULLs and are NULL for a group without values; they stay Int64 over Int64
+    // columns and are Double otherwise. A Sum that overflows int64 in any group is Double for
+    // all of them.
+    static QueryResult groupBy(const QueryResult& result, size_t key,
+                               const std::vector<Aggregate>& aggregates,
+                               const Selection* within = nullptr);
+
+    // The k first rows ordered by col (typed as in filter), NULLs last and ties by row index
+    static Selection topK(const QueryResult& result, size_t col, size_t k,
+                          bool descending = false, const Selection* within = nullptr);
+
+    // Copies the selected rows, NULLs and column types included
+    static QueryResult take(const QueryResult& result, const Selection& rows);
+};
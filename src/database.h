@@ -1,32 +1,106 @@
-#pragma once
-
-#include <optional>
-#include <pqxx/pqxx>
-#include <string>
-#include <vector>
-
-#include "config.h"
-#include "query_result.h"
-#include "querybuilder/query_builder.h"
-#include "log_armory/src/logger.h"
-
-enum class DatabaseType { PostgreSQL, sqlite };
-
-class IDatabase {
-  public:
-    virtual ~IDatabase() = default;
-    IDatabase(ConnectionConfig cfg, ILogger *logger) : config_(cfg), logger_(logger) {}
-
-    virtual bool open() = 0;
-    virtual void close() = 0;
-    virtual bool is_open() const = 0;
-
-    virtual bool insert(const QueryBuilder& qb) = 0;
-    virtual bool update(const QueryBuilder& qb) = 0;
-    virtual bool remove(const QueryBuilder& qb) = 0;
-    virtual QueryResult select(const QueryBuilder& qb) = 0;
-
-  protected:
-    ConnectionConfig config_;
-    ILogger *logger_;
-};
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <pqxx/pqxx>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "diagnostics/slow_query_log.h"
+#include "export/row_sink.h"
+#include "query_result.h"
+#include "querybuilder/query_builder.h"
+#include "log_armory/src/logger.h"
+#include "spdlog/fmt/bundled/format.h"
+
+enum class DatabaseType { PostgreSQL, sqlite, Mock, Memory };
+
+// How the last operation ended; Cancelled and TimedOut leave the connection usable
+enum class QueryStatus { Ok, Failed, Cancelled, TimedOut };
+
+class IDatabase {
+  public:
+    virtual ~IDatabase() = default;
+    IDatabase(ConnectionConfig cfg, ILogger *logger) : config_(cfg), logger_(logger) {}
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual bool is_open() const = 0;
+
+    virtual bool insert(const QueryBuilder& qb) = 0;
+    virtual bool update(const QueryBuilder& qb) = 0;
+    virtual bool remove(const QueryBuilder& qb) = 0;
+    virtual QueryResult select(const QueryBuilder& qb) = 0;
+
+    // Runs an insertInto().onConflict() builder as one statement per bind-limit chunk, all in
+    // one transaction. Returns rows inserted or updated (DO NOTHING skips are not counted),
+    // std::nullopt on failure.
+    virtual std::optional<size_t> upsert(const QueryBuilder& qb) {
+        logger_->error(fmt::format("Upsert is not supported by this backend: {}", qb.str()));
+        return std::nullopt;
+    }
+
+    // Readies a statement the application runs often ahead of its first call (see warmUp()).
+    // The default has nothing to prepare; false when the backend rejects the statement.
+    virtual bool prepare(const QueryBuilder&) { return true; }
+
+    // Feed the select row by row into sink. Backends override this to keep memory flat;
+    // the default materializes the result first.
+    virtual bool stream(const QueryBuilder& qb, IRowSink& sink) {
+        QueryResult res = select(qb);
+        if (!sink.begin(res.columns(), res.column_types()))
+            return false;
+        IRowSink::Cells cells(res.cols());
+        for (size_t r = 0; r < res.rows(); ++r) {
+            for (size_t c = 0; c < res.cols(); ++c)
+                cells[c] = res.is_null(r, c) ? std::nullopt
+                                             : std::optional<std::string_view>(res.view(r, c));
+            if (!sink.row(cells))
+                return false;
+        }
+        return sink.end();
+    }
+
+    // Statements at or above the log's threshold are recorded there; set before running queries
+    void setSlowQueryLog(std::shared_ptr<SlowQueryLog> log) { slow_log_ = std::move(log); }
+
+    // Outcome of the last operation the calling thread ran, on any database. Tells a query
+    // stopped by QueryBuilder::timeout() or cancelledBy() apart from other failures.
+    static QueryStatus lastStatus() { return last_status_; }
+
+  protected:
+    static void setStatus(QueryStatus status) { last_status_ = status; }
+    // Status of a failed query: Cancelled or TimedOut when qb's token or deadline explains it
+    static QueryStatus failureOf(const QueryBuilder& qb,
+                                 std::chrono::steady_clock::time_point start) {
+        if (qb.getCancellation() && qb.getCancellation()->cancelled())
+            return QueryStatus::Cancelled;
+        if (qb.getTimeout() && std::chrono::steady_clock::now() - start >= *qb.getTimeout())
+            return QueryStatus::TimedOut;
+        return QueryStatus::Failed;
+    }
+
+    // Builds the EXPLAIN job for the slow query log; nullptr when the backend has no plans
+    virtual SlowQueryLog::PlanFn planCapture() const { return nullptr; }
+
+    void recordQuery(const std::string& sql, const QueryBuilder::Params& params,
+                     std::chrono::steady_clock::time_point start, size_t rows) {
+        if (!slow_log_)
+            return;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+        if (elapsed < slow_log_->threshold())
+            return;
+        logger_->info(fmt::format("Slow query ({} us, {} rows): {}", elapsed.count(), rows, sql));
+        slow_log_->record(sql, params, elapsed, rows, planCapture());
+    }
+
+    ConnectionConfig config_;
+    ILogger *logger_;
+    std::shared_ptr<SlowQueryLog> slow_log_;
+
+  private:
+    static inline thread_local QueryStatus last_status_ = QueryStatus::Ok;
+};
@@ -0,0 +1,166 @@
+#include "slow_query_log.h"
+
+#include <cctype>
+#include <charconv>
+#include <exception>
+
+namespace {
+    // Plans still waiting beyond this are dropped rather than piling up behind a slow server
+    constexpr size_t kMaxPendingPlans = 64;
+
+    bool isWordChar(char ch) {
+        return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_' || ch == '$';
+    }
+}  // namespace
+
+SlowQueryLog::SlowQueryLog(std::chrono::microseconds threshold, size_t capacity)
+    : threshold_(threshold), capacity_(capacity ? capacity : 1) {}
+
+SlowQueryLog::~SlowQueryLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        jobs_.clear();
+    }
+    jobs_cv_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+}
+
+uint64_t SlowQueryLog::record(const std::string& sql, const Params& params,
+                              std::chrono::microseconds duration, size_t rows, PlanFn plan) {
+    SlowQuery entry;
+    entry.at = std::chrono::system_clock::now();
+    entry.fingerprint = fingerprint(sql, &entry.params, params);
+    entry.duration = duration;
+    entry.rows = rows;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry.id = next_id_++;
+    if (ring_.size() < capacity_)
+        ring_.push_back(std::move(entry));
+    else
+        ring_[entry.id % capacity_] = std::move(entry);
+
+    if (plan && !stopping_ && jobs_.size() < kMaxPendingPlans) {
+        jobs_.push_back(PlanJob{next_id_ - 1, sql, params, std::move(plan)});
+        if (!worker_.joinable())
+            worker_ = std::thread(&SlowQueryLog::run, this);
+        jobs_cv_.notify_one();
+    }
+    return next_id_ - 1;
+}
+
+std::vector<SlowQuery> SlowQueryLog::recent() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<SlowQuery> out;
+    out.reserve(ring_.size());
+    uint64_t first = next_id_ - ring_.size();
+    for (uint64_t id = first; id < next_id_; ++id) out.push_back(ring_[id % capacity_]);
+    return out;
+}
+
+void SlowQueryLog::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [this] { return jobs_.empty() && !busy_; });
+}
+
+void SlowQueryLog::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        jobs_cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (stopping_)
+            break;
+        PlanJob job = std::move(jobs_.front());
+        jobs_.pop_front();
+        busy_ = true;
+        lock.unlock();
+
+        std::string plan;
+        try {
+            plan = job.plan(job.sql, job.params);
+        } catch (const std::exception& e) {
+            plan = std::string("EXPLAIN failed: ") + e.what();
+        }
+
+        lock.lock();
+        busy_ = false;
+        // The record may already have been overwritten by newer ones
+        if (job.id + ring_.size() >= next_id_)
+            ring_[job.id % capacity_].plan = std::move(plan);
+        idle_cv_.notify_all();
+    }
+    busy_ = false;
+    idle_cv_.notify_all();
+}
+
+std::string SlowQueryLog::fingerprint(const std::string& sql, std::vector<std::string>* params,
+                                      const Params& bound) {
+    auto boundValue = [&bound](size_t index) {
+        return index < bound.size() ? bound[index].value_or("NULL") : std::string("?");
+    };
+    std::string out;
+    out.reserve(sql.size());
+    size_t nextBound = 0;
+    for (size_t i = 0; i < sql.size();) {
+        char ch = sql[i];
+        if (ch == '?' || (ch == '$' && i + 1 < sql.size() &&
+                          std::isdigit(static_cast<unsigned char>(sql[i + 1])))) {
+            size_t index = nextBound++;
+            size_t begin = i++;
+            if (ch == '$') {
+                while (i < sql.size() && std::isdigit(static_cast<unsigned char>(sql[i]))) ++i;
+                // $0 and runs too long for size_t leave n at 0, which wraps to an unbound index
+                size_t n = 0;
+                std::from_chars(sql.data() + begin + 1, sql.data() + i, n);
+                index = n - 1;
+            }
+            out.append(sql, begin, i - begin);
+            if (params)
+                params->push_back(boundValue(index));
+            continue;
+        }
+        if (std::isspace(static_cast<unsigned char>(ch))) {
+            while (i < sql.size() && std::isspace(static_cast<unsigned char>(sql[i]))) ++i;
+            if (!out.empty() && i < sql.size())
+                out += ' ';
+            continue;
+        }
+        if (ch == '\'') {
+            std::string literal;
+            for (++i; i < sql.size(); ++i) {
+                if (sql[i] == '\'') {
+                    if (i + 1 < sql.size() && sql[i + 1] == '\'') {
+                        literal += '\'';
+                        ++i;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                literal += sql[i];
+            }
+            out += '?';
+            if (params)
+                params->push_back(std::move(literal));
+            continue;
+        }
+        bool startsNumber = std::isdigit(static_cast<unsigned char>(ch)) ||
+                            (ch == '-' && i + 1 < sql.size() &&
+                             std::isdigit(static_cast<unsigned char>(sql[i + 1])) &&
+                             (out.empty() || !isWordChar(out.back())));
+        if (startsNumber && (i == 0 || !isWordChar(sql[i - 1]))) {
+            size_t begin = i++;
+            while (i < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i])) ||
+                                      sql[i] == '.'))
+                ++i;
+            out += '?';
+            if (params)
+                params->push_back(sql.substr(begin, i - begin));
+            continue;
+        }
+        out += ch;
+        ++i;
+    }
+    return out;
+}
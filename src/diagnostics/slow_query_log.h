@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SlowQuery {
+    uint64_t id = 0;
+    std::chrono::system_clock::time_point at;
+    std::string fingerprint;          // SQL with literals replaced by ?
+    std::vector<std::string> params;  // replaced literals and bound values, in order
+    std::chrono::microseconds duration{0};
+    size_t rows = 0;                  // returned by reads, affected by writes
+    std::optional<std::string> plan;  // set once the background EXPLAIN has finished
+};
+
+// Ring buffer of queries that ran longer than a threshold. Attach one to any IDatabase with
+// setSlowQueryLog(); the same log can be shared by several databases. Plans are captured on
+// one background thread so the slow query itself is not delayed further.
+class SlowQueryLog {
+  public:
+    using Params = std::vector<std::optional<std::string>>;  // bound values, empty = NULL
+    // Runs EXPLAIN for sql on a connection of its own; must not refer to the database object
+    using PlanFn = std::function<std::string(const std::string& sql, const Params& params)>;
+
+    explicit SlowQueryLog(std::chrono::microseconds threshold, size_t capacity = 256);
+    ~SlowQueryLog();
+
+    std::chrono::microseconds threshold() const { return threshold_; }
+
+    // Stores the query and queues plan (if any); returns the record id
+    uint64_t record(const std::string& sql, const Params& params,
+                    std::chrono::microseconds duration, size_t rows, PlanFn plan);
+    // Oldest first
+    std::vector<SlowQuery> recent() const;
+    // Waits for queued plan captures to finish
+    void flush();
+
+    // Replaces literals with ?; params receives them in order, with the bound values
+    // substituted for existing ? and $n placeholders
+    static std::string fingerprint(const std::string& sql,
+                                   std::vector<std::string>* params = nullptr,
+                                   const Params& bound = {});
+
+    SlowQueryLog(const SlowQueryLog&) = delete;
+    SlowQueryLog& operator=(const SlowQueryLog&) = delete;
+
+  private:
+    struct PlanJob {
+        uint64_t id;
+        std::string sql;
+        Params params;
+        PlanFn plan;
+    };
+
+    void run();
+
+    const std::chrono::microseconds threshold_;
+    const size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::vector<SlowQuery> ring_;
+    uint64_t next_id_ = 0;
+
+    std::condition_variable jobs_cv_;
+    std::condition_variable idle_cv_;
+    std::deque<PlanJob> jobs_;
+    bool busy_ = false;
+    bool stopping_ = false;
+    std::thread worker_;  // started with the first plan job
+};
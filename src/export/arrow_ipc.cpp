@@ -0,0 +1,390 @@
+#include "arrow_ipc.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cell_parse.h"
+
+// Arrow metadata is a FlatBuffers-encoded Message (see Schema.fbs / Message.fbs in the Arrow
+// format specification). FlatBuffers are normally built back to front; here every object is
+// written after the object referencing it, so uoffsets are forward and patched once known.
+namespace {
+    // Union discriminants and enum values from the Arrow format spec
+    constexpr uint8_t kHeaderSchema = 1;
+    constexpr uint8_t kHeaderRecordBatch = 3;
+    constexpr uint8_t kTypeInt = 2;
+    constexpr uint8_t kTypeFloatingPoint = 3;
+    constexpr uint8_t kTypeBinary = 4;
+    constexpr uint8_t kTypeUtf8 = 5;
+    constexpr uint8_t kTypeBool = 6;
+    constexpr int16_t kMetadataV5 = 4;
+    constexpr int16_t kPrecisionDouble = 2;
+
+    class FlatBuilder {
+      public:
+        struct Field {
+            uint16_t id;
+            uint8_t size;     // inline bytes: 1, 2, 4 or 8
+            uint64_t value;   // scalar value, ignored for offsets
+            bool is_offset;   // uoffset to an object written later
+        };
+
+        std::vector<uint8_t> buf;
+
+        // Root uoffset at position 0, linked once the root table is written
+        FlatBuilder() { put<uint32_t>(0); }
+
+        size_t pos() const { return buf.size(); }
+        void align(size_t a, size_t extra = 0) {
+            while ((buf.size() + extra) % a) buf.push_back(0);
+        }
+        template <typename T>
+        void put(T v) {
+            uint8_t bytes[sizeof(T)];
+            std::memcpy(bytes, &v, sizeof(T));  // little-endian hosts only
+            buf.insert(buf.end(), bytes, bytes + sizeof(T));
+        }
+        template <typename T>
+        void putAt(size_t at, T v) {
+            std::memcpy(buf.data() + at, &v, sizeof(T));
+        }
+        void link(size_t slot, size_t target) {
+            putAt<uint32_t>(slot, static_cast<uint32_t>(target - slot));
+        }
+
+        // Writes vtable + table and returns the table start; offset field slots are appended
+        // to `offsets` in the order the fields were given
+        size_t table(const std::vector<Field>& fields, std::vector<size_t>* offsets = nullptr) {
+            std::vector<size_t> order(fields.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return fields[a].size > fields[b].size;
+            });
+
+            uint16_t maxId = 0;
+            for (const auto& f : fields) maxId = std::max(maxId, f.id);
+            std::vector<uint16_t> vtable(fields.empty() ? 0 : maxId + 1, 0);
+
+            // soffset to the vtable first, then fields largest first, each aligned to its size
+            std::vector<size_t> fieldPos(fields.size());
+            size_t cursor = 4;
+            for (size_t i : order) {
+                cursor = (cursor + fields[i].size - 1) / fields[i].size * fields[i].size;
+                fieldPos[i] = cursor;
+                vtable[fields[i].id] = static_cast<uint16_t>(cursor);
+                cursor += fields[i].size;
+            }
+
+            align(2);
+            size_t vt = pos();
+            put<uint16_t>(static_cast<uint16_t>(4 + 2 * vtable.size()));
+            put<uint16_t>(static_cast<uint16_t>(cursor));
+            for (uint16_t off : vtable) put<uint16_t>(off);
+
+            align(8);
+            size_t start = pos();
+            buf.resize(start + cursor, 0);
+            putAt<int32_t>(start, static_cast<int32_t>(start - vt));
+            for (size_t i = 0; i < fields.size(); ++i) {
+                size_t at = start + fieldPos[i];
+                if (fields[i].is_offset) {
+                    if (offsets)
+                        offsets->push_back(at);
+                    continue;
+                }
+                switch (fields[i].size) {
+                    case 1:
+                        putAt<uint8_t>(at, static_cast<uint8_t>(fields[i].value));
+                        break;
+                    case 2:
+                        putAt<uint16_t>(at, static_cast<uint16_t>(fields[i].value));
+                        break;
+                    case 4:
+                        putAt<uint32_t>(at, static_cast<uint32_t>(fields[i].value));
+                        break;
+                    default:
+                        putAt<uint64_t>(at, fields[i].value);
+                }
+            }
+            return start;
+        }
+
+        // Vector of uoffsets to tables written later; element slots go to `slots`
+        size_t offsetVector(size_t count, std::vector<size_t>* slots = nullptr) {
+            align(4);
+            size_t start = pos();
+            put<uint32_t>(static_cast<uint32_t>(count));
+            for (size_t i = 0; i < count; ++i) {
+                if (slots)
+                    slots->push_back(pos());
+                put<uint32_t>(0);
+            }
+            return start;
+        }
+
+        // Vector of {int64, int64} structs (FieldNode, Buffer)
+        size_t pairVector(const std::vector<std::pair<int64_t, int64_t>>& items) {
+            align(8, 4);
+            size_t start = pos();
+            put<uint32_t>(static_cast<uint32_t>(items.size()));
+            for (const auto& [a, b] : items) {
+                put<int64_t>(a);
+                put<int64_t>(b);
+            }
+            return start;
+        }
+
+        size_t string(const std::string& s) {
+            align(4);
+            size_t start = pos();
+            put<uint32_t>(static_cast<uint32_t>(s.size()));
+            buf.insert(buf.end(), s.begin(), s.end());
+            buf.push_back(0);
+            return start;
+        }
+    };
+
+    uint8_t arrowType(ColumnType t) {
+        switch (t) {
+            case ColumnType::Int64:
+                return kTypeInt;
+            case ColumnType::Double:
+                return kTypeFloatingPoint;
+            case ColumnType::Bool:
+                return kTypeBool;
+            case ColumnType::Blob:
+                return kTypeBinary;
+            default:
+                return kTypeUtf8;
+        }
+    }
+
+    size_t writeType(FlatBuilder& fb, ColumnType t) {
+        switch (t) {
+            case ColumnType::Int64:
+                return fb.table({{0, 4, 64, false}, {1, 1, 1, false}});  // bitWidth, is_signed
+            case ColumnType::Double:
+                return fb.table({{0, 2, static_cast<uint64_t>(kPrecisionDouble), false}});
+            default:
+                return fb.table({});  // Utf8, Binary and Bool carry no parameters
+        }
+    }
+
+    // Root Message { version, header_type, header, bodyLength }, returns the header slot
+    size_t writeMessageHeader(FlatBuilder& fb, uint8_t headerType, int64_t bodyLength) {
+        std::vector<size_t> slots;
+        size_t root = fb.table({{0, 2, static_cast<uint64_t>(kMetadataV5), false},
+                                {1, 1, headerType, false},
+                                {2, 4, 0, true},
+                                {3, 8, static_cast<uint64_t>(bodyLength), false}},
+                               &slots);
+        fb.link(0, root);
+        return slots[0];
+    }
+
+    bool parseBool(std::string_view s) {
+        return s == "t" || s == "true" || s == "TRUE" || s == "1";
+    }
+
+    struct BodyBuilder {
+        std::vector<uint8_t> body;
+        std::vector<std::pair<int64_t, int64_t>> buffers;
+
+        void add(const uint8_t* data, size_t len) {
+            buffers.emplace_back(static_cast<int64_t>(body.size()), static_cast<int64_t>(len));
+            body.insert(body.end(), data, data + len);
+            while (body.size() % 8) body.push_back(0);
+        }
+    };
+}  // namespace
+
+void ArrowIpcWriter::writeMessage(const std::vector<uint8_t>& metadata,
+                                  const std::vector<uint8_t>& body) {
+    size_t padded = (metadata.size() + 7) / 8 * 8;
+    uint32_t continuation = 0xFFFFFFFF;
+    int32_t length = static_cast<int32_t>(padded);
+    out_.write(reinterpret_cast<const char*>(&continuation), 4);
+    out_.write(reinterpret_cast<const char*>(&length), 4);
+    out_.write(reinterpret_cast<const char*>(metadata.data()),
+               static_cast<std::streamsize>(metadata.size()));
+    static const char zeros[8] = {};
+    out_.write(zeros, static_cast<std::streamsize>(padded - metadata.size()));
+    out_.write(reinterpret_cast<const char*>(body.data()),
+               static_cast<std::streamsize>(body.size()));
+}
+
+bool ArrowIpcWriter::write_schema(const std::vector<std::string>& columns,
+                                  const std::vector<ColumnType>& types) {
+    types_.assign(columns.size(), ColumnType::Text);
+    for (size_t i = 0; i < columns.size() && i < types.size(); ++i) types_[i] = types[i];
+
+    FlatBuilder fb;
+    size_t header = writeMessageHeader(fb, kHeaderSchema, 0);
+
+    std::vector<size_t> schemaSlots;
+    fb.link(header, fb.table({{1, 4, 0, true}}, &schemaSlots));  // Schema.fields
+
+    std::vector<size_t> fieldSlots;
+    fb.link(schemaSlots[0], fb.offsetVector(columns.size(), &fieldSlots));
+    for (size_t i = 0; i < columns.size(); ++i) {
+        // Field { name, nullable, type_type, type, children }
+        std::vector<size_t> slots;
+        fb.link(fieldSlots[i], fb.table({{0, 4, 0, true},
+                                         {1, 1, 1, false},
+                                         {2, 1, arrowType(types_[i]), false},
+                                         {3, 4, 0, true},
+                                         {5, 4, 0, true}},
+                                        &slots));
+        fb.link(slots[0], fb.string(columns[i]));
+        fb.link(slots[1], writeType(fb, types_[i]));
+        fb.link(slots[2], fb.offsetVector(0));
+    }
+
+    writeMessage(fb.buf, {});
+    schema_written_ = true;
+    return static_cast<bool>(out_);
+}
+
+bool ArrowIpcWriter::write_batch(const QueryResult& result, size_t begin, size_t end) {
+    if (!schema_written_ && !write_schema(result.columns(), result.column_types()))
+        return false;
+
+    end = std::min(end, result.rows());
+    begin = std::min(begin, end);
+    size_t n = end - begin;
+
+    BodyBuilder body;
+    std::vector<std::pair<int64_t, int64_t>> nodes;
+    for (size_t c = 0; c < types_.size(); ++c) {
+        std::vector<uint8_t> validity((n + 7) / 8, 0);
+        int64_t nullCount = 0;
+        auto valid = [&](size_t i, bool ok) {
+            if (ok)
+                validity[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+            else
+                ++nullCount;
+        };
+        auto cell = [&](size_t i) { return result.view(begin + i, c); };
+        auto isNull = [&](size_t i) { return result.is_null(begin + i, c); };
+
+        std::vector<uint8_t> values;
+        std::vector<uint8_t> data;
+        switch (types_[c]) {
+            case ColumnType::Int64:
+            case ColumnType::Double: {
+                values.resize(n * 8, 0);
+                for (size_t i = 0; i < n; ++i) {
+                    bool ok = false;
+                    if (!isNull(i)) {
+                        std::string_view s = cell(i);
+                        // The whole cell: SQLite keeps 1.5 as is in an INTEGER column
+                        // and null slots stay zero
+                        if (types_[c] == ColumnType::Int64) {
+                            int64_t v = 0;
+                            ok = parseInt64(s, v);
+                            if (ok)
+                                std::memcpy(values.data() + i * 8, &v, 8);
+                        } else {
+                            double v = 0;
+                            ok = parseDouble(s, v);
+                            if (ok)
+                                std::memcpy(values.data() + i * 8, &v, 8);
+                        }
+                    }
+                    valid(i, ok);
+                }
+                break;
+            }
+            case ColumnType::Bool:
+                values.resize((n + 7) / 8, 0);
+                for (size_t i = 0; i < n; ++i) {
+                    bool ok = !isNull(i);
+                    if (ok && parseBool(cell(i)))
+                        values[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+                    valid(i, ok);
+                }
+                break;
+            default: {
+                values.resize((n + 1) * 4, 0);
+                int32_t offset = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    std::memcpy(values.data() + i * 4, &offset, 4);
+                    bool ok = !isNull(i);
+                    if (ok) {
+                        std::string_view s = cell(i);
+                        data.insert(data.end(), s.begin(), s.end());
+                        offset += static_cast<int32_t>(s.size());
+                    }
+                    valid(i, ok);
+                }
+                std::memcpy(values.data() + n * 4, &offset, 4);
+            }
+        }
+
+        nodes.emplace_back(static_cast<int64_t>(n), nullCount);
+        body.add(validity.data(), nullCount ? validity.size() : 0);
+        body.add(values.data(), values.size());
+        if (types_[c] == ColumnType::Text || types_[c] == ColumnType::Blob)
+            body.add(data.data(), data.size());
+    }
+
+    FlatBuilder fb;
+    size_t header = writeMessageHeader(fb, kHeaderRecordBatch, static_cast<int64_t>(body.body.size()));
+    // RecordBatch { length, nodes, buffers }
+    std::vector<size_t> slots;
+    fb.link(header, fb.table({{0, 8, static_cast<uint64_t>(n), false},
+                              {1, 4, 0, true},
+                              {2, 4, 0, true}},
+                             &slots));
+    fb.link(slots[0], fb.pairVector(nodes));
+    fb.link(slots[1], fb.pairVector(body.buffers));
+
+    writeMessage(fb.buf, body.body);
+    return static_cast<bool>(out_);
+}
+
+bool ArrowIpcWriter::finish() {
+    if (finished_)
+        return static_cast<bool>(out_);
+    uint32_t eos[2] = {0xFFFFFFFF, 0};
+    out_.write(reinterpret_cast<const char*>(eos), sizeof(eos));
+    out_.flush();
+    finished_ = true;
+    return static_cast<bool>(out_);
+}
+
+bool write_arrow_ipc(const QueryResult& result, std::ostream& out, size_t batch_rows) {
+    ArrowIpcWriter writer(out);
+    if (!writer.write_schema(result.columns(), result.column_types()))
+        return false;
+    for (size_t begin = 0; begin < result.rows(); begin += batch_rows)
+        if (!writer.write_batch(result, begin, begin + batch_rows))
+            return false;
+    return writer.finish();
+}
+
+bool ArrowStreamSink::begin(const std::vector<std::string>& columns,
+                            const std::vector<ColumnType>& types) {
+    columns_ = columns;
+    types_ = types;
+    return writer_.write_schema(columns_, types_) && batch_.begin(columns_, types_);
+}
+
+bool ArrowStreamSink::row(const Cells& cells) {
+    // A batch the MemoryAccountant rejected stops growing and would drop every later row
+    if (!batch_.row(cells))
+        return false;
+    return batch_.result().rows() < batch_rows_ || flushBatch();
+}
+
+bool ArrowStreamSink::end() {
+    if (batch_.result().rejected())
+        return false;
+    return flushBatch() && writer_.finish();
+}
+
+bool ArrowStreamSink::flushBatch() {
+    bool ok = batch_.result().empty() || writer_.write_batch(batch_.result());
+    batch_.begin(columns_, types_);
+    return ok;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "query_result.h"
+#include "row_sink.h"
+
+// Apache Arrow IPC *stream* format writer (schema message, record batches, end-of-stream
+// marker) with no dependency on the Arrow libraries. Column types come from
+// QueryResult::column_type(): Int64 -> int64, Double -> float64, Bool -> bool,
+// Blob -> binary, Text -> utf8. Cells that do not parse whole as their column type become
+// null. Each write returns false once the stream has failed.
+class ArrowIpcWriter {
+  public:
+    explicit ArrowIpcWriter(std::ostream& out) : out_(out) {}
+
+    bool write_schema(const std::vector<std::string>& columns,
+                      const std::vector<ColumnType>& types);
+    // Rows [begin, end) of result as one record batch; writes the schema first if needed
+    bool write_batch(const QueryResult& result, size_t begin = 0, size_t end = SIZE_MAX);
+    bool finish();
+
+  private:
+    void writeMessage(const std::vector<uint8_t>& metadata, const std::vector<uint8_t>& body);
+
+    std::ostream& out_;
+    std::vector<ColumnType> types_;
+    bool schema_written_ = false;
+    bool finished_ = false;
+};
+
+// Whole result as an Arrow IPC stream, split into record batches of batch_rows; false when
+// out fails
+bool write_arrow_ipc(const QueryResult& result, std::ostream& out, size_t batch_rows = 65536);
+
+// Streaming variant: buffers batch_rows rows from IDatabase::stream() per record batch. The
+// buffer is a QueryResult under MemoryAccountant admission: once it is rejected row() and
+// end() fail, and the stream is left without its end-of-stream marker.
+class ArrowStreamSink : public IRowSink {
+  public:
+    explicit ArrowStreamSink(std::ostream& out, size_t batch_rows = 65536)
+        : writer_(out), batch_rows_(batch_rows) {}
+
+    bool begin(const std::vector<std::string>& columns,
+               const std::vector<ColumnType>& types) override;
+    bool row(const Cells& cells) override;
+    bool end() override;
+
+  private:
+    bool flushBatch();
+
+    ArrowIpcWriter writer_;
+    size_t batch_rows_;
+    std::vector<std::string> columns_;
+    std::vector<ColumnType> types_;
+    ResultCollector batch_;
+};
@@ -0,0 +1,122 @@
+#include "byte_sink.h"
+
+#include <cerrno>
+#include <unistd.h>
+
+#ifdef DATABASE_ARMORY_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef DATABASE_ARMORY_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+bool FdSink::write(const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+#ifdef DATABASE_ARMORY_WITH_ZLIB
+namespace {
+    constexpr size_t kChunk = 64 * 1024;
+}
+
+struct GzipSink::State {
+    z_stream zs{};
+    char out[kChunk];
+};
+
+GzipSink::GzipSink(ByteSink& inner, int level) : inner_(inner), state_(std::make_unique<State>()) {
+    // 15 window bits + 16 selects the gzip wrapper instead of zlib
+    ready_ = deflateInit2(&state_->zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+GzipSink::~GzipSink() {
+    close();
+    if (ready_)
+        deflateEnd(&state_->zs);
+}
+
+bool GzipSink::pump(int flush) {
+    z_stream& zs = state_->zs;
+    int rc = Z_OK;
+    do {
+        zs.next_out = reinterpret_cast<Bytef*>(state_->out);
+        zs.avail_out = kChunk;
+        rc = deflate(&zs, flush);
+        if (rc == Z_STREAM_ERROR)
+            return false;
+        if (!inner_.write(state_->out, kChunk - zs.avail_out))
+            return false;
+    } while (zs.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+    return true;
+}
+
+bool GzipSink::write(const char* data, size_t len) {
+    if (!ready_)
+        return false;
+    z_stream& zs = state_->zs;
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = static_cast<uInt>(len);
+    return pump(Z_NO_FLUSH);
+}
+
+bool GzipSink::close() {
+    if (closed_)
+        return true;
+    closed_ = true;
+    if (!ready_)
+        return false;
+    state_->zs.avail_in = 0;
+    return pump(Z_FINISH) && inner_.close();
+}
+#endif
+
+#ifdef DATABASE_ARMORY_WITH_ZSTD
+ZstdSink::ZstdSink(ByteSink& inner, int level)
+    : inner_(inner), cctx_(ZSTD_createCCtx()), out_(ZSTD_CStreamOutSize(), '\0') {
+    if (cctx_)
+        ZSTD_CCtx_setParameter(static_cast<ZSTD_CCtx*>(cctx_), ZSTD_c_compressionLevel, level);
+}
+
+ZstdSink::~ZstdSink() {
+    close();
+    ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(cctx_));
+}
+
+bool ZstdSink::pump(const char* data, size_t len, bool end) {
+    if (!cctx_)
+        return false;
+    ZSTD_inBuffer in{data, len, 0};
+    size_t remaining = 0;
+    do {
+        ZSTD_outBuffer out{out_.data(), out_.size(), 0};
+        remaining = ZSTD_compressStream2(static_cast<ZSTD_CCtx*>(cctx_), &out, &in,
+                                         end ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(remaining))
+            return false;
+        if (!inner_.write(out_.data(), out.pos))
+            return false;
+    } while (end ? remaining != 0 : in.pos < in.size);
+    return true;
+}
+
+bool ZstdSink::write(const char* data, size_t len) {
+    return pump(data, len, false);
+}
+
+bool ZstdSink::close() {
+    if (closed_)
+        return true;
+    closed_ = true;
+    return pump(nullptr, 0, true) && inner_.close();
+}
+#endif
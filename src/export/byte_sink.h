@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+
+// Destination for serialized export bytes
+class ByteSink {
+  public:
+    virtual ~ByteSink() = default;
+    virtual bool write(const char* data, size_t len) = 0;
+    // Flush framing/trailers; the sink must not be written to afterwards
+    virtual bool close() { return true; }
+};
+
+class FdSink : public ByteSink {
+  public:
+    explicit FdSink(int fd) : fd_(fd) {}
+    bool write(const char* data, size_t len) override;
+
+  private:
+    int fd_;
+};
+
+class OstreamSink : public ByteSink {
+  public:
+    explicit OstreamSink(std::ostream& os) : os_(os) {}
+    bool write(const char* data, size_t len) override {
+        os_.write(data, static_cast<std::streamsize>(len));
+        return static_cast<bool>(os_);
+    }
+    bool close() override { return static_cast<bool>(os_.flush()); }
+
+  private:
+    std::ostream& os_;
+};
+
+#ifdef DATABASE_ARMORY_WITH_ZLIB
+// gzip member framing (RFC 1952) around another sink; every call fails when zlib could not
+// set up the stream (bad level, out of memory)
+class GzipSink : public ByteSink {
+  public:
+    explicit GzipSink(ByteSink& inner, int level = 6);
+    ~GzipSink() override;
+    bool write(const char* data, size_t len) override;
+    bool close() override;
+
+  private:
+    struct State;
+    bool pump(int flush);
+
+    ByteSink& inner_;
+    std::unique_ptr<State> state_;
+    bool ready_ = false;  // deflateInit2() succeeded
+    bool closed_ = false;
+};
+#endif
+
+#ifdef DATABASE_ARMORY_WITH_ZSTD
+// zstd frame around another sink; every call fails when no compression context was created
+class ZstdSink : public ByteSink {
+  public:
+    explicit ZstdSink(ByteSink& inner, int level = 3);
+    ~ZstdSink() override;
+    bool write(const char* data, size_t len) override;
+    bool close() override;
+
+  private:
+    bool pump(const char* data, size_t len, bool end);
+
+    ByteSink& inner_;
+    void* cctx_;
+    std::string out_;
+    bool closed_ = false;
+};
+#endif
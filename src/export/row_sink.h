@@ -0,0 +1,53 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "query_result.h"
+
+// Receives a result one row at a time from IDatabase::stream(), so exports never hold the
+// whole result in memory. Returning false from any callback stops the stream.
+class IRowSink {
+  public:
+    using Cells = QueryResult::Cells;  // empty optional = NULL
+
+    virtual ~IRowSink() = default;
+
+    virtual bool begin(const std::vector<std::string>& columns,
+                       const std::vector<ColumnType>& types) = 0;
+    // Views are only valid for the duration of the call
+    virtual bool row(const Cells& cells) = 0;
+    virtual bool end() = 0;
+};
+
+// Collects streamed rows back into a QueryResult
+class ResultCollector : public IRowSink {
+  public:
+    ResultCollector() = default;
+    explicit ResultCollector(QueryResult::SpillPolicy spill) : spill_(std::move(spill)) {}
+
+    bool begin(const std::vector<std::string>& columns,
+               const std::vector<ColumnType>& types) override {
+        result_ = QueryResult({}, columns);
+        result_.set_column_types(types);
+        result_.set_spill_policy(spill_);
+        return true;
+    }
+
+    // Stops the stream once the MemoryAccountant rejected the result
+    bool row(const Cells& cells) override {
+        result_.append_cells(cells);
+        return !result_.rejected();
+    }
+
+    bool end() override { return true; }
+
+    const QueryResult& result() const { return result_; }
+    QueryResult take() { return std::move(result_); }
+
+  private:
+    QueryResult::SpillPolicy spill_;
+    QueryResult result_;
+};
@@ -0,0 +1,143 @@
+#include "text_writer.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace {
+    bool isJsonNumber(std::string_view s) {
+        double v = 0;
+        auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+        // from_chars also accepts inf/nan and hex-less forms JSON does not, so re-check
+        return ec == std::errc() && end == s.data() + s.size() && std::isfinite(v) &&
+               !s.empty() && s.front() != '+' && s.front() != '.' && s.back() != '.';
+    }
+}  // namespace
+
+bool BufferedTextWriter::flush() {
+    if (buf_.empty())
+        return true;
+    bool ok = out_.write(buf_.data(), buf_.size());
+    buf_.clear();
+    return ok;
+}
+
+bool CsvWriter::begin(const std::vector<std::string>& columns, const std::vector<ColumnType>&) {
+    if (!options_.header)
+        return true;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (i)
+            buf_ += options_.delimiter;
+        field(columns[i]);
+    }
+    buf_ += "\r\n";
+    return flushIfFull();
+}
+
+bool CsvWriter::row(const Cells& cells) {
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (i)
+            buf_ += options_.delimiter;
+        if (cells[i])
+            field(*cells[i]);
+    }
+    buf_ += "\r\n";
+    return flushIfFull();
+}
+
+void CsvWriter::field(std::string_view value) {
+    bool quote = value.empty();
+    for (char c : value) {
+        if (c == options_.delimiter || c == '"' || c == '\n' || c == '\r') {
+            quote = true;
+            break;
+        }
+    }
+    if (!quote) {
+        buf_.append(value);
+        return;
+    }
+    buf_ += '"';
+    for (char c : value) {
+        if (c == '"')
+            buf_ += '"';
+        buf_ += c;
+    }
+    buf_ += '"';
+}
+
+bool NdjsonWriter::begin(const std::vector<std::string>& columns,
+                         const std::vector<ColumnType>& types) {
+    types_ = types;
+    types_.resize(columns.size(), ColumnType::Text);
+    keys_.clear();
+    for (const auto& name : columns) {
+        std::swap(buf_, keys_.emplace_back());
+        string(name);
+        buf_ += ':';
+        std::swap(buf_, keys_.back());
+    }
+    return true;
+}
+
+bool NdjsonWriter::row(const Cells& cells) {
+    buf_ += '{';
+    for (size_t i = 0; i < cells.size() && i < keys_.size(); ++i) {
+        if (i)
+            buf_ += ',';
+        buf_ += keys_[i];
+        if (!cells[i]) {
+            buf_ += "null";
+            continue;
+        }
+        std::string_view v = *cells[i];
+        switch (types_[i]) {
+            case ColumnType::Int64:
+            case ColumnType::Double:
+                if (isJsonNumber(v))
+                    buf_.append(v);
+                else
+                    string(v);
+                break;
+            case ColumnType::Bool:
+                buf_ += (v == "t" || v == "true" || v == "1") ? "true" : "false";
+                break;
+            default:
+                string(v);
+        }
+    }
+    buf_ += "}\n";
+    return flushIfFull();
+}
+
+void NdjsonWriter::string(std::string_view value) {
+    static const char* hex = "0123456789abcdef";
+    buf_ += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"':
+                buf_ += "\\\"";
+                break;
+            case '\\':
+                buf_ += "\\\\";
+                break;
+            case '\n':
+                buf_ += "\\n";
+                break;
+            case '\r':
+                buf_ += "\\r";
+                break;
+            case '\t':
+                buf_ += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    buf_ += "\\u00";
+                    buf_ += hex[(c >> 4) & 0xF];
+                    buf_ += hex[c & 0xF];
+                } else {
+                    buf_ += c;
+                }
+        }
+    }
+    buf_ += '"';
+}
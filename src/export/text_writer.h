@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "byte_sink.h"
+#include "row_sink.h"
+
+// Row sink that serializes into an internal buffer and hands it to a ByteSink whenever it
+// reaches buffer_size, so memory stays constant regardless of the number of rows.
+class BufferedTextWriter : public IRowSink {
+  public:
+    BufferedTextWriter(ByteSink& out, size_t buffer_size)
+        : out_(out), buffer_size_(buffer_size) {
+        buf_.reserve(buffer_size_);
+    }
+
+    bool end() override { return flush() && out_.close(); }
+
+  protected:
+    bool flushIfFull() { return buf_.size() < buffer_size_ || flush(); }
+    bool flush();
+
+    ByteSink& out_;
+    size_t buffer_size_;
+    std::string buf_;
+};
+
+struct CsvOptions {
+    char delimiter = ',';
+    bool header = true;
+    size_t buffer_size = 64 * 1024;
+};
+
+// RFC 4180: fields containing the delimiter, quotes or line breaks are quoted with doubled
+// quotes. NULL is written as an empty field, the empty string as "".
+class CsvWriter : public BufferedTextWriter {
+  public:
+    explicit CsvWriter(ByteSink& out, CsvOptions options = {})
+        : BufferedTextWriter(out, options.buffer_size), options_(options) {}
+
+    bool begin(const std::vector<std::string>& columns,
+               const std::vector<ColumnType>& types) override;
+    bool row(const Cells& cells) override;
+
+  private:
+    void field(std::string_view value);
+
+    CsvOptions options_;
+};
+
+// One JSON object per line keyed by column name. Int64/Double/Bool columns are written as
+// JSON numbers/booleans when the text is a valid literal, everything else as strings.
+class NdjsonWriter : public BufferedTextWriter {
+  public:
+    explicit NdjsonWriter(ByteSink& out, size_t buffer_size = 64 * 1024)
+        : BufferedTextWriter(out, buffer_size) {}
+
+    bool begin(const std::vector<std::string>& columns,
+               const std::vector<ColumnType>& types) override;
+    bool row(const Cells& cells) override;
+
+  private:
+    void string(std::string_view value);
+
+    std::vector<std::string> keys_;  // pre-escaped "name":
+    std::vector<ColumnType> types_;
+};
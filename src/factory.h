@@ -1,20 +1,38 @@
-#pragma once
-
-#include "config.h"
-#include "log_armory/src/logger.h"
-#include "postgres/postgresql.h"
-#include "sqlite/sqlite.h"
-
-class DatabaseFactory {
-  public:
-    static std::unique_ptr<IDatabase> createDatabase(DatabaseType type, ConnectionConfig cfg,
-                                                     ILogger* logger) {
-        if (type == DatabaseType::PostgreSQL) {
-            return std::make_unique<PostgreSQL>(cfg, logger);
-        } else if (type == DatabaseType::sqlite) {
-            return std::make_unique<SQLite>(cfg, logger);
-        } else {
-            throw std::invalid_argument("Invalid logger type");
-        }
-    }
-};
+#pragma once
+
+#include "config.h"
+#include "log_armory/src/logger.h"
+#include "memory/memory_database.h"
+#include "mock/mock_database.h"
+#include "postgres/postgresql.h"
+#include "sharded/sharded_database.h"
+#include "sqlite/sqlite.h"
+
+class DatabaseFactory {
+  public:
+    static std::unique_ptr<IDatabase> createDatabase(DatabaseType type, ConnectionConfig cfg,
+                                                     ILogger* logger) {
+        if (type == DatabaseType::PostgreSQL) {
+            return std::make_unique<PostgreSQL>(cfg, logger);
+        } else if (type == DatabaseType::sqlite) {
+            return std::make_unique<SQLite>(cfg, logger);
+        } else if (type == DatabaseType::Mock) {
+            return std::make_unique<MockDatabase>(cfg, logger);
+        } else if (type == DatabaseType::Memory) {
+            return std::make_unique<MemoryDatabase>(cfg, logger);
+        } else {
+            throw std::invalid_argument("Invalid logger type");
+        }
+    }
+
+    // Any mix of backends, one per shard, in ShardingPolicy order
+    static std::unique_ptr<IDatabase> createSharded(
+        const std::vector<std::pair<DatabaseType, ConnectionConfig>>& shards,
+        ShardingPolicy policy, ILogger* logger) {
+        std::vector<std::unique_ptr<IDatabase>> dbs;
+        for (const auto& [type, cfg] : shards) dbs.push_back(createDatabase(type, cfg, logger));
+        // Merged ORDER BY places NULLs where the first shard's backend does
+        policy.nulls_last = !shards.empty() && shards.front().first == DatabaseType::PostgreSQL;
+        return std::make_unique<ShardedDatabase>(std::move(dbs), std::move(policy), logger);
+    }
+};
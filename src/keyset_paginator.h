@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "database.h"
+
+// Walks a whole query in pages of pageSize rows with keyset pagination: each page seeks past
+// the last key of the previous one instead of using OFFSET, so deep pages cost the same as the
+// first. keys must identify a row uniquely and never be NULL, a primary key for instance.
+class KeysetPaginator {
+  public:
+    KeysetPaginator(IDatabase& db, QueryBuilder query, std::vector<std::string> keys,
+                    int pageSize, bool descending = false)
+        : db_(db),
+          query_(std::move(query)),
+          keys_(std::move(keys)),
+          page_size_(pageSize > 0 ? pageSize : 1),
+          descending_(descending) {
+        std::string order;
+        for (const auto& key : keys_) {
+            order += (order.empty() ? "" : ", ") + key + (descending_ ? " DESC" : "");
+            const auto& selects = query_.getSelects();
+            if (!selects.empty() && std::find(selects.begin(), selects.end(), key) == selects.end())
+                query_.select(key);
+        }
+        query_.orderBy(order).clearOffset();
+    }
+
+    // Next page; empty once the query is exhausted or a page failed
+    QueryResult next() {
+        if (done_)
+            return QueryResult();
+        QueryBuilder page = query_;
+        page.limit(page_size_);
+        if (last_)
+            page.seekAfter(keys_, *last_, descending_);
+
+        QueryResult res = db_.select(page);
+        if (res.rows() < static_cast<size_t>(page_size_))
+            done_ = true;
+        if (!res.empty() && !done_)
+            done_ = !rememberLast(res);
+        return res;
+    }
+
+    bool done() const { return done_; }
+
+  private:
+    bool rememberLast(const QueryResult& res) {
+        std::vector<std::string> values;
+        for (const auto& key : keys_) {
+            auto col = columnOf(res, key);
+            if (!col)
+                return false;
+            auto value = res.at(res.rows() - 1, *col);
+            if (!value)
+                return false;
+            values.push_back(std::move(*value));
+        }
+        last_ = std::move(values);
+        return true;
+    }
+
+    // Result columns drop the table qualifier: "u.id" comes back as "id"
+    static std::optional<size_t> columnOf(const QueryResult& res, const std::string& key) {
+        const auto& cols = res.columns();
+        size_t dot = key.rfind('.');
+        std::string bare = dot == std::string::npos ? key : key.substr(dot + 1);
+        for (size_t c = 0; c < cols.size(); ++c)
+            if (cols[c] == key || cols[c] == bare)
+                return c;
+        return std::nullopt;
+    }
+
+    IDatabase& db_;
+    QueryBuilder query_;
+    std::vector<std::string> keys_;
+    int page_size_;
+    bool descending_;
+    std::optional<std::vector<std::string>> last_;
+    bool done_ = false;
+};
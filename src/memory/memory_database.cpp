@@ -0,0 +1,831 @@
+#include "memory_database.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+#include "cell_parse.h"
+#include "spdlog/fmt/bundled/format.h"
+
+struct MemoryDatabase::Table {
+    // Parsed cell of a numeric column. Int64 columns keep integers exact (ids past 2^53
+    // included) and hold a double only for cells such as 1.5 that SQLite would store as REAL
+    // in an INTEGER column.
+    struct Number {
+        enum Kind : uint8_t { None, Integer, Real };
+
+        Kind kind = None;
+        int64_t i = 0;
+        double d = 0;
+    };
+
+    struct Column {
+        std::string name;
+        ColumnType type = ColumnType::Text;
+        std::vector<std::string> text;
+        std::vector<Number> number;  // Int64/Double columns only, None when not parsable
+        std::vector<uint8_t> null;
+
+        bool numeric() const { return type == ColumnType::Int64 || type == ColumnType::Double; }
+    };
+
+    std::vector<Column> columns;
+    size_t rows = 0;
+    std::map<size_t, IndexKind> indexed;
+    std::map<size_t, std::unordered_map<std::string, std::vector<uint32_t>>> hash;
+    std::map<size_t, std::vector<uint32_t>> ordered;  // non-NULL row ids sorted by value
+
+    std::optional<size_t> find(std::string_view name) const {
+        for (size_t c = 0; c < columns.size(); ++c)
+            if (columns[c].name == name)
+                return c;
+        return std::nullopt;
+    }
+
+    void rebuildIndexes();
+};
+
+struct MemoryDatabase::Catalog {
+    std::map<std::string, std::shared_ptr<const Table>> tables;
+};
+
+namespace {
+    using Table = MemoryDatabase::Table;
+    using Column = Table::Column;
+    using Number = Table::Number;
+
+    constexpr uint32_t kNoRow = UINT32_MAX;  // unmatched side of a LEFT JOIN
+
+    std::string_view trim(std::string_view s) {
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+            s.remove_prefix(1);
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    std::string upper(std::string_view s) {
+        std::string out(s);
+        for (char& ch : out) ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+        return out;
+    }
+
+    bool isIdentifier(std::string_view s) {
+        if (s.empty() || std::isdigit(static_cast<unsigned char>(s.front())))
+            return false;
+        return std::all_of(s.begin(), s.end(), [](char ch) {
+            return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_' || ch == '.';
+        });
+    }
+
+    // A whole-text integer or number, NaN not included; Double columns take no integers
+    Number parseNumber(std::string_view s, ColumnType type = ColumnType::Int64) {
+        Number n;
+        if (type != ColumnType::Double && parseInt64(s, n.i))
+            n.kind = Number::Integer;
+        else if (parseDouble(s, n.d) && !std::isnan(n.d))
+            n.kind = Number::Real;
+        return n;
+    }
+
+    // n as its column stores it: a Double column rounds integers like parseDouble() does
+    Number asColumn(const Column& col, Number n) {
+        if (col.type == ColumnType::Double && n.kind == Number::Integer)
+            return Number{Number::Real, 0, static_cast<double>(n.i)};
+        return n;
+    }
+
+    // Integer against double without rounding the integer
+    int compareMixed(int64_t i, double d) {
+        if (d >= 0x1p63)
+            return -1;
+        if (d < -0x1p63)
+            return 1;
+        const auto whole = static_cast<int64_t>(d);  // exact below 2^63
+        if (i != whole)
+            return i < whole ? -1 : 1;
+        const double fraction = d - static_cast<double>(whole);
+        return fraction > 0 ? -1 : (fraction < 0 ? 1 : 0);
+    }
+
+    int compareNumbers(const Number& a, const Number& b) {
+        if (a.kind == Number::Integer && b.kind == Number::Integer)
+            return a.i < b.i ? -1 : (a.i > b.i ? 1 : 0);
+        if (a.kind == Number::Integer)
+            return compareMixed(a.i, b.d);
+        if (b.kind == Number::Integer)
+            return -compareMixed(b.i, a.d);
+        return a.d < b.d ? -1 : (a.d > b.d ? 1 : 0);
+    }
+
+    // Hash key of a value; numeric columns key on the parsed number so 7, 7.0 and 007 meet,
+    // integers on their exact value
+    std::string indexKey(const Column& col, std::string_view value) {
+        if (!col.numeric())
+            return std::string(value);
+        Number n = parseNumber(value, col.type);
+        if (n.kind == Number::Real && n.d >= -0x1p63 && n.d < 0x1p63 && n.d == std::trunc(n.d))
+            n = Number{Number::Integer, static_cast<int64_t>(n.d), 0};
+        if (n.kind == Number::Integer)
+            return std::to_string(n.i);
+        if (n.kind == Number::Real)
+            return fmt::format("{}", n.d);
+        return std::string(value);
+    }
+
+    // Total order within a column: numbers (numeric columns) first, then text
+    int compareRows(const Column& col, uint32_t a, uint32_t b) {
+        if (col.numeric()) {
+            bool na = col.number[a].kind != Number::None, nb = col.number[b].kind != Number::None;
+            if (na && nb)
+                return compareNumbers(col.number[a], col.number[b]);
+            if (na != nb)
+                return na ? -1 : 1;
+        }
+        return col.text[a].compare(col.text[b]);
+    }
+
+    struct Literal {
+        explicit Literal(std::string value) : text(std::move(value)), number(parseNumber(text)) {}
+
+        std::string text;
+        Number number;
+    };
+
+    int compareLiteral(const Column& col, uint32_t row, const Literal& lit) {
+        if (col.numeric()) {
+            bool nr = col.number[row].kind != Number::None;
+            bool nl = lit.number.kind != Number::None;
+            if (nr && nl)
+                return compareNumbers(col.number[row], asColumn(col, lit.number));
+            if (nr != nl)
+                return nr ? -1 : 1;
+        }
+        return col.text[row].compare(lit.text);
+    }
+
+    enum class Op { Eq, Ne, Lt, Le, Gt, Ge, IsNull, NotNull };
+
+    struct ColumnRef {
+        size_t source;
+        size_t column;
+    };
+
+    struct Predicate {
+        ColumnRef ref;
+        Op op;
+        Literal literal;
+    };
+
+    struct OrderTerm {
+        ColumnRef ref;
+        bool descending;
+    };
+
+    struct Source {
+        std::string name;
+        std::string alias;
+        std::shared_ptr<const Table> table;
+    };
+
+    struct Output {
+        std::string name;
+        ColumnRef ref;
+    };
+
+    // Binds a QueryBuilder to one catalog snapshot; every parse step sets error on failure
+    class Plan {
+      public:
+        std::vector<Source> sources;
+        std::vector<Predicate> predicates;
+        std::vector<OrderTerm> order;
+        std::vector<std::pair<ColumnRef, Literal>> seek;  // multi-column seekAfter()
+        bool seekDescending = false;
+        std::vector<Output> outputs;
+        std::string error;
+
+        bool bindSource(const MemoryDatabase::Catalog& catalog, std::string_view spec) {
+            spec = trim(spec);
+            size_t space = spec.find_first_of(" \t");
+            std::string name(spec.substr(0, space));
+            std::string alias = name;
+            if (space != std::string_view::npos) {
+                std::string_view rest = trim(spec.substr(space));
+                if (upper(rest.substr(0, 3)) == "AS ")
+                    rest = trim(rest.substr(3));
+                if (!isIdentifier(rest))
+                    return fail(fmt::format("unsupported table expression '{}'", spec));
+                alias = std::string(rest);
+            }
+            auto it = catalog.tables.find(name);
+            if (it == catalog.tables.end())
+                return fail(fmt::format("no such table '{}'", name));
+            sources.push_back(Source{name, alias, it->second});
+            return true;
+        }
+
+        std::optional<ColumnRef> resolve(std::string_view ref) {
+            ref = trim(ref);
+            if (!isIdentifier(ref)) {
+                fail(fmt::format("'{}' is not a column reference", ref));
+                return std::nullopt;
+            }
+            size_t dot = ref.find('.');
+            std::string_view qualifier = dot == std::string_view::npos ? "" : ref.substr(0, dot);
+            std::string_view column = dot == std::string_view::npos ? ref : ref.substr(dot + 1);
+
+            std::optional<ColumnRef> found;
+            for (size_t s = 0; s < sources.size(); ++s) {
+                if (!qualifier.empty() && qualifier != sources[s].alias &&
+                    qualifier != sources[s].name)
+                    continue;
+                if (auto c = sources[s].table->find(column)) {
+                    if (found) {
+                        fail(fmt::format("column '{}' is ambiguous", ref));
+                        return std::nullopt;
+                    }
+                    found = ColumnRef{s, *c};
+                }
+            }
+            if (!found)
+                fail(fmt::format("no such column '{}'", ref));
+            return found;
+        }
+
+        bool addPredicate(std::string_view cond) {
+            cond = trim(cond);
+            std::string up = upper(cond);
+            for (auto [suffix, op] : {std::pair{std::string_view(" IS NOT NULL"), Op::NotNull},
+                                      std::pair{std::string_view(" IS NULL"), Op::IsNull}}) {
+                if (up.size() > suffix.size() &&
+                    std::string_view(up).substr(up.size() - suffix.size()) == suffix) {
+                    auto ref = resolve(cond.substr(0, cond.size() - suffix.size()));
+                    if (!ref)
+                        return false;
+                    predicates.push_back(Predicate{*ref, op, Literal("")});
+                    return true;
+                }
+            }
+
+            size_t at = cond.find_first_of("=<>!");
+            if (at == std::string_view::npos || at == 0)
+                return fail(fmt::format("unsupported condition '{}'", cond));
+            static const std::pair<std::string_view, Op> kOps[] = {
+                {"<=", Op::Le}, {">=", Op::Ge}, {"<>", Op::Ne}, {"!=", Op::Ne},
+                {"=", Op::Eq},  {"<", Op::Lt},  {">", Op::Gt}};
+            for (auto [token, op] : kOps) {
+                if (cond.substr(at, token.size()) != token)
+                    continue;
+                auto ref = resolve(cond.substr(0, at));
+                if (!ref)
+                    return false;
+                auto literal = parseLiteral(trim(cond.substr(at + token.size())));
+                if (!literal)
+                    return fail(fmt::format("unsupported condition '{}'", cond));
+                predicates.push_back(Predicate{*ref, op, std::move(*literal)});
+                return true;
+            }
+            return fail(fmt::format("unsupported condition '{}'", cond));
+        }
+
+        bool addEquals(std::string_view column, const std::string& value) {
+            auto ref = resolve(column);
+            if (!ref)
+                return false;
+            predicates.push_back(Predicate{*ref, Op::Eq, Literal(value)});
+            return true;
+        }
+
+        // Single-column seeks become a range predicate and can use an ordered index
+        bool addSeek(const std::vector<std::string>& columns,
+                     const std::vector<std::string>& values, bool descending) {
+            if (columns.empty() || columns.size() != values.size())
+                return fail("seekAfter needs one value per column");
+            for (size_t i = 0; i < columns.size(); ++i) {
+                auto ref = resolve(columns[i]);
+                if (!ref)
+                    return false;
+                seek.emplace_back(*ref, Literal(values[i]));
+            }
+            seekDescending = descending;
+            if (seek.size() == 1) {
+                predicates.push_back(Predicate{seek[0].first, descending ? Op::Lt : Op::Gt,
+                                               seek[0].second});
+                seek.clear();
+            }
+            return true;
+        }
+
+        bool addOrder(std::string_view expr) {
+            while (!expr.empty()) {
+                size_t comma = expr.find(',');
+                std::string_view term = trim(expr.substr(0, comma));
+                expr = comma == std::string_view::npos ? "" : expr.substr(comma + 1);
+
+                bool descending = false;
+                size_t space = term.find_last_of(" \t");
+                if (space != std::string_view::npos) {
+                    std::string dir = upper(term.substr(space + 1));
+                    if (dir != "ASC" && dir != "DESC")
+                        return fail(fmt::format("unsupported ORDER BY term '{}'", term));
+                    descending = dir == "DESC";
+                    term = trim(term.substr(0, space));
+                }
+                auto ref = resolve(term);
+                if (!ref)
+                    return false;
+                order.push_back(OrderTerm{*ref, descending});
+            }
+            return true;
+        }
+
+        bool addOutput(std::string_view expr) {
+            expr = trim(expr);
+            std::string up = upper(expr);
+            size_t as = up.find(" AS ");
+            std::optional<std::string> alias;
+            if (as != std::string::npos) {
+                alias = std::string(trim(expr.substr(as + 4)));
+                expr = trim(expr.substr(0, as));
+            }
+
+            if (expr == "*" || (expr.size() > 2 && expr.substr(expr.size() - 2) == ".*")) {
+                std::string_view qualifier = expr == "*" ? "" : expr.substr(0, expr.size() - 2);
+                bool matched = false;
+                for (size_t s = 0; s < sources.size(); ++s) {
+                    if (!qualifier.empty() && qualifier != sources[s].alias &&
+                        qualifier != sources[s].name)
+                        continue;
+                    matched = true;
+                    const auto& cols = sources[s].table->columns;
+                    for (size_t c = 0; c < cols.size(); ++c)
+                        outputs.push_back(Output{cols[c].name, ColumnRef{s, c}});
+                }
+                return matched || fail(fmt::format("no such table '{}'", qualifier));
+            }
+
+            auto ref = resolve(expr);
+            if (!ref)
+                return false;
+            outputs.push_back(Output{alias.value_or(column(*ref).name), *ref});
+            return true;
+        }
+
+        const Column& column(const ColumnRef& ref) const {
+            return sources[ref.source].table->columns[ref.column];
+        }
+
+        bool fail(std::string message) {
+            error = std::move(message);
+            return false;
+        }
+
+      private:
+        static std::optional<Literal> parseLiteral(std::string_view s) {
+            if (s.size() >= 2 && s.front() == '\'' && s.back() == '\'') {
+                std::string text;
+                for (size_t i = 1; i + 1 < s.size(); ++i) {
+                    if (s[i] == '\'') {
+                        if (s[i + 1] != '\'' || i + 2 >= s.size())
+                            return std::nullopt;
+                        ++i;
+                    }
+                    text += s[i];
+                }
+                return Literal(std::move(text));
+            }
+            if (parseNumber(s).kind != Number::None)
+                return Literal(std::string(s));
+            return std::nullopt;
+        }
+    };
+
+    bool matches(const Column& col, uint32_t row, const Predicate& p) {
+        bool isNull = row == kNoRow || col.null[row];
+        if (p.op == Op::IsNull)
+            return isNull;
+        if (p.op == Op::NotNull)
+            return !isNull;
+        if (isNull)
+            return false;
+        int cmp = compareLiteral(col, row, p.literal);
+        switch (p.op) {
+            case Op::Eq:
+                return cmp == 0;
+            case Op::Ne:
+                return cmp != 0;
+            case Op::Lt:
+                return cmp < 0;
+            case Op::Le:
+                return cmp <= 0;
+            case Op::Gt:
+                return cmp > 0;
+            case Op::Ge:
+                return cmp >= 0;
+            default:
+                return false;
+        }
+    }
+
+    // Row-value comparison (a, b) > (x, y); NULL keys never qualify
+    bool afterSeek(const Plan& plan, const uint32_t* tuple) {
+        for (const auto& [ref, literal] : plan.seek) {
+            uint32_t row = tuple[ref.source];
+            const Column& col = plan.column(ref);
+            if (row == kNoRow || col.null[row])
+                return false;
+            int cmp = compareLiteral(col, row, literal);
+            if (cmp != 0)
+                return plan.seekDescending ? cmp < 0 : cmp > 0;
+        }
+        return false;
+    }
+
+    // Base-table rows that can satisfy the predicates, narrowed through an index if possible
+    std::vector<uint32_t> candidates(const Plan& plan) {
+        const Table& base = *plan.sources[0].table;
+        for (const auto& p : plan.predicates) {
+            if (p.ref.source != 0 || p.op != Op::Eq)
+                continue;
+            auto it = base.hash.find(p.ref.column);
+            if (it == base.hash.end())
+                continue;
+            auto hit = it->second.find(indexKey(plan.column(p.ref), p.literal.text));
+            return hit == it->second.end() ? std::vector<uint32_t>() : hit->second;
+        }
+        for (const auto& p : plan.predicates) {
+            if (p.ref.source != 0 || p.op == Op::Ne || p.op == Op::IsNull || p.op == Op::NotNull)
+                continue;
+            auto it = base.ordered.find(p.ref.column);
+            if (it == base.ordered.end())
+                continue;
+            const Column& col = plan.column(p.ref);
+            const auto& ids = it->second;
+            auto cmp = [&](uint32_t row) { return compareLiteral(col, row, p.literal); };
+            // First id at or after `from` whose value compares >= bound against the literal
+            auto firstFrom = [&](std::vector<uint32_t>::const_iterator from, int bound) {
+                return std::partition_point(from, ids.end(),
+                                            [&](uint32_t r) { return cmp(r) < bound; });
+            };
+            auto lo = ids.begin(), hi = ids.end();
+            if (p.op == Op::Eq || p.op == Op::Ge)
+                lo = firstFrom(ids.begin(), 0);
+            if (p.op == Op::Gt)
+                lo = firstFrom(ids.begin(), 1);
+            if (p.op == Op::Eq || p.op == Op::Le)
+                hi = firstFrom(lo, 1);
+            if (p.op == Op::Lt)
+                hi = firstFrom(lo, 0);
+            return std::vector<uint32_t>(lo, hi);
+        }
+        std::vector<uint32_t> all(base.rows);
+        std::iota(all.begin(), all.end(), 0u);
+        return all;
+    }
+}  // namespace
+
+void MemoryDatabase::Table::rebuildIndexes() {
+    hash.clear();
+    ordered.clear();
+    for (auto [c, kind] : indexed) {
+        const Column& col = columns[c];
+        if (kind == IndexKind::Hash) {
+            auto& index = hash[c];
+            for (uint32_t r = 0; r < rows; ++r)
+                if (!col.null[r])
+                    index[indexKey(col, col.text[r])].push_back(r);
+        } else {
+            auto& ids = ordered[c];
+            for (uint32_t r = 0; r < rows; ++r)
+                if (!col.null[r])
+                    ids.push_back(r);
+            std::stable_sort(ids.begin(), ids.end(),
+                             [&col](uint32_t a, uint32_t b) { return compareRows(col, a, b) < 0; });
+        }
+    }
+}
+
+MemoryDatabase::MemoryDatabase(ConnectionConfig cfg, ILogger* logger)
+    : IDatabase(std::move(cfg), logger), catalog_(std::make_shared<const Catalog>()) {}
+
+MemoryDatabase::~MemoryDatabase() = default;
+
+bool MemoryDatabase::open() {
+    open_ = true;
+    return true;
+}
+
+// Tables live as long as the object; close() only stops serving queries
+void MemoryDatabase::close() { open_ = false; }
+
+bool MemoryDatabase::is_open() const { return open_; }
+
+bool MemoryDatabase::insert(const QueryBuilder& qb) {
+    if (qb.getCancellation() && qb.getCancellation()->cancelled()) {
+        setStatus(QueryStatus::Cancelled);
+        return false;
+    }
+    bool ok = runInsert(qb);
+    setStatus(ok ? QueryStatus::Ok : QueryStatus::Failed);
+    return ok;
+}
+
+bool MemoryDatabase::runInsert(const QueryBuilder& qb) {
+    if (qb.getKind() != QueryBuilder::Kind::Insert || !qb.isValid()) {
+        logger_->error(fmt::format("Memory backend cannot run '{}': use insertInto().values().",
+                                   qb.str()));
+        return false;
+    }
+    std::shared_ptr<const Catalog> snapshot = catalog_.load();
+    auto it = snapshot->tables.find(qb.getTable());
+    if (it == snapshot->tables.end()) {
+        logger_->error(fmt::format("No memory table named {}.", qb.getTable()));
+        return false;
+    }
+
+    // Reorder the builder's columns into table order; unlisted columns stay NULL
+    const Table& table = *it->second;
+    std::vector<size_t> target;
+    for (const auto& name : qb.getInsertColumns()) {
+        auto c = table.find(name);
+        if (!c) {
+            logger_->error(fmt::format("No column {} in memory table {}.", name, qb.getTable()));
+            return false;
+        }
+        target.push_back(*c);
+    }
+    std::vector<std::string> names;
+    for (const auto& col : table.columns) names.push_back(col.name);
+    QueryResult rows({}, std::move(names));
+    for (const auto& values : qb.getInsertRows()) {
+        QueryResult::Cells cells(table.columns.size());
+        for (size_t i = 0; i < target.size() && i < values.size(); ++i)
+            if (values[i])
+                cells[target[i]] = *values[i];
+        rows.append_cells(cells);
+    }
+    return insertRows(qb.getTable(), rows);
+}
+
+bool MemoryDatabase::update(const QueryBuilder& qb) {
+    logger_->error(fmt::format("Memory backend cannot run '{}' as an update.", qb.str()));
+    return false;
+}
+
+bool MemoryDatabase::remove(const QueryBuilder& qb) {
+    logger_->error(fmt::format("Memory backend cannot run '{}' as a delete.", qb.str()));
+    return false;
+}
+
+bool MemoryDatabase::createTable(const std::string& name, const std::vector<std::string>& columns,
+                                 const std::vector<ColumnType>& types) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    std::shared_ptr<const Catalog> current = catalog_.load();
+    if (current->tables.count(name)) {
+        logger_->error(fmt::format("Memory table {} already exists.", name));
+        return false;
+    }
+    auto table = std::make_shared<Table>();
+    for (size_t c = 0; c < columns.size(); ++c) {
+        Column col;
+        col.name = columns[c];
+        col.type = c < types.size() ? types[c] : ColumnType::Text;
+        table->columns.push_back(std::move(col));
+    }
+    auto next = std::make_shared<Catalog>(*current);
+    next->tables[name] = std::move(table);
+    catalog_.store(std::move(next));
+    return true;
+}
+
+template <typename Fn>
+bool MemoryDatabase::modifyTable(const std::string& name, Fn&& fn) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    std::shared_ptr<const Catalog> current = catalog_.load();
+    auto it = current->tables.find(name);
+    if (it == current->tables.end()) {
+        logger_->error(fmt::format("No memory table named {}.", name));
+        return false;
+    }
+    auto table = std::make_shared<Table>(*it->second);
+    if (!fn(*table))
+        return false;
+    table->rebuildIndexes();
+    auto next = std::make_shared<Catalog>(*current);
+    next->tables[name] = std::move(table);
+    catalog_.store(std::move(next));
+    return true;
+}
+
+bool MemoryDatabase::createIndex(const std::string& table, const std::string& column,
+                                 IndexKind kind) {
+    return modifyTable(table, [&](Table& t) {
+        auto c = t.find(column);
+        if (!c) {
+            logger_->error(fmt::format("Cannot index {}.{}: no such column.", table, column));
+            return false;
+        }
+        t.indexed[*c] = kind;
+        return true;
+    });
+}
+
+bool MemoryDatabase::insertRows(const std::string& table, const QueryResult& rows) {
+    return modifyTable(table, [&](Table& t) {
+        if (rows.rows() + t.rows >= kNoRow) {
+            logger_->error(fmt::format("Memory table {} is full.", table));
+            return false;
+        }
+        for (size_t c = 0; c < t.columns.size(); ++c) {
+            Column& col = t.columns[c];
+            for (size_t r = 0; r < rows.rows(); ++r) {
+                std::optional<std::string> cell = c < rows.cols() ? rows.at(r, c) : std::nullopt;
+                col.null.push_back(!cell);
+                if (col.numeric())
+                    col.number.push_back(cell ? parseNumber(*cell, col.type) : Number{});
+                col.text.push_back(cell.value_or(std::string()));
+            }
+        }
+        t.rows += rows.rows();
+        return true;
+    });
+}
+
+QueryResult MemoryDatabase::select(const QueryBuilder& qb) {
+    if (qb.getCancellation() && qb.getCancellation()->cancelled()) {
+        setStatus(QueryStatus::Cancelled);
+        return QueryResult();
+    }
+    QueryResult result = runSelect(qb);
+    if (result.rejected()) {
+        logger_->error(result.spill_error()
+                           ? "Memory SELECT failed, its spill file cannot grow."
+                           : "Memory SELECT rejected, process memory over its soft limit.");
+        result = QueryResult();
+    }
+    setStatus(result.columns().empty() ? QueryStatus::Failed : QueryStatus::Ok);
+    return result;
+}
+
+QueryResult MemoryDatabase::runSelect(const QueryBuilder& qb) {
+    if (!open_) {
+        logger_->error("Memory database is not open.");
+        return QueryResult();
+    }
+    std::shared_ptr<const Catalog> snapshot = catalog_.load();
+
+    Plan plan;
+    bool ok = plan.bindSource(*snapshot, qb.getTable());
+    for (const auto& join : qb.getJoins()) {
+        if (!ok)
+            break;
+        std::string type = upper(join.type);
+        if (type != "INNER" && type != "LEFT")
+            ok = plan.fail(fmt::format("{} JOIN is not supported", join.type));
+        else
+            ok = plan.bindSource(*snapshot, join.table);
+    }
+    for (const auto& cond : qb.getWheres()) ok = ok && plan.addPredicate(cond);
+    for (const auto& [column, value] : qb.getWhereEquals())
+        ok = ok && plan.addEquals(column, value);
+    if (ok && qb.getSeekColumns())
+        ok = plan.addSeek(*qb.getSeekColumns(), *qb.getSeekValues(), qb.isSeekDescending());
+    if (ok && qb.getEffectiveOrderBy())
+        ok = plan.addOrder(*qb.getEffectiveOrderBy());
+    if (ok && qb.getSelects().empty())
+        ok = plan.addOutput("*");
+    for (const auto& expr : qb.getSelects()) ok = ok && plan.addOutput(expr);
+    if (!ok) {
+        logger_->error(fmt::format("Memory backend cannot run '{}': {}.", qb.str(), plan.error));
+        return QueryResult();
+    }
+
+    // Tuples hold one row id per source, flattened
+    const size_t width = plan.sources.size();
+    std::vector<uint32_t> tuples;
+    for (uint32_t row : candidates(plan)) {
+        bool keep = true;
+        for (const auto& p : plan.predicates)
+            if (p.ref.source == 0 && !matches(plan.column(p.ref), row, p)) {
+                keep = false;
+                break;
+            }
+        if (!keep)
+            continue;
+        tuples.push_back(row);
+        tuples.insert(tuples.end(), width - 1, kNoRow);
+    }
+
+    const auto& joins = qb.getJoins();
+    for (size_t j = 0; j < joins.size(); ++j) {
+        const size_t source = j + 1;
+        auto left = plan.resolve(joins[j].onLeft), right = plan.resolve(joins[j].onRight);
+        if (left && left->source == source)
+            std::swap(left, right);
+        if (!left || !right || right->source != source || left->source >= source) {
+            logger_->error(fmt::format("Memory backend cannot run '{}': join condition {} = {} "
+                                       "must link {} to an earlier table.",
+                                       qb.str(), joins[j].onLeft, joins[j].onRight,
+                                       joins[j].table));
+            return QueryResult();
+        }
+
+        const Table& inner = *plan.sources[source].table;
+        const Column& innerCol = inner.columns[right->column];
+        const Column& outerCol = plan.column(*left);
+        std::unordered_map<std::string, std::vector<uint32_t>> built;
+        const std::unordered_map<std::string, std::vector<uint32_t>>* lookup = &built;
+        if (auto it = inner.hash.find(right->column); it != inner.hash.end()) {
+            lookup = &it->second;
+        } else {
+            for (uint32_t r = 0; r < inner.rows; ++r)
+                if (!innerCol.null[r])
+                    built[indexKey(innerCol, innerCol.text[r])].push_back(r);
+        }
+
+        const bool leftJoin = upper(joins[j].type) == "LEFT";
+        std::vector<uint32_t> next;
+        for (size_t t = 0; t < tuples.size(); t += width) {
+            uint32_t outer = tuples[t + left->source];
+            const std::vector<uint32_t>* hits = nullptr;
+            if (outer != kNoRow && !outerCol.null[outer]) {
+                auto it = lookup->find(indexKey(innerCol, outerCol.text[outer]));
+                if (it != lookup->end())
+                    hits = &it->second;
+            }
+            if (hits) {
+                for (uint32_t r : *hits) {
+                    next.insert(next.end(), tuples.begin() + t, tuples.begin() + t + width);
+                    next[next.size() - width + source] = r;
+                }
+            } else if (leftJoin) {
+                next.insert(next.end(), tuples.begin() + t, tuples.begin() + t + width);
+            }
+        }
+        tuples = std::move(next);
+    }
+
+    std::vector<size_t> order;
+    for (size_t t = 0; t < tuples.size(); t += width) {
+        bool keep = true;
+        for (const auto& p : plan.predicates)
+            if (p.ref.source != 0 && !matches(plan.column(p.ref), tuples[t + p.ref.source], p)) {
+                keep = false;
+                break;
+            }
+        if (keep && !plan.seek.empty())
+            keep = afterSeek(plan, tuples.data() + t);
+        if (keep)
+            order.push_back(t);
+    }
+
+    size_t offset = qb.getOffset() ? static_cast<size_t>(std::max(0, *qb.getOffset())) : 0;
+    size_t limit = qb.getLimit() ? static_cast<size_t>(std::max(0, *qb.getLimit())) : SIZE_MAX;
+    if (!plan.order.empty()) {
+        // NULL sorts first ascending, last descending; ties keep scan order
+        auto less = [&](size_t a, size_t b) {
+            for (const auto& term : plan.order) {
+                const Column& col = plan.column(term.ref);
+                uint32_t ra = tuples[a + term.ref.source], rb = tuples[b + term.ref.source];
+                bool nullA = ra == kNoRow || col.null[ra], nullB = rb == kNoRow || col.null[rb];
+                int cmp = nullA || nullB ? (nullA == nullB ? 0 : (nullA ? -1 : 1))
+                                         : compareRows(col, ra, rb);
+                if (cmp != 0)
+                    return term.descending ? cmp > 0 : cmp < 0;
+            }
+            return a < b;
+        };
+        size_t keep = limit == SIZE_MAX ? order.size() : std::min(order.size(), offset + limit);
+        std::partial_sort(order.begin(), order.begin() + keep, order.end(), less);
+        order.resize(keep);
+    }
+
+    std::vector<std::string> names;
+    std::vector<ColumnType> types;
+    for (const auto& out : plan.outputs) {
+        names.push_back(out.name);
+        types.push_back(plan.column(out.ref).type);
+    }
+    QueryResult result({}, std::move(names));
+    result.set_column_types(std::move(types));
+    result.set_spill_policy({config_.result_memory_limit, config_.spill_dir});
+
+    QueryResult::Cells cells(plan.outputs.size());
+    for (size_t i = offset; i < order.size() && i - offset < limit; ++i) {
+        for (size_t o = 0; o < plan.outputs.size(); ++o) {
+            const ColumnRef& ref = plan.outputs[o].ref;
+            const Column& col = plan.column(ref);
+            uint32_t row = tuples[order[i] + ref.source];
+            cells[o] = row == kNoRow || col.null[row]
+                           ? std::nullopt
+                           : std::optional<std::string_view>(col.text[row]);
+        }
+        result.append_cells(cells);
+    }
+    return result;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "database.h"
+
+// Embedded columnar table engine for small reference tables, no SQL involved. select()
+// evaluates the QueryBuilder directly: ANDed `column op literal` conditions (=, !=, <>, <, <=,
+// >, >=, IS [NOT] NULL), INNER/LEFT equi-joins, ORDER BY column lists, LIMIT and OFFSET.
+// Equality uses a hash index and ranges an ordered index when the column has one. Any other
+// shape is logged and fails. insert() takes insertInto().values() builders; update() and
+// remove() are not supported.
+//
+// Reads are RCU-style: a query loads one snapshot of the catalog and never takes a lock.
+// Writers copy the table they touch, rebuild its indexes and publish a new snapshot, so bulk
+// loads should go through insertRows() rather than row by row.
+class MemoryDatabase : public IDatabase {
+  public:
+    enum class IndexKind { Hash, Ordered };
+
+    MemoryDatabase(ConnectionConfig cfg, ILogger* logger);
+    ~MemoryDatabase() override;
+
+    bool open() override;
+    void close() override;
+    bool is_open() const override;
+
+    bool insert(const QueryBuilder& qb) override;
+    bool update(const QueryBuilder& qb) override;
+    bool remove(const QueryBuilder& qb) override;
+    QueryResult select(const QueryBuilder& qb) override;
+
+    // Missing types default to Text; Int64 and Double columns compare numerically
+    bool createTable(const std::string& name, const std::vector<std::string>& columns,
+                     const std::vector<ColumnType>& types = {});
+    bool createIndex(const std::string& table, const std::string& column, IndexKind kind);
+    // Appends all rows (cells matched to columns by position) in a single snapshot swap
+    bool insertRows(const std::string& table, const QueryResult& rows);
+
+    MemoryDatabase(const MemoryDatabase&) = delete;
+    MemoryDatabase& operator=(const MemoryDatabase&) = delete;
+
+    struct Table;
+    struct Catalog;
+
+  private:
+    // select() and insert() without the status bookkeeping; queries run in memory and are
+    // not interrupted, a token cancelled before the call fails them with Cancelled
+    QueryResult runSelect(const QueryBuilder& qb);
+    bool runInsert(const QueryBuilder& qb);
+
+    // Copies the catalog and table under write_mutex_, applies fn and publishes the result
+    template <typename Fn>
+    bool modifyTable(const std::string& name, Fn&& fn);
+
+    std::atomic<std::shared_ptr<const Catalog>> catalog_;
+    std::mutex write_mutex_;
+    std::atomic<bool> open_{false};
+};
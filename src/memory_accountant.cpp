@@ -0,0 +1,55 @@
+#include "memory_accountant.h"
+
+MemoryAccountant& MemoryAccountant::instance() {
+    static MemoryAccountant accountant;
+    return accountant;
+}
+
+void MemoryAccountant::setLimit(Limit limit) {
+    soft_bytes_.store(limit.soft_bytes, std::memory_order_relaxed);
+    large_result_.store(limit.large_result, std::memory_order_relaxed);
+    action_.store(limit.action, std::memory_order_relaxed);
+    enable();
+}
+
+MemoryAccountant::Limit MemoryAccountant::limit() const {
+    Limit limit;
+    limit.soft_bytes = soft_bytes_.load(std::memory_order_relaxed);
+    limit.large_result = large_result_.load(std::memory_order_relaxed);
+    limit.action = action_.load(std::memory_order_relaxed);
+    return limit;
+}
+
+MemoryAccountant::Admit MemoryAccountant::charge(Category category, size_t bytes,
+                                                 size_t holder_total) {
+    size_t soft = soft_bytes_.load(std::memory_order_relaxed);
+    // Soft: concurrent holders may each pass the check and overshoot by a step
+    if (soft && holder_total >= large_result_.load(std::memory_order_relaxed) &&
+        live() + bytes > soft)
+        return action_.load(std::memory_order_relaxed) == Admit::Reject ? Admit::Reject
+                                                                         : Admit::Spill;
+    add(category, bytes);
+    return Admit::Ok;
+}
+
+void MemoryAccountant::add(Category category, size_t bytes) {
+    live_[static_cast<size_t>(category)].fetch_add(bytes, std::memory_order_relaxed);
+    size_t now = live();
+    size_t seen = peak_.load(std::memory_order_relaxed);
+    while (now > seen && !peak_.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryAccountant::release(Category category, size_t bytes) {
+    live_[static_cast<size_t>(category)].fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t MemoryAccountant::live() const {
+    size_t total = 0;
+    for (const auto& bytes : live_) total += bytes.load(std::memory_order_relaxed);
+    return total;
+}
+
+size_t MemoryAccountant::live(Category category) const {
+    return live_[static_cast<size_t>(category)].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Process-wide tally of the bytes held by query results and result caches. Off until enable()
+// or setLimit(); while off, holders charge nothing and pay one relaxed load per append.
+// With a soft limit, a large result that would take the process past it spills its further
+// rows to disk or is rejected, while small results are always admitted.
+class MemoryAccountant {
+  public:
+    enum class Category { Results, Cache, Other };
+    enum class Admit { Ok, Spill, Reject };
+
+    struct Limit {
+        size_t soft_bytes = 0;                  // 0 = no limit
+        size_t large_result = size_t{1} << 20;  // holders below this size are always admitted
+        Admit action = Admit::Spill;            // Spill or Reject
+    };
+
+    static MemoryAccountant& instance();
+
+    void enable(bool on = true) { enabled_.store(on, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    // Also enables accounting
+    void setLimit(Limit limit);
+    Limit limit() const;
+
+    // Admission of bytes more for a holder that then holds holder_total; nothing is charged
+    // unless the answer is Ok
+    Admit charge(Category category, size_t bytes, size_t holder_total);
+    // Charges memory that already exists, such as a copy, without asking
+    void add(Category category, size_t bytes);
+    void release(Category category, size_t bytes);
+
+    size_t live() const;
+    size_t live(Category category) const;
+    size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+    MemoryAccountant(const MemoryAccountant&) = delete;
+    MemoryAccountant& operator=(const MemoryAccountant&) = delete;
+
+  private:
+    MemoryAccountant() = default;
+
+    std::atomic<bool> enabled_{false};
+    std::atomic<size_t> soft_bytes_{0};
+    std::atomic<size_t> large_result_{size_t{1} << 20};
+    std::atomic<Admit> action_{Admit::Spill};
+    std::array<std::atomic<size_t>, 3> live_{};
+    std::atomic<size_t> peak_{0};
+};
+
+// Bytes one holder has charged to the accountant, given back when the lease goes away. The
+// charge grows in steps of kStep so a growing result rarely touches the shared counters.
+// Copies charge their own bytes under the same category; moves take the charge along.
+class MemoryLease {
+  public:
+    using Category = MemoryAccountant::Category;
+    static constexpr size_t kStep = 64 * 1024;
+
+    explicit MemoryLease(Category category = Category::Results) : category_(category) {}
+    MemoryLease(const MemoryLease& other) : category_(other.category_) { force(other.charged_); }
+    MemoryLease(MemoryLease&& other) noexcept
+        : category_(other.category_), charged_(other.charged_) {
+        other.charged_ = 0;
+    }
+    MemoryLease& operator=(const MemoryLease& other) {
+        if (this != &other) {
+            reset();
+            category_ = other.category_;
+            force(other.charged_);
+        }
+        return *this;
+    }
+    MemoryLease& operator=(MemoryLease&& other) noexcept {
+        if (this != &other) {
+            reset();
+            category_ = other.category_;
+            charged_ = other.charged_;
+            other.charged_ = 0;
+        }
+        return *this;
+    }
+    ~MemoryLease() { reset(); }
+
+    // Covers a holder that now holds bytes in total
+    MemoryAccountant::Admit grow(size_t bytes) {
+        if (bytes <= charged_ || !MemoryAccountant::instance().enabled())
+            return MemoryAccountant::Admit::Ok;
+        size_t target = (bytes + kStep - 1) / kStep * kStep;
+        auto admit = MemoryAccountant::instance().charge(category_, target - charged_, bytes);
+        if (admit == MemoryAccountant::Admit::Ok)
+            charged_ = target;
+        return admit;
+    }
+    // Charges bytes already held, without admission
+    void force(size_t bytes) {
+        if (bytes <= charged_ || !MemoryAccountant::instance().enabled())
+            return;
+        MemoryAccountant::instance().add(category_, bytes - charged_);
+        charged_ = bytes;
+    }
+    void reset() {
+        if (charged_)
+            MemoryAccountant::instance().release(category_, charged_);
+        charged_ = 0;
+    }
+
+    // Moves the charge to another category
+    void set_category(Category category) {
+        if (category == category_)
+            return;
+        size_t bytes = charged_;
+        reset();
+        category_ = category;
+        if (bytes) {
+            MemoryAccountant::instance().add(category_, bytes);
+            charged_ = bytes;
+        }
+    }
+    Category category() const { return category_; }
+    size_t charged() const { return charged_; }
+
+  private:
+    Category category_;
+    size_t charged_ = 0;
+};
@@ -0,0 +1,153 @@
+#include "mock_database.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+
+#include "spdlog/fmt/bundled/format.h"
+
+MockDatabase::MockDatabase(ConnectionConfig cfg, ILogger* logger)
+    : IDatabase(std::move(cfg), logger), rng_(config_.mock.seed) {}
+
+bool MockDatabase::open() {
+    open_ = true;
+    return true;
+}
+
+void MockDatabase::close() { open_ = false; }
+
+bool MockDatabase::is_open() const { return open_; }
+
+bool MockDatabase::insert(const QueryBuilder& qb) { return serve(Op::Insert, qb); }
+
+bool MockDatabase::update(const QueryBuilder& qb) { return serve(Op::Update, qb); }
+
+bool MockDatabase::remove(const QueryBuilder& qb) { return serve(Op::Remove, qb); }
+
+std::optional<size_t> MockDatabase::upsert(const QueryBuilder& qb) {
+    if (!serve(Op::Upsert, qb))
+        return std::nullopt;
+    return qb.getInsertRows().size();
+}
+
+QueryResult MockDatabase::select(const QueryBuilder& qb) {
+    if (!serve(Op::Select, qb))
+        return QueryResult();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = results_.find(qb.str());
+    if (it == results_.end())
+        it = results_.find(qb.getTable());
+    return it != results_.end() ? it->second : default_result_;
+}
+
+void MockDatabase::addResult(const std::string& key, QueryResult result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    results_[key] = std::move(result);
+}
+
+void MockDatabase::setDefaultResult(QueryResult result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    default_result_ = std::move(result);
+}
+
+std::vector<MockDatabase::Call> MockDatabase::calls() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return calls_;
+}
+
+void MockDatabase::clearCalls() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    calls_.clear();
+    peak_ = 0;
+}
+
+int MockDatabase::peakConcurrency() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return peak_;
+}
+
+std::chrono::microseconds MockDatabase::drawLatency() {
+    const MockConfig& m = config_.mock;
+    double us = 0;
+    switch (m.latency) {
+        case MockConfig::Latency::None:
+            break;
+        case MockConfig::Latency::Fixed:
+            us = m.latency_us;
+            break;
+        case MockConfig::Latency::Uniform:
+            us = std::uniform_real_distribution<double>(m.latency_us - m.latency_spread_us,
+                                                        m.latency_us + m.latency_spread_us)(rng_);
+            break;
+        case MockConfig::Latency::Normal:
+            us = std::normal_distribution<double>(m.latency_us, m.latency_spread_us)(rng_);
+            break;
+        case MockConfig::Latency::Exponential:
+            if (m.latency_us > 0)
+                us = std::exponential_distribution<double>(1.0 / m.latency_us)(rng_);
+            break;
+    }
+    return std::chrono::microseconds(static_cast<int64_t>(std::max(0.0, us)));
+}
+
+bool MockDatabase::serve(Op op, const QueryBuilder& qb) {
+    if (!open_) {
+        logger_->error("Mock database is not open.");
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::chrono::microseconds latency;
+    bool failed;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const int limit = config_.mock.max_concurrency;
+        slot_cv_.wait(lock, [&] { return limit <= 0 || active_ < limit; });
+        peak_ = std::max(peak_, ++active_);
+        // Draw both values under the lock so the sequence only depends on call order
+        latency = drawLatency();
+        failed = config_.mock.error_rate > 0 &&
+                 std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < config_.mock.error_rate;
+        calls_.push_back(Call{op, qb, latency, failed});
+    }
+
+    // The latency stands in for server time, so a timeout or cancellation cuts it short
+    auto done = std::chrono::steady_clock::now() + latency;
+    const bool timedOut = qb.getTimeout() && start + *qb.getTimeout() < done;
+    if (timedOut)
+        done = start + *qb.getTimeout();
+    bool cancelled = false;
+    std::mutex wait_mutex;
+    std::condition_variable wake;
+    std::optional<uint64_t> callback;
+    if (qb.getCancellation()) {
+        callback = qb.getCancellation()->onCancel([&] {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            cancelled = true;
+            wake.notify_all();
+        });
+    }
+    {
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        wake.wait_until(lock, done, [&] { return cancelled; });
+    }
+    if (callback)
+        qb.getCancellation()->removeCallback(*callback);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --active_;
+    }
+    slot_cv_.notify_one();
+
+    if (cancelled || timedOut) {
+        setStatus(cancelled ? QueryStatus::Cancelled : QueryStatus::TimedOut);
+        return false;
+    }
+    if (failed)
+        logger_->error(fmt::format("Mock injected failure for: {}", qb.str()));
+    setStatus(failed ? QueryStatus::Failed : QueryStatus::Ok);
+    return !failed;
+}
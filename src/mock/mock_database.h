@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "database.h"
+
+// In-process backend with no server behind it: serves canned results, injects latency and
+// errors according to ConnectionConfig::mock, and records every query it receives. Meant for
+// measuring the library's own overhead and scheduling in tests and benchmarks.
+class MockDatabase : public IDatabase {
+  public:
+    enum class Op { Insert, Update, Remove, Select, Upsert };
+
+    struct Call {
+        Op op;
+        QueryBuilder query;
+        std::chrono::microseconds latency;  // injected delay, excluding waits for a slot
+        bool failed;
+    };
+
+    MockDatabase(ConnectionConfig cfg, ILogger* logger);
+
+    bool open() override;
+    void close() override;
+    bool is_open() const override;
+
+    bool insert(const QueryBuilder& qb) override;
+    bool update(const QueryBuilder& qb) override;
+    bool remove(const QueryBuilder& qb) override;
+    QueryResult select(const QueryBuilder& qb) override;
+    // Reports every VALUES row as affected
+    std::optional<size_t> upsert(const QueryBuilder& qb) override;
+
+    // key is matched against the full SQL first, then against the table name; selects that
+    // match neither get the default result (empty unless set)
+    void addResult(const std::string& key, QueryResult result);
+    void setDefaultResult(QueryResult result);
+
+    std::vector<Call> calls() const;
+    void clearCalls();
+    // Most calls that were inside the backend at the same time
+    int peakConcurrency() const;
+
+  private:
+    // Waits for a slot, sleeps the drawn latency and records the call; false = injected error
+    bool serve(Op op, const QueryBuilder& qb);
+    std::chrono::microseconds drawLatency();
+
+    std::atomic<bool> open_{false};
+
+    mutable std::mutex mutex_;
+    std::condition_variable slot_cv_;
+    int active_ = 0;
+    int peak_ = 0;
+    std::mt19937_64 rng_;
+    std::vector<Call> calls_;
+    std::map<std::string, QueryResult> results_;
+    QueryResult default_result_;
+};
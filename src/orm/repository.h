@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "database.h"
+#include "orm/table.h"
+
+// CRUD on a struct mapped with ARMORY_TABLE. Each call copies a builder made once in the
+// constructor, with the statement's full shape, and rebinds the row's values into it; the
+// statement text comes precompiled from TableSql, so nothing is rendered or looked up by name
+// per call. Backends that read the builder instead of SQL (MemoryDatabase) see the same
+// statement. A NULL key matches no row and fails the call without reaching the database.
+template <typename T>
+class Repository {
+  public:
+    using Mapping = TableMapping<T>;
+    using Sql = TableSql<T>;
+    using Key = std::remove_cvref_t<decltype(std::declval<T&>().*std::get<0>(Mapping::fields))>;
+
+    explicit Repository(IDatabase& db) : db_(db) {
+        std::vector<std::string> columns(Mapping::columns.begin(), Mapping::columns.end());
+        const std::string table(Mapping::table);
+        const std::string& key = columns.front();
+
+        insert_.insertInto(table, columns)
+            .values(QueryBuilder::Params(columns.size()))
+            .precompiled(Sql::Insert::question.view(), Sql::Insert::numbered.view());
+        update_.update(table);
+        for (size_t i = 1; i < columns.size(); ++i) update_.set(columns[i], std::nullopt);
+        update_.whereEquals(key, "").precompiled(Sql::Update::question.view(),
+                                                 Sql::Update::numbered.view());
+        remove_.deleteFrom(table).whereEquals(key, "").precompiled(
+            Sql::Remove::question.view(), Sql::Remove::numbered.view());
+        for (const auto& column : columns) {
+            select_.select(column);
+            find_.select(column);
+        }
+        select_.table(table);
+        find_.table(table).whereEquals(key, "").precompiled(Sql::SelectByKey::question.view(),
+                                                            Sql::SelectByKey::numbered.view());
+    }
+
+    // Readies the statements ahead of the first call, server-side on PostgreSQL (see warmUp())
+    bool prepare() {
+        bool ok = db_.prepare(insert_) && db_.prepare(find_) && db_.prepare(remove_);
+        if constexpr (Mapping::columns.size() > 1)
+            ok = ok && db_.prepare(update_);
+        return ok;
+    }
+
+    bool insert(const T& row) {
+        QueryBuilder qb = insert_;
+        return qb.rebind(encodeRow(row)) && db_.insert(qb);
+    }
+
+    // Sets every other column of the row whose key is row's key
+    bool update(const T& row) {
+        static_assert(Mapping::columns.size() > 1, "a table of only the key has nothing to set");
+        // The SET values come first, the key last
+        QueryBuilder::Params params = encodeRow(row);
+        std::rotate(params.begin(), params.begin() + 1, params.end());
+        QueryBuilder qb = update_;
+        return qb.rebind(std::move(params)) && db_.update(qb);
+    }
+
+    bool remove(const Key& key) {
+        QueryBuilder qb = remove_;
+        return qb.rebind({ColumnCodec<Key>::encode(key)}) && db_.remove(qb);
+    }
+
+    // Empty when no row has key, when the select failed (IDatabase::lastStatus() says so) or
+    // when the row does not decode into T
+    std::optional<T> find(const Key& key) {
+        QueryBuilder qb = find_;
+        if (!qb.rebind({ColumnCodec<Key>::encode(key)}))
+            return std::nullopt;
+        QueryResult result = db_.select(qb);
+        T row{};
+        if (result.empty() || !decodeRow(result, 0, row))
+            return std::nullopt;
+        return row;
+    }
+
+    // Rows matching filter, of which only the conditions, orderBy(), limit() and offset() are
+    // used: table and select list are the mapping's. std::nullopt on failure or when a row
+    // does not decode.
+    std::optional<std::vector<T>> select(QueryBuilder filter = {}) {
+        QueryBuilder qb = select_;
+        for (const auto& cond : filter.getWheres()) qb.where(cond);
+        for (const auto& [column, value] : filter.getWhereEquals()) qb.whereEquals(column, value);
+        if (filter.getOrderBy())
+            qb.orderBy(*filter.getOrderBy());
+        if (filter.getLimit())
+            qb.limit(*filter.getLimit());
+        if (filter.getOffset())
+            qb.offset(*filter.getOffset());
+
+        QueryResult result = db_.select(qb);
+        if (result.columns().empty())
+            return std::nullopt;
+        std::vector<T> rows(result.rows());
+        for (size_t r = 0; r < rows.size(); ++r)
+            if (!decodeRow(result, r, rows[r]))
+                return std::nullopt;
+        return rows;
+    }
+
+  private:
+    IDatabase& db_;
+    QueryBuilder insert_;
+    QueryBuilder update_;
+    QueryBuilder remove_;
+    QueryBuilder find_;
+    QueryBuilder select_;
+};
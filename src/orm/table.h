@@ -0,0 +1,337 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "cell_parse.h"
+#include "query_result.h"
+#include "querybuilder/query_builder.h"
+
+// Maps a struct onto a table. The column list, the INSERT/UPDATE/SELECT/DELETE text in both
+// placeholder styles and the per-field bind and decode code are all fixed at compile time:
+//
+//     struct User { int64_t id; std::string name; std::optional<std::string> email; };
+//     ARMORY_TABLE(User, "users", id, name, email)
+//
+// Columns are named after the fields, and the first one listed is the primary key. Use the
+// macro at global scope, after the struct; Repository<User> then runs CRUD on it.
+
+// How a field type is sent as a bound parameter and read back from a cell. Specialize it for
+// your own field types; decode() is false for NULL or text that is not a V.
+template <typename V, typename = void>
+struct ColumnCodec;
+
+template <>
+struct ColumnCodec<std::string> {
+    static QueryBuilder::Param encode(const std::string& value) { return value; }
+    static bool decode(const QueryResult& result, size_t row, size_t col, std::string& value) {
+        if (result.is_null(row, col))
+            return false;
+        value.assign(result.view(row, col));
+        return true;
+    }
+};
+
+template <>
+struct ColumnCodec<bool> {
+    static QueryBuilder::Param encode(bool value) { return value ? "1" : "0"; }
+    // SQLite stores 1/0, PostgreSQL prints t/f
+    static bool decode(const QueryResult& result, size_t row, size_t col, bool& value) {
+        if (result.is_null(row, col))
+            return false;
+        std::string_view text = result.view(row, col);
+        value = text == "1" || text == "t" || text == "true";
+        return value || text == "0" || text == "f" || text == "false";
+    }
+};
+
+template <typename V>
+struct ColumnCodec<V, std::enable_if_t<std::is_integral_v<V> && !std::is_same_v<V, bool>>> {
+    static QueryBuilder::Param encode(V value) { return std::to_string(value); }
+    static bool decode(const QueryResult& result, size_t row, size_t col, V& value) {
+        auto number = result.as_int64(row, col);
+        if (!number || !std::in_range<V>(*number))
+            return false;
+        value = static_cast<V>(*number);
+        return true;
+    }
+};
+
+template <typename V>
+struct ColumnCodec<V, std::enable_if_t<std::is_floating_point_v<V>>> {
+    static QueryBuilder::Param encode(V value) {
+        char buf[32];
+        auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), static_cast<double>(value));
+        return std::string(buf, end);
+    }
+    static bool decode(const QueryResult& result, size_t row, size_t col, V& value) {
+        auto number = result.as_double(row, col);
+        if (!number)
+            return false;
+        value = static_cast<V>(*number);
+        return true;
+    }
+};
+
+// Written in UTC with an explicit zone, so timestamptz columns do not shift
+template <>
+struct ColumnCodec<CellTime> {
+    static QueryBuilder::Param encode(CellTime value) {
+        using namespace std::chrono;
+        const sys_days day = floor<days>(value);
+        const year_month_day date{day};
+        const hh_mm_ss<microseconds> time{value - day};
+        char buf[40];
+        std::snprintf(buf, sizeof(buf), "%04d-%02u-%02u %02d:%02d:%02d.%06d+00",
+                      static_cast<int>(date.year()), static_cast<unsigned>(date.month()),
+                      static_cast<unsigned>(date.day()), static_cast<int>(time.hours().count()),
+                      static_cast<int>(time.minutes().count()),
+                      static_cast<int>(time.seconds().count()),
+                      static_cast<int>(time.subseconds().count()));
+        return std::string(buf);
+    }
+    static bool decode(const QueryResult& result, size_t row, size_t col, CellTime& value) {
+        auto time = result.as_timestamp(row, col);
+        if (!time)
+            return false;
+        value = *time;
+        return true;
+    }
+};
+
+// NULL <-> std::nullopt
+template <typename V>
+struct ColumnCodec<std::optional<V>> {
+    static QueryBuilder::Param encode(const std::optional<V>& value) {
+        return value ? ColumnCodec<V>::encode(*value) : std::nullopt;
+    }
+    static bool decode(const QueryResult& result, size_t row, size_t col,
+                       std::optional<V>& value) {
+        if (result.is_null(row, col)) {
+            value.reset();
+            return true;
+        }
+        V inner{};
+        if (!ColumnCodec<V>::decode(result, row, col, inner))
+            return false;
+        value = std::move(inner);
+        return true;
+    }
+};
+
+// Specialized by ARMORY_TABLE: table name, column names and member pointers, key first
+template <typename T>
+struct TableMapping;
+
+// Statement text rendered into a fixed array at compile time
+template <size_t N>
+struct SqlText {
+    char data[N + 1] = {};
+    constexpr std::string_view view() const { return {data, N}; }
+};
+
+template <typename T>
+class TableSqlWriter {
+  public:
+    using Mapping = TableMapping<T>;
+    using Style = QueryBuilder::ParamStyle;
+    enum class Statement { Insert, Update, Select, SelectByKey, Remove };
+
+    // Writes the statement twice: once to measure it, once into an array of that size
+    template <Statement S, Style P>
+    static constexpr auto render() {
+        constexpr size_t n = [] {
+            Measure measure;
+            write<S, P>(measure);
+            return measure.n;
+        }();
+        SqlText<n> text;
+        Fill<n> fill{&text};
+        write<S, P>(fill);
+        return text;
+    }
+
+  private:
+    struct Measure {
+        size_t n = 0;
+        constexpr void operator()(std::string_view piece) { n += piece.size(); }
+    };
+
+    template <size_t N>
+    struct Fill {
+        SqlText<N>* text;
+        size_t at = 0;
+        constexpr void operator()(std::string_view piece) {
+            for (char ch : piece) text->data[at++] = ch;
+        }
+    };
+
+    // The same text QueryBuilder::str() renders for the equivalent builder
+    template <Statement S, Style P, typename Out>
+    static constexpr void write(Out& out) {
+        constexpr auto& columns = Mapping::columns;
+        size_t next = 0;
+        auto placeholder = [&] {
+            ++next;
+            if constexpr (P == Style::Question) {
+                out("?");
+            } else {
+                char buf[24] = {'$'};
+                size_t len = 1;
+                for (size_t rest = next; rest; rest /= 10) ++len;
+                for (size_t rest = next, i = len - 1; rest; rest /= 10, --i)
+                    buf[i] = static_cast<char>('0' + rest % 10);
+                out(std::string_view(buf, len));
+            }
+        };
+        auto byKey = [&] {
+            out(" WHERE ");
+            out(columns[0]);
+            out(" = ");
+            placeholder();
+        };
+
+        if constexpr (S == Statement::Insert) {
+            out("INSERT INTO ");
+            out(Mapping::table);
+            out(" (");
+            for (size_t i = 0; i < columns.size(); ++i) {
+                out(i ? ", " : "");
+                out(columns[i]);
+            }
+            out(") VALUES (");
+            for (size_t i = 0; i < columns.size(); ++i) {
+                out(i ? ", " : "");
+                placeholder();
+            }
+            out(")");
+        } else if constexpr (S == Statement::Update) {
+            out("UPDATE ");
+            out(Mapping::table);
+            out(" SET ");
+            for (size_t i = 1; i < columns.size(); ++i) {
+                out(i > 1 ? ", " : "");
+                out(columns[i]);
+                out(" = ");
+                placeholder();
+            }
+            byKey();
+        } else if constexpr (S == Statement::Remove) {
+            out("DELETE FROM ");
+            out(Mapping::table);
+            byKey();
+        } else {
+            out("SELECT ");
+            for (size_t i = 0; i < columns.size(); ++i) {
+                out(i ? ", " : "");
+                out(columns[i]);
+            }
+            out(" FROM ");
+            out(Mapping::table);
+            if constexpr (S == Statement::SelectByKey)
+                byKey();
+        }
+    }
+};
+
+// The statements of T's mapping; UPDATE sets every column but the key, which SELECT BY KEY,
+// UPDATE and DELETE bind last
+template <typename T>
+struct TableSql {
+    using Writer = TableSqlWriter<T>;
+    using Statement = typename Writer::Statement;
+    using Style = QueryBuilder::ParamStyle;
+
+    template <Statement S>
+    struct Text {
+        static constexpr auto question = Writer::template render<S, Style::Question>();
+        static constexpr auto numbered = Writer::template render<S, Style::Numbered>();
+
+        static constexpr std::string_view str(Style style) {
+            return style == Style::Question ? question.view() : numbered.view();
+        }
+    };
+
+    using Insert = Text<Statement::Insert>;
+    using Update = Text<Statement::Update>;
+    using Select = Text<Statement::Select>;
+    using SelectByKey = Text<Statement::SelectByKey>;
+    using Remove = Text<Statement::Remove>;
+};
+
+// Bound values of row in column order, and the reverse from one result row
+template <typename T>
+QueryBuilder::Params encodeRow(const T& row) {
+    return std::apply(
+        [&row](auto... field) {
+            return QueryBuilder::Params{
+                ColumnCodec<std::remove_cvref_t<decltype(row.*field)>>::encode(row.*field)...};
+        },
+        TableMapping<T>::fields);
+}
+
+// Columns are read by position, as Select lists them; false at the first field that does not
+// decode
+template <typename T>
+bool decodeRow(const QueryResult& result, size_t row, T& out) {
+    if (result.cols() < TableMapping<T>::columns.size())
+        return false;
+    return std::apply(
+        [&](auto... field) {
+            size_t col = 0;
+            return (ColumnCodec<std::remove_cvref_t<decltype(out.*field)>>::decode(
+                        result, row, col++, out.*field) &&
+                    ...);
+        },
+        TableMapping<T>::fields);
+}
+
+// ARMORY_FOR_EACH(m, s, a, b, ...) expands to m(s, a), m(s, b), ... for up to 16 fields
+#define ARMORY_EXPAND(x) x
+#define ARMORY_FE_1(m, s, x) m(s, x)
+#define ARMORY_FE_2(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_1(m, s, __VA_ARGS__))
+#define ARMORY_FE_3(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_2(m, s, __VA_ARGS__))
+#define ARMORY_FE_4(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_3(m, s, __VA_ARGS__))
+#define ARMORY_FE_5(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_4(m, s, __VA_ARGS__))
+#define ARMORY_FE_6(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_5(m, s, __VA_ARGS__))
+#define ARMORY_FE_7(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_6(m, s, __VA_ARGS__))
+#define ARMORY_FE_8(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_7(m, s, __VA_ARGS__))
+#define ARMORY_FE_9(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_8(m, s, __VA_ARGS__))
+#define ARMORY_FE_10(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_9(m, s, __VA_ARGS__))
+#define ARMORY_FE_11(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_10(m, s, __VA_ARGS__))
+#define ARMORY_FE_12(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_11(m, s, __VA_ARGS__))
+#define ARMORY_FE_13(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_12(m, s, __VA_ARGS__))
+#define ARMORY_FE_14(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_13(m, s, __VA_ARGS__))
+#define ARMORY_FE_15(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_14(m, s, __VA_ARGS__))
+#define ARMORY_FE_16(m, s, x, ...) m(s, x), ARMORY_EXPAND(ARMORY_FE_15(m, s, __VA_ARGS__))
+#define ARMORY_FE_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, \
+                       name, ...)                                                             \
+    name
+#define ARMORY_FOR_EACH(m, s, ...)                                                            \
+    ARMORY_EXPAND(ARMORY_FE_PICK(__VA_ARGS__, ARMORY_FE_16, ARMORY_FE_15, ARMORY_FE_14,       \
+                                 ARMORY_FE_13, ARMORY_FE_12, ARMORY_FE_11, ARMORY_FE_10,      \
+                                 ARMORY_FE_9, ARMORY_FE_8, ARMORY_FE_7, ARMORY_FE_6,          \
+                                 ARMORY_FE_5, ARMORY_FE_4, ARMORY_FE_3, ARMORY_FE_2,          \
+                                 ARMORY_FE_1)(m, s, __VA_ARGS__))
+#define ARMORY_COLUMN_NAME(s, field) std::string_view(#field)
+#define ARMORY_COLUMN_FIELD(s, field) &s::field
+
+#define ARMORY_TABLE(Struct, table_name, ...)                                               \
+    template <>                                                                             \
+    struct TableMapping<Struct> {                                                           \
+        static constexpr std::string_view table = table_name;                               \
+        static constexpr auto columns =                                                     \
+            std::to_array({ARMORY_FOR_EACH(ARMORY_COLUMN_NAME, Struct, __VA_ARGS__)});      \
+        static constexpr auto fields =                                                      \
+            std::make_tuple(ARMORY_FOR_EACH(ARMORY_COLUMN_FIELD, Struct, __VA_ARGS__));     \
+    }
@@ -0,0 +1,154 @@
+#include "pg_change_listener.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <pqxx/pqxx>
+#include <utility>
+
+#include "spdlog/fmt/bundled/format.h"
+
+namespace {
+    constexpr auto kPoll = std::chrono::milliseconds(200);
+    constexpr auto kFirstBackoff = std::chrono::milliseconds(200);
+    constexpr auto kMaxBackoff = std::chrono::seconds(30);
+
+    std::string replaceAll(std::string s, char from, const std::string& to) {
+        for (size_t pos = s.find(from); pos != std::string::npos;
+             pos = s.find(from, pos + to.size()))
+            s.replace(pos, 1, to);
+        return s;
+    }
+
+    std::string quoteName(const std::string& name) {
+        return '"' + replaceAll(name, '"', "\"\"") + '"';
+    }
+
+    std::string quoteLiteral(const std::string& s) {
+        return '\'' + replaceAll(s, '\'', "''") + '\'';
+    }
+}  // namespace
+
+// One connection and its LISTENs; receivers unlisten before the connection closes
+struct PgChangeListener::Session {
+    class Receiver : public pqxx::notification_receiver {
+      public:
+        Receiver(pqxx::connection& conn, const std::string& channel, PgChangeListener* owner)
+            : pqxx::notification_receiver(conn, channel), owner_(owner) {}
+        void operator()(const std::string& payload, int) override {
+            owner_->deliver(channel(), payload);
+        }
+
+      private:
+        PgChangeListener* owner_;
+    };
+
+    explicit Session(const std::string& conninfo) : conn(conninfo) {}
+
+    pqxx::connection conn;
+    std::vector<std::unique_ptr<Receiver>> receivers;
+};
+
+PgChangeListener::PgChangeListener(ConnectionConfig cfg, std::vector<std::string> channels,
+                                   ILogger* logger)
+    : config_(std::move(cfg)), channels_(std::move(channels)), logger_(logger) {}
+
+PgChangeListener::~PgChangeListener() { stop(); }
+
+void PgChangeListener::onNotify(NotifyFn fn) {
+    std::lock_guard<std::mutex> lock(handlers_mutex_);
+    handlers_.push_back(std::move(fn));
+}
+
+void PgChangeListener::invalidates(ResultCache& cache) {
+    onNotify([&cache](const std::string&, const std::string& payload) {
+        if (payload.empty())
+            cache.clear();
+        else
+            cache.invalidate(payload);
+    });
+}
+
+bool PgChangeListener::start() {
+    if (running_)
+        return true;
+    std::unique_ptr<Session> session = connect();
+    if (!session)
+        return false;
+    running_ = true;
+    thread_ = std::thread(&PgChangeListener::run, this, std::move(session));
+    return true;
+}
+
+void PgChangeListener::stop() {
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+}
+
+std::unique_ptr<PgChangeListener::Session> PgChangeListener::connect() {
+    try {
+        auto session = std::make_unique<Session>(config_.toPostgresConnection());
+        for (const auto& channel : channels_)
+            session->receivers.push_back(
+                std::make_unique<Session::Receiver>(session->conn, channel, this));
+        logger_->info(fmt::format("Listening on {} PostgreSQL channel(s).", channels_.size()));
+        return session;
+    } catch (const std::exception& e) {
+        logger_->error(fmt::format("LISTEN connection failed: {}", e.what()));
+        return nullptr;
+    }
+}
+
+void PgChangeListener::run(std::unique_ptr<Session> session) {
+    auto backoff = kFirstBackoff;
+    while (running_) {
+        if (!session) {
+            for (auto waited = std::chrono::milliseconds(0); running_ && waited < backoff;
+                 waited += kPoll)
+                std::this_thread::sleep_for(kPoll);
+            if (!running_ || !(session = connect())) {
+                backoff = std::min<std::chrono::milliseconds>(backoff * 2, kMaxBackoff);
+                continue;
+            }
+            backoff = kFirstBackoff;
+            for (const auto& channel : channels_) deliver(channel, "");
+        }
+        try {
+            // Wakes up at least every kPoll to notice stop()
+            session->conn.await_notification(0, static_cast<long>(kPoll.count()) * 1000);
+        } catch (const std::exception& e) {
+            logger_->error(fmt::format("LISTEN connection lost: {}", e.what()));
+            session.reset();
+        }
+    }
+}
+
+void PgChangeListener::deliver(const std::string& channel, const std::string& payload) {
+    std::vector<NotifyFn> handlers;
+    {
+        std::lock_guard<std::mutex> lock(handlers_mutex_);
+        handlers = handlers_;
+    }
+    for (const auto& handler : handlers) {
+        try {
+            handler(channel, payload);
+        } catch (const std::exception& e) {
+            logger_->error(fmt::format("NOTIFY handler for {} failed: {}", channel, e.what()));
+        }
+    }
+}
+
+std::string PgChangeListener::triggerSql(const std::string& table, const std::string& channel) {
+    const std::string fn = quoteName("armory_notify_" + channel);
+    return fmt::format(
+        "CREATE OR REPLACE FUNCTION {0}() RETURNS trigger LANGUAGE plpgsql AS $$\n"
+        "BEGIN\n"
+        "    PERFORM pg_notify({1}, TG_TABLE_NAME);\n"
+        "    RETURN NULL;\n"
+        "END $$;\n"
+        "DROP TRIGGER IF EXISTS {0} ON {2};\n"
+        "CREATE TRIGGER {0} AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON {2}\n"
+        "    FOR EACH STATEMENT EXECUTE FUNCTION {0}();\n",
+        fn, quoteLiteral(channel), table);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache/result_cache.h"
+#include "config.h"
+#include "log_armory/src/logger.h"
+
+// LISTENs on channels over a dedicated connection and calls the handlers for each NOTIFY on a
+// background thread. The triggers from triggerSql() send the changed table's name as payload,
+// so invalidates(cache) is enough to keep a ResultCache fresh. After a lost connection the
+// listener reconnects with backoff and then delivers an empty payload on every channel:
+// notifications sent meanwhile are gone, so anything may have changed.
+class PgChangeListener {
+  public:
+    using NotifyFn = std::function<void(const std::string& channel, const std::string& payload)>;
+
+    PgChangeListener(ConnectionConfig cfg, std::vector<std::string> channels, ILogger* logger);
+    ~PgChangeListener();
+
+    // Register handlers before start()
+    void onNotify(NotifyFn fn);
+    // Payload = table name to invalidate, empty payload clears the cache
+    void invalidates(ResultCache& cache);
+
+    // Connects and LISTENs synchronously; false when the first connection fails
+    bool start();
+    void stop();
+    bool is_running() const { return running_; }
+
+    // Function plus statement-level AFTER INSERT/UPDATE/DELETE/TRUNCATE trigger on table that
+    // sends pg_notify(channel, TG_TABLE_NAME); run once per table, e.g. from a migration
+    static std::string triggerSql(const std::string& table, const std::string& channel);
+
+    PgChangeListener(const PgChangeListener&) = delete;
+    PgChangeListener& operator=(const PgChangeListener&) = delete;
+
+  private:
+    struct Session;
+
+    std::unique_ptr<Session> connect();
+    void run(std::unique_ptr<Session> session);
+    void deliver(const std::string& channel, const std::string& payload);
+
+    ConnectionConfig config_;
+    std::vector<std::string> channels_;
+    ILogger* logger_;
+
+    std::mutex handlers_mutex_;
+    std::vector<NotifyFn> handlers_;
+
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
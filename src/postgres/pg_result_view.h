@@ -0,0 +1,126 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <pqxx/pqxx>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "query_result.h"
+
+// Read-only view over a pqxx::result: cells are string_views straight into libpq's buffer,
+// which stays alive as long as any copy of the view does. Same rows()/cols()/columns()/at()
+// surface as QueryResult; to_result() copies out when an owning result is needed.
+class PgResultView {
+  public:
+    class RowView {
+      public:
+        RowView(const pqxx::result* res, size_t row) : res_(res), row_(row) {}
+
+        size_t size() const { return static_cast<size_t>(res_->columns()); }
+        std::string_view operator[](size_t col) const {
+            pqxx::field f = (*res_)[static_cast<pqxx::result_size_type>(row_)]
+                                   [static_cast<pqxx::row_size_type>(col)];
+            return f.is_null() ? std::string_view() : f.view();
+        }
+        bool is_null(size_t col) const {
+            return (*res_)[static_cast<pqxx::result_size_type>(row_)]
+                          [static_cast<pqxx::row_size_type>(col)]
+                              .is_null();
+        }
+
+      private:
+        const pqxx::result* res_;
+        size_t row_;
+    };
+
+    class iterator {
+      public:
+        iterator(const pqxx::result* res, size_t row) : res_(res), row_(row) {}
+        RowView operator*() const { return RowView(res_, row_); }
+        iterator& operator++() {
+            ++row_;
+            return *this;
+        }
+        bool operator!=(const iterator& other) const { return row_ != other.row_; }
+
+      private:
+        const pqxx::result* res_;
+        size_t row_;
+    };
+
+    PgResultView() : result_(std::make_shared<const pqxx::result>()) {}
+    explicit PgResultView(pqxx::result res)
+        : result_(std::make_shared<const pqxx::result>(std::move(res))) {
+        columns_.reserve(result_->columns());
+        for (pqxx::row_size_type i = 0; i < result_->columns(); ++i)
+            columns_.emplace_back(result_->column_name(i));
+    }
+
+    bool empty() const { return result_->empty(); }
+    size_t rows() const { return static_cast<size_t>(result_->size()); }
+    size_t cols() const { return columns_.size(); }
+    const std::vector<std::string>& columns() const { return columns_; }
+    ColumnType column_type(size_t col) const {
+        switch (result_->column_type(static_cast<pqxx::row_size_type>(col))) {
+            case 16:  // bool
+                return ColumnType::Bool;
+            case 20:  // int8
+            case 21:  // int2
+            case 23:  // int4
+            case 26:  // oid
+                return ColumnType::Int64;
+            case 700:  // float4
+            case 701:  // float8
+                return ColumnType::Double;
+            default:  // numeric, bytea (hex text) and everything else stay text
+                return ColumnType::Text;
+        }
+    }
+
+    // Empty for SQL NULL, like QueryResult::at()
+    std::optional<std::string_view> at(size_t row, size_t col) const {
+        if (row < rows() && col < cols() && !is_null(row, col)) {
+            return RowView(result_.get(), row)[col];
+        }
+        return std::nullopt;
+    }
+
+    bool is_null(size_t row, size_t col) const {
+        return row < rows() && col < cols() && RowView(result_.get(), row).is_null(col);
+    }
+
+    std::vector<ColumnType> column_types() const {
+        std::vector<ColumnType> types;
+        for (size_t c = 0; c < cols(); ++c) types.push_back(column_type(c));
+        return types;
+    }
+
+    RowView row(size_t r) const { return RowView(result_.get(), r); }
+    iterator begin() const { return iterator(result_.get(), 0); }
+    iterator end() const { return iterator(result_.get(), rows()); }
+
+    // Owning copy for callers that outlive the view or need QueryResult
+    QueryResult to_result(QueryResult::SpillPolicy spill = {}) const {
+        QueryResult result({}, columns_);
+        result.set_column_types(column_types());
+        result.set_spill_policy(std::move(spill));
+        QueryResult::Cells cells(cols());
+        for (size_t r = 0; r < rows(); ++r) {
+            RowView view = row(r);
+            for (size_t c = 0; c < cols(); ++c)
+                cells[c] = view.is_null(c) ? std::nullopt
+                                           : std::optional<std::string_view>(view[c]);
+            result.append_cells(cells);
+            if (result.rejected())
+                break;
+        }
+        return result;
+    }
+
+  private:
+    std::shared_ptr<const pqxx::result> result_;
+    std::vector<std::string> columns_;
+};
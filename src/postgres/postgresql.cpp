@@ -1,153 +1,459 @@
-#include "postgresql.h"
-
-#include <iostream>
-#include <pqxx/pqxx>
-#include <stdexcept>
-
-#include "spdlog/fmt/bundled/format.h"
-
-bool PostgreSQL::open() {
-    logger_->info("Try connect to DB ...");
-    if (connection_) {
-        logger_->info("DB Already open");
-        return true;  // Already open
-    }
-    try {
-        connection_ = std::make_unique<pqxx::connection>(config_.toPostgresConnection());
-        return connection_->is_open();
-    } catch (const std::exception& e) {
-        logger_->error(fmt::format("⚠ Open Connection Other error: {}", e.what()));
-        connection_.reset();
-        return false;
-    }
-}
-
-void PostgreSQL::close() {
-    if (connection_) {
-        // connection_.release();
-        connection_.reset();
-    }
-}
-
-bool PostgreSQL::is_open() const {
-    return connection_ && connection_->is_open();
-}
-
-PostgreSQL::~PostgreSQL() {
-    close();
-}
-
-bool PostgreSQL::insert(const QueryBuilder& qb) {
-    if (!is_open()) {
-        logger_->error("❌ Cannot insert: database not open.");
-        return false;
-    }
-
-    try {
-        pqxx::work txn(*connection_.get());
-
-        // Execute the query with parameters
-        pqxx::result res = txn.exec_params(qb.str());
-
-        txn.commit();
-        return true;
-    } catch (const std::exception& e) {
-        logger_->error(fmt::format("Insert failed: {}", e.what()));
-        return false;
-    }
-}
-
-QueryResult convert_result(const pqxx::result& res) {
-    if (res.empty()) {
-        // Return empty result with column names (if available)
-        std::vector<std::string> columns;
-        if (res.columns() > 0) {
-            columns.reserve(res.columns());
-            for (pqxx::row_size_type i = 0; i < res.columns(); ++i) {
-                columns.push_back(std::string(res.column_name(i)));
-            }
-        }
-        return QueryResult({}, std::move(columns));
-    }
-
-    // Extract column names
-    std::vector<std::string> columns;
-    columns.reserve(res.columns());
-    for (pqxx::row_size_type i = 0; i < res.columns(); ++i) {
-        columns.push_back(std::string(res.column_name(i)));
-    }
-
-    // Extract rows
-    QueryResult::Table table;
-    table.reserve(res.size());
-
-    for (const auto& row : res) {
-        QueryResult::Row r;
-        r.reserve(row.size());
-        for (const auto& field : row) {
-            // Convert field to string; handle NULLs safely
-            if (field.is_null()) {
-                r.emplace_back("NULL");  // or use empty string "" based on your policy
-            } else {
-                r.emplace_back(std::string(field.c_str()));
-            }
-        }
-        table.push_back(std::move(r));
-    }
-
-    return QueryResult(std::move(table), std::move(columns));
-}
-
-QueryResult PostgreSQL::select(const QueryBuilder& qb) {
-    try {
-        pqxx::work txn(*connection_.get());
-
-        // Execute the query with parameters
-        pqxx::result res;
-        res = txn.exec(qb.str());
-
-        txn.commit();
-        return convert_result(res);
-    } catch (const std::exception& e) {
-        logger_->error(fmt::format("SELECT failed: {}", e.what()));
-        return convert_result(pqxx::result{});  // empty result on failure
-    }
-}
-
-bool PostgreSQL::update(const QueryBuilder& qb) {
-    if (!is_open()) {
-        logger_->error("❌ Cannot update: database not open.\n");
-        return false;
-    }
-
-    try {
-        pqxx::work txn(*connection_.get());
-        txn.exec(qb.str());
-        txn.commit();
-        std::cout << "✅ Update successful.\n";
-        return true;
-    } catch (const std::exception& e) {
-        logger_->error(fmt::format("❌ Update failed: {}", e.what()));
-        return false;
-    }
-}
-
-bool PostgreSQL::remove(const QueryBuilder& qb) {
-    if (!is_open()) {
-        std::cerr << "❌ Cannot delete: database not open.\n";
-        return false;
-    }
-
-    try {
-        pqxx::work txn(*connection_.get());
-
-        txn.exec(qb.str());
-
-        txn.commit();
-        logger_->info("🗑️  Delete successful.\n");
-        return true;
-    } catch (const std::exception& e) {
-        logger_->error(fmt::format("❌ Delete failed: {}", e.what()));
-        return false;
-    }
-}
+#include "postgresql.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <pqxx/pqxx>
+#include <stdexcept>
+
+#include "spdlog/fmt/bundled/format.h"
+
+namespace {
+    // Bind parameters per statement allowed by the wire protocol (16-bit count)
+    constexpr size_t kMaxParams = 65535;
+
+    pqxx::params bindParams(const QueryBuilder::Params& params) {
+        pqxx::params bound;
+        for (const auto& param : params) {
+            if (param)
+                bound.append(*param);
+            else
+                bound.append();
+        }
+        return bound;
+    }
+
+    pqxx::result execParams(pqxx::work& txn, const std::string& sql,
+                            const QueryBuilder::Params& params) {
+        if (params.empty())
+            return txn.exec(sql);
+        return txn.exec_params(sql, bindParams(params));
+    }
+
+    // Applies qb's timeout and token to one transaction. SET LOCAL statement_timeout bounds
+    // each statement on the server, check() stops between statements once the whole budget
+    // is spent, and cancelling the token aborts the running statement through PQcancel.
+    class QueryGuard {
+      public:
+        QueryGuard(pqxx::work& txn, pqxx::connection& conn, const QueryBuilder& qb,
+                   std::chrono::steady_clock::time_point start)
+            : qb_(qb), start_(start) {
+            check();
+            if (qb.getCancellation())
+                callback_ = qb.getCancellation()->onCancel([&conn] { conn.cancel_query(); });
+            if (qb.getTimeout()) {
+                // 0 would disable the timeout
+                long long ms = std::max<long long>(1, qb.getTimeout()->count());
+                txn.exec("SET LOCAL statement_timeout = " + std::to_string(ms));
+            }
+        }
+        ~QueryGuard() {
+            if (callback_)
+                qb_.getCancellation()->removeCallback(*callback_);
+        }
+
+        void check() const {
+            if (qb_.getCancellation() && qb_.getCancellation()->cancelled())
+                throw std::runtime_error("query cancelled");
+            if (qb_.getTimeout() && std::chrono::steady_clock::now() - start_ >= *qb_.getTimeout())
+                throw std::runtime_error("query timed out");
+        }
+
+        QueryGuard(const QueryGuard&) = delete;
+        QueryGuard& operator=(const QueryGuard&) = delete;
+
+      private:
+        const QueryBuilder& qb_;
+        std::chrono::steady_clock::time_point start_;
+        std::optional<uint64_t> callback_;
+    };
+
+    // sql is qb (possibly wrapped) rendered with $n placeholders; statements registered with
+    // prepare() skip the parse and plan on the server
+    pqxx::result execBuilder(pqxx::work& txn, const std::string& sql, const QueryBuilder& qb,
+                             const std::map<std::string, std::string>& prepared) {
+        auto it = prepared.find(sql);
+        if (it == prepared.end())
+            return execParams(txn, sql, qb.getParams());
+        return txn.exec_prepared(it->second, bindParams(qb.getParams()));
+    }
+
+    // Same builder keeping only the last VALUES row for each conflict key. Rows with a NULL in
+    // the key never conflict and are all kept.
+    QueryBuilder lastRowPerConflictKey(const QueryBuilder& qb) {
+        const auto& columns = qb.getInsertColumns();
+        std::vector<size_t> keyIndexes;
+        for (const auto& key : *qb.getConflictColumns()) {
+            auto it = std::find(columns.begin(), columns.end(), key);
+            if (it == columns.end())
+                return qb;  // target not among the inserted columns, let the server decide
+            keyIndexes.push_back(static_cast<size_t>(it - columns.begin()));
+        }
+
+        const auto& rows = qb.getInsertRows();
+        std::map<QueryBuilder::Params, size_t> last;
+        std::vector<bool> keep(rows.size(), true);
+        bool duplicates = false;
+        for (size_t r = 0; r < rows.size(); ++r) {
+            QueryBuilder::Params key;
+            for (size_t k : keyIndexes)
+                key.push_back(k < rows[r].size() ? rows[r][k] : std::nullopt);
+            if (std::any_of(key.begin(), key.end(), [](const auto& v) { return !v; }))
+                continue;
+            auto [it, inserted] = last.emplace(std::move(key), r);
+            if (!inserted) {
+                keep[it->second] = false;
+                it->second = r;
+                duplicates = true;
+            }
+        }
+        if (!duplicates)
+            return qb;
+
+        QueryBuilder deduped = qb;
+        deduped.clearValues();
+        for (size_t r = 0; r < rows.size(); ++r)
+            if (keep[r])
+                deduped.values(rows[r]);
+        return deduped;
+    }
+}  // namespace
+
+bool PostgreSQL::open() {
+    if (config_.lazy_connect && !connection_) {
+        logger_->info("DB connect deferred to the first query.");
+        connect_pending_ = true;
+        return true;
+    }
+    return connect();
+}
+
+bool PostgreSQL::connect() {
+    logger_->info("Try connect to DB ...");
+    if (connection_) {
+        logger_->info("DB Already open");
+        return true;  // Already open
+    }
+    connect_pending_ = false;
+    try {
+        connection_ = std::make_unique<pqxx::connection>(config_.toPostgresConnection());
+        // Statements registered before a lazy connect are prepared now
+        for (const auto& [sql, name] : prepared_) connection_->prepare(name, sql);
+        return connection_->is_open();
+    } catch (const std::exception& e) {
+        logger_->error(fmt::format("⚠ Open Connection Other error: {}", e.what()));
+        connection_.reset();
+        return false;
+    }
+}
+
+bool PostgreSQL::connected() {
+    if (!connection_ && connect_pending_)
+        connect();
+    return is_open();
+}
+
+bool PostgreSQL::prepare(const QueryBuilder& qb) {
+    const std::string sql = qb.str(QueryBuilder::ParamStyle::Numbered);
+    if (prepared_.count(sql))
+        return true;
+    const std::string name = "armory_" + std::to_string(prepared_.size());
+    if (!connection_ && connect_pending_) {
+        prepared_.emplace(sql, name);
+        return true;
+    }
+    if (!is_open()) {
+        logger_->error("❌ Cannot prepare: database not open.");
+        return false;
+    }
+    try {
+        connection_->prepare(name, sql);
+        prepared_.emplace(sql, name);
+        return true;
+    } catch (const std::exception& e) {
+        logger_->error(fmt::format("PREPARE failed: {}", e.what()));
+        return false;
+    }
+}
+
+void PostgreSQL::close() {
+    connect_pending_ = false;
+    if (connection_) {
+        // connection_.release();
+        connection_.reset();
+    }
+}
+
+bool PostgreSQL::is_open() const {
+    return connection_ && connection_->is_open();
+}
+
+PostgreSQL::~PostgreSQL() {
+    close();
+}
+
+bool PostgreSQL::insert(const QueryBuilder& qb) {
+    return insertChunks(qb, "INSERT").has_value();
+}
+
+std::optional<size_t> PostgreSQL::upsert(const QueryBuilder& qb) {
+    if (!qb.isValid() || !qb.getConflictUpdates() || qb.getConflictUpdates()->empty())
+        return insertChunks(qb, "UPSERT");
+    // DO UPDATE may touch a row only once per statement: keep the last row for each key
+    return insertChunks(lastRowPerConflictKey(qb), "UPSERT");
+}
+
+std::optional<size_t> PostgreSQL::insertChunks(const QueryBuilder& qb, const char* what) {
+    if (!connected()) {
+        logger_->error(fmt::format("❌ Cannot run {}: database not open.", what));
+        setStatus(QueryStatus::Failed);
+        return std::nullopt;
+    }
+    if (!qb.isValid()) {
+        logger_->error(fmt::format("❌ Cannot run {}: the query builder has no valid statement.",
+                                   what));
+        setStatus(QueryStatus::Failed);
+        return std::nullopt;
+    }
+
+    const auto opStart = std::chrono::steady_clock::now();
+    try {
+        pqxx::work txn(*connection_.get());
+        QueryGuard guard(txn, *connection_, qb, opStart);
+
+        // Bulk inserts run as several statements under the bind limit, in one transaction
+        size_t affected = 0;
+        for (const auto& chunk : qb.split(kMaxParams)) {
+            guard.check();
+            auto start = std::chrono::steady_clock::now();
+            const std::string sql = chunk.str(QueryBuilder::ParamStyle::Numbered);
+            pqxx::result res = execBuilder(txn, sql, chunk, prepared_);
+            affected += static_cast<size_t>(res.affected_rows());
+            recordQuery(sql, chunk.getParams(), start, static_cast<size_t>(res.affected_rows()));
+        }
+
+        txn.commit();
+        setStatus(QueryStatus::Ok);
+        return affected;
+    } catch (const std::exception& e) {
+        logger_->error(fmt::format("{} failed: {}", what, e.what()));
+        setStatus(failureOf(qb, opStart));
+        return std::nullopt;
+    }
+}
+
+QueryResult convert_result(const pqxx::result& res, QueryResult::SpillPolicy spill = {}) {
+    return PgResultView(res).to_result(std::move(spill));
+}
+
+QueryResult PostgreSQL::select(const QueryBuilder& qb) {
+    if (!connected()) {
+        logger_->error("❌ Cannot select: database not open.");
+        setStatus(QueryStatus::Failed);
+        return QueryResult();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        const std::string sql = qb.str(QueryBuilder::ParamStyle::Numbered);
+        pqxx::work txn(*connection_.get());
+        QueryGuard guard(txn, *connection_, qb, start);
+
+        // Execute the query with parameters
+        pqxx::result res;
+        res = execBuilder(txn, sql, qb, prepared_);
+
+        txn.commit();
+        recordQuery(sql, qb.getParams(), start, static_cast<size_t>(res.size()));
+        QueryResult result = convert_result(res, {config_.result_memory_limit, config_.spill_dir});
+        if (result.rejected()) {
+            logger_->error(result.spill_error()
+                               ? "SELECT failed, its spill file cannot grow."
+                               : "SELECT rejected, process memory over its soft limit.");
+            setStatus(QueryStatus::Failed);
+            return QueryResult();
+        }
+        setStatus(QueryStatus::Ok);
+        return result;
+    } catch (const std::exception& e) {
+        logger_->error(fmt::format("SELECT failed: {}", e.what()));
+        setStatus(failureOf(qb, start));
+        return convert_result(pqxx::result{});  // empty result on failure
+    }
+}
+
+bool PostgreSQL::stream(const QueryBuilder& qb, IRowSink& sink) {
+    bool started = false;
+    IRowSink::Cells cells;
+    bool ok = scan(qb, [&](const PgResultView& chunk) {
+        if (!started) {
+            if (!sink.begin(chunk.columns(), chunk.column_types()))
+                return false;
+            cells.resize(chunk.cols());
+            started = true;
+        }
+        for (size_t r = 0; r < chunk.rows(); ++r) {
+            for (size_t c = 0; c < chunk.cols(); ++c) cells[c] = chunk.at(r, c);
+            if (!sink.row(cells))
+                return false;
+        }
+        return true;
+    });
+    return ok && sink.end();
+}
+
+bool PostgreSQL::scan(const QueryBuilder& qb, const ChunkFn& on_chunk) {
+    if (!connected()) {
+        logger_->error("❌ Cannot scan: database not open.");
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+
+    const size_t fetchSize = static_cast<size_t>(std::max(1, config_.pg_fetch_size));
+    auto start = std::chrono::steady_clock::now();
+    try {
+        const std::string sql = qb.str(QueryBuilder::ParamStyle::Numbered);
+        const std::string fetch =
+            "FETCH FORWARD " + std::to_string(fetchSize) + " FROM armory_scan";
+        size_t rows = 0;
+        pqxx::work txn(*connection_.get());
+        QueryGuard guard(txn, *connection_, qb, start);
+        // Parameters bind to the DECLARE; each FETCH then only holds one chunk in libpq
+        execBuilder(txn, "DECLARE armory_scan NO SCROLL CURSOR FOR " + sql, qb, prepared_);
+
+        for (bool first = true;; first = false) {
+            guard.check();
+            PgResultView chunk(txn.exec(fetch));
+            if (first || chunk.rows() > 0) {
+                if (!on_chunk(chunk)) {
+                    setStatus(QueryStatus::Failed);
+                    return false;  // the transaction's rollback drops the cursor
+                }
+            }
+            rows += chunk.rows();
+            if (chunk.rows() < fetchSize)
+                break;
+        }
+
+        txn.exec("CLOSE armory_scan");
+        txn.commit();
+        recordQuery(sql, qb.getParams(), start, rows);
+        setStatus(QueryStatus::Ok);
+        return true;
+    } catch (const std::exception& e) {
+        logger_->error(fmt::format("Scan SELECT failed: {}", e.what()));
+        setStatus(failureOf(qb, start));
+        return false;
+    }
+}
+
+PgResultView PostgreSQL::select_view(const QueryBuilder& qb) {
+    if (!connected()) {
+        logger_->error("❌ Cannot select: database not open.");
+        setStatus(QueryStatus::Failed);
+        return PgResultView();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        const std::string sql = qb.str(QueryBuilder::ParamStyle::Numbered);
+        pqxx::work txn(*connection_.get());
+        QueryGuard guard(txn, *connection_, qb, start);
+        PgResultView view(execBuilder(txn, sql, qb, prepared_));
+        txn.commit();
+        recordQuery(sql, qb.getParams(), start, view.rows());
+        setStatus(QueryStatus::Ok);
+        return view;
+    } catch (const std::exception& e) {
+        logger_->error(fmt::format("SELECT failed: {}", e.what()));
+        setStatus(failureOf(qb, start));
+        return PgResultView();
+    }
+}
+
+bool PostgreSQL::update(const QueryBuilder& qb) {
+    if (!connected()) {
+        logger_->error("❌ Cannot update: database not open.\n");
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+    if (!qb.isValid()) {
+        logger_->error("❌ Cannot update: the query builder has no valid statement.");
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        const std::string sql = qb.str(QueryBuilder::ParamStyle::Numbered);
+        pqxx::work txn(*connection_.get());
+        QueryGuard guard(txn, *connection_, qb, start);
+        pqxx::result res = execBuilder(txn, sql, qb, prepared_);
+        txn.commit();
+        recordQuery(sql, qb.getParams(), start, static_cast<size_t>(res.affected_rows()));
+        std::cout << "✅ Update successful.\n";
+        setStatus(QueryStatus::Ok);
+        return true;
+    } catch (const std::exception& e) {
+        logger_->error(fmt::format("❌ Update failed: {}", e.what()));
+        setStatus(failureOf(qb, start));
+        return false;
+    }
+}
+
+bool PostgreSQL::remove(const QueryBuilder& qb) {
+    if (!connected()) {
+        std::cerr << "❌ Cannot delete: database not open.\n";
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+    if (!qb.isValid()) {
+        logger_->error("❌ Cannot delete: the query builder has no valid statement.");
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        const std::string sql = qb.str(QueryBuilder::ParamStyle::Numbered);
+        pqxx::work txn(*connection_.get());
+        QueryGuard guard(txn, *connection_, qb, start);
+
+        pqxx::result res = execBuilder(txn, sql, qb, prepared_);
+
+        txn.commit();
+        recordQuery(sql, qb.getParams(), start, static_cast<size_t>(res.affected_rows()));
+        logger_->info("🗑️  Delete successful.\n");
+        setStatus(QueryStatus::Ok);
+        return true;
+    } catch (const std::exception& e) {
+        logger_->error(fmt::format("❌ Delete failed: {}", e.what()));
+        setStatus(failureOf(qb, start));
+        return false;
+    }
+}
+
+SlowQueryLog::PlanFn PostgreSQL::planCapture() const {
+    std::string conninfo = config_.toPostgresConnection();
+    return [conninfo](const std::string& sql, const SlowQueryLog::Params& params) {
+        // ANALYZE really runs the statement: only for a SELECT, so a slow write is not done
+        // again (sequences, triggers and locks outlive the rollback), and even then the
+        // transaction is never committed
+        size_t start = sql.find_first_not_of(" \t\r\n(");
+        bool select = start != std::string::npos && sql.size() - start >= 6 &&
+                      std::equal(sql.begin() + start, sql.begin() + start + 6, "SELECT",
+                                 [](unsigned char a, char b) { return std::toupper(a) == b; });
+        pqxx::connection conn(conninfo);
+        pqxx::work txn(conn);
+        pqxx::result res =
+            execParams(txn, (select ? "EXPLAIN (ANALYZE, BUFFERS) " : "EXPLAIN ") + sql, params);
+        std::string plan;
+        for (pqxx::result_size_type r = 0; r < res.size(); ++r) {
+            plan += res[r][0].c_str();
+            plan += '\n';
+        }
+        return plan;
+    };
+}
@@ -1,37 +1,69 @@
-#pragma once
-
-#include <iostream>
-#include <memory>
-#include <pqxx/pqxx>
-#include <string>
-#include <utility>
-#include <vector>
-
-#include "database.h"
-
-class PostgreSQL : public IDatabase {
-  public:
-    PostgreSQL(ConnectionConfig cfg, ILogger *logger) : IDatabase(std::move(cfg), std::move(logger))  {}
-
-    bool open() override;
-    void close() override;
-    bool is_open() const override;
-
-    bool insert(const QueryBuilder& qb) override;
-    bool update(const QueryBuilder& qb) override;
-    bool remove(const QueryBuilder& qb) override;
-    QueryResult select(const QueryBuilder& qb) override;
-
-    // Non-copyable
-    PostgreSQL(const PostgreSQL&) = delete;
-    PostgreSQL& operator=(const PostgreSQL&) = delete;
-
-    // Movable
-    PostgreSQL(PostgreSQL&&) = default;
-    PostgreSQL& operator=(PostgreSQL&&) = default;
-
-    ~PostgreSQL();
-
-  private:
-    std::unique_ptr<pqxx::connection> connection_;
-};
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <pqxx/pqxx>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "database.h"
+#include "pg_result_view.h"
+
+class PostgreSQL : public IDatabase {
+  public:
+    PostgreSQL(ConnectionConfig cfg, ILogger *logger) : IDatabase(std::move(cfg), std::move(logger))  {}
+
+    bool open() override;
+    void close() override;
+    bool is_open() const override;
+
+    bool insert(const QueryBuilder& qb) override;
+    bool update(const QueryBuilder& qb) override;
+    bool remove(const QueryBuilder& qb) override;
+    QueryResult select(const QueryBuilder& qb) override;
+    // Reads through scan() so neither side buffers the whole result
+    bool stream(const QueryBuilder& qb, IRowSink& sink) override;
+
+    // Walks the result through a server-side cursor in one transaction, config.pg_fetch_size
+    // rows per FETCH. on_chunk gets every chunk as it arrives (the first one even when empty,
+    // for the column names) and returns false to stop early, which makes scan() return false.
+    using ChunkFn = std::function<bool(const PgResultView& chunk)>;
+    bool scan(const QueryBuilder& qb, const ChunkFn& on_chunk);
+    std::optional<size_t> upsert(const QueryBuilder& qb) override;
+
+    // Server-side prepared statement for qb's SQL text; later queries rendering the same SQL
+    // run through it. With lazy_connect it is prepared once the first query connects.
+    bool prepare(const QueryBuilder& qb) override;
+
+    // Zero-copy select: cells point into the pqxx::result kept alive by the view
+    PgResultView select_view(const QueryBuilder& qb);
+
+    // Non-copyable
+    PostgreSQL(const PostgreSQL&) = delete;
+    PostgreSQL& operator=(const PostgreSQL&) = delete;
+
+    // Movable
+    PostgreSQL(PostgreSQL&&) = default;
+    PostgreSQL& operator=(PostgreSQL&&) = default;
+
+    ~PostgreSQL();
+
+  protected:
+    // EXPLAIN (ANALYZE, BUFFERS) on a separate connection, rolled back afterwards
+    SlowQueryLog::PlanFn planCapture() const override;
+
+  private:
+    bool connect();
+    // Connects on first use after a lazy open()
+    bool connected();
+
+    // Affected rows of qb split under the bind limit, in one transaction
+    std::optional<size_t> insertChunks(const QueryBuilder& qb, const char* what);
+
+    std::unique_ptr<pqxx::connection> connection_;
+    bool connect_pending_ = false;                 // lazy open() not yet connected
+    std::map<std::string, std::string> prepared_;  // SQL -> statement name
+};
@@ -1,90 +1,518 @@
-#pragma once
-
-#include <string>
-#include <vector>
-
-class QueryResult {
-  public:
-    using Row = std::vector<std::string>;
-    using Table = std::vector<Row>;
-
-    QueryResult() = default;
-    QueryResult(Table table, std::vector<std::string> columns)
-        : table_(std::move(table)), columns_(std::move(columns)) {}
-
-    bool empty() const { return table_.empty(); }
-    size_t rows() const { return table_.size(); }
-    size_t cols() const { return columns_.size(); }
-    const std::vector<std::string>& columns() const { return columns_; }
-    const Table& data() const { return table_; }
-
-    // Optional: helper to get cell by (row, col)
-    std::optional<std::string> at(size_t row, size_t col) const {
-        if (row < table_.size() && col < table_[row].size()) {
-            return table_[row][col];
-        }
-        return std::nullopt;
-    }
-
-    // ✅ New print() function
-    void print(std::ostream& os = std::cout) const {
-        if (columns_.empty()) {
-            os << "(no columns)\n";
-            return;
-        }
-
-        // Compute column widths
-        std::vector<size_t> widths(columns_.size());
-        for (size_t i = 0; i < columns_.size(); ++i) widths[i] = columns_[i].size();
-
-        for (const auto& row : table_) {
-            for (size_t i = 0; i < row.size(); ++i) widths[i] = std::max(widths[i], row[i].size());
-        }
-
-        // Print header
-        os << "┌";
-        for (size_t i = 0; i < widths.size(); ++i) {
-            os << std::string(widths[i] + 2, '-');
-            if (i < widths.size() - 1)
-                os << "┬";
-        }
-        os << "┐\n";
-
-        os << "│";
-        for (size_t i = 0; i < columns_.size(); ++i)
-            os << " " << std::setw(widths[i]) << std::left << columns_[i] << " │";
-        os << "\n";
-
-        os << "├";
-        for (size_t i = 0; i < widths.size(); ++i) {
-            os << std::string(widths[i] + 2, '-');
-            if (i < widths.size() - 1)
-                os << "┼";
-        }
-        os << "┤\n";
-
-        // Print rows
-        for (const auto& row : table_) {
-            os << "│";
-            for (size_t i = 0; i < columns_.size(); ++i) {
-                const std::string& val = (i < row.size() ? row[i] : "");
-                os << " " << std::setw(widths[i]) << std::left << val << " │";
-            }
-            os << "\n";
-        }
-
-        os << "└";
-        for (size_t i = 0; i < widths.size(); ++i) {
-            os << std::string(widths[i] + 2, '-');
-            if (i < widths.size() - 1)
-                os << "┴";
-        }
-        os << "┘\n";
-
-        os << rows() << " rows returned.\n";
-    }
-
-  private:
-    Table table_;
-    std::vector<std::string> columns_;
-};
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cell_parse.h"
+#include "memory_accountant.h"
+#include "spill_file.h"
+
+// Logical column type reported by the driver; cells are still stored as text
+enum class ColumnType { Text, Int64, Double, Bool, Blob };
+
+class QueryResult {
+  public:
+    using Row = std::vector<std::string>;
+    using Table = std::vector<Row>;
+    using Cells = std::vector<std::optional<std::string_view>>;  // empty optional = NULL
+
+    // Once the in-memory rows exceed memory_limit bytes (0 = never), further rows are
+    // appended to a memory-mapped temporary file in dir (system temp directory when empty)
+    struct SpillPolicy {
+        size_t memory_limit = 0;
+        std::string dir;
+    };
+
+    QueryResult() = default;
+    QueryResult(Table table, std::vector<std::string> columns)
+        : table_(std::move(table)), columns_(std::move(columns)) {
+        for (const auto& row : table_) memory_bytes_ += rowBytes(row);
+        lease_.force(memory_bytes_);
+    }
+
+    bool empty() const { return rows() == 0; }
+    size_t rows() const { return table_.size() + spilled_.size(); }
+    size_t cols() const { return columns_.size(); }
+    const std::vector<std::string>& columns() const { return columns_; }
+    ColumnType column_type(size_t col) const {
+        return col < types_.size() ? types_[col] : ColumnType::Text;
+    }
+    const std::vector<ColumnType>& column_types() const { return types_; }
+    void set_column_types(std::vector<ColumnType> types) { types_ = std::move(types); }
+    // The rows held in memory: all of them until spilled(), a prefix after that, the rest
+    // being reached through row(), view(), at() or iteration. NULL cells hold an empty
+    // string, see is_null()
+    const Table& memory_rows() const { return table_; }
+
+    const SpillPolicy& spill_policy() const { return policy_; }
+    void set_spill_policy(SpillPolicy policy) { policy_ = std::move(policy); }
+    bool spilled() const { return !spilled_.empty(); }
+    // Rows were dropped: the MemoryAccountant soft limit rejected this result while it grew,
+    // or its spill file could not grow (spill_error())
+    bool rejected() const { return rejected_ || spill_error_; }
+    bool spill_error() const { return spill_error_; }
+
+    // Bytes held in RAM: this object, row and column vectors at their capacity and every
+    // string's heap buffer (none while it fits the small-string buffer). Spilled rows are in
+    // a mapped file and only count by their offset.
+    size_t memory_usage() const {
+        size_t bytes = sizeof(*this) + table_.capacity() * sizeof(Row);
+        for (const auto& row : table_) bytes += stringsHeap(row);
+        bytes += stringsHeap(columns_) + types_.capacity() * sizeof(ColumnType);
+        bytes += nulls_.capacity() * sizeof(nulls_[0]);
+        for (const auto& bitmap : nulls_) bytes += bitmap.capacity() * sizeof(uint64_t);
+        return bytes + stringHeap(policy_.dir) + spilled_.capacity() * sizeof(uint64_t);
+    }
+    // Where the MemoryAccountant counts this result; ResultCache files its entries as Cache
+    void set_memory_category(MemoryAccountant::Category category) {
+        lease_.set_category(category);
+    }
+
+    // Optional: helper to get cell by (row, col), empty for SQL NULL
+    std::optional<std::string> at(size_t row, size_t col) const {
+        if (auto cell = cellView(row, col))
+            return std::string(*cell);
+        return std::nullopt;
+    }
+
+    // Empty for NULL; for spilled rows the view is invalidated by the next append
+    std::string_view view(size_t row, size_t col) const {
+        return cellView(row, col).value_or(std::string_view());
+    }
+
+    // Typed reads through cell_parse.h: empty for NULL and for text that does not parse
+    using Timestamp = CellTime;
+    std::optional<int64_t> as_int64(size_t row, size_t col) const {
+        return typedCell<int64_t>(row, col, parseInt64);
+    }
+    std::optional<double> as_double(size_t row, size_t col) const {
+        return typedCell<double>(row, col, parseDouble);
+    }
+    std::optional<Timestamp> as_timestamp(size_t row, size_t col) const {
+        return typedCell<Timestamp>(row, col, parseTimestamp);
+    }
+
+    // A whole column as one contiguous vector, parsed in batches; valid[r] is 0 where row r
+    // is NULL or does not parse, and values[r] is then zero
+    template <typename T>
+    struct TypedColumn {
+        std::vector<T> values;
+        std::vector<uint8_t> valid;
+    };
+    TypedColumn<int64_t> int64_column(size_t col) const {
+        return typedColumn<int64_t>(col, parseInt64s);
+    }
+    TypedColumn<double> double_column(size_t col) const {
+        return typedColumn<double>(col, parseDoubles);
+    }
+    TypedColumn<Timestamp> timestamp_column(size_t col) const {
+        return typedColumn<Timestamp>(col, parseTimestamps);
+    }
+    // Rows [first, first + n) of col parsed into values and valid, for callers that split a
+    // column between threads
+    void parse_int64s(size_t col, size_t first, size_t n, int64_t* values, uint8_t* valid) const {
+        parseRange(col, first, n, values, valid, parseInt64s);
+    }
+    void parse_doubles(size_t col, size_t first, size_t n, double* values, uint8_t* valid) const {
+        parseRange(col, first, n, values, valid, parseDoubles);
+    }
+
+    bool is_null(size_t row, size_t col) const {
+        if (row >= table_.size())
+            return row < rows() && col < width(row) && !cellView(row, col);
+        return col < nulls_.size() && row / 64 < nulls_[col].size() &&
+               (nulls_[col][row / 64] >> (row % 64)) & 1;
+    }
+
+    Row row(size_t r) const {
+        if (r < table_.size())
+            return table_[r];
+        Row out;
+        for (size_t c = 0; c < width(r); ++c) out.emplace_back(view(r, c));
+        return out;
+    }
+
+    // Iterates rows by value, covering spilled rows as well
+    class const_iterator {
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Row;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Row*;
+        using reference = Row;
+
+        const_iterator(const QueryResult* result, size_t index) : result_(result), index_(index) {}
+        Row operator*() const { return result_->row(index_); }
+        const_iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+
+      private:
+        const QueryResult* result_;
+        size_t index_;
+    };
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, rows()); }
+
+    // Builders used by the backends while filling a result
+    void append_row(Row row) {
+        if (spillNext(row)) {
+            spillRow(Cells(row.begin(), row.end()));
+            return;
+        }
+        if (rejected_)
+            return;
+        memory_bytes_ += rowBytes(row);
+        table_.push_back(std::move(row));
+    }
+    void append_cells(const Cells& cells) {
+        Row row;
+        row.reserve(cells.size());
+        for (const auto& cell : cells) row.emplace_back(cell.value_or(std::string_view()));
+        if (spillNext(row)) {
+            spillRow(cells);
+            return;
+        }
+        if (rejected_)
+            return;
+        memory_bytes_ += rowBytes(row);
+        table_.push_back(std::move(row));
+        for (size_t c = 0; c < cells.size(); ++c)
+            if (!cells[c])
+                set_null(table_.size() - 1, c);
+    }
+    // Spilled rows are immutable except for the most recently appended one
+    void set_null(size_t row, size_t col) {
+        if (row >= table_.size()) {
+            nullSpilled(row - table_.size(), col);
+            return;
+        }
+        if (nulls_.size() <= col)
+            nulls_.resize(columns_.size() > col ? columns_.size() : col + 1);
+        if (nulls_[col].size() <= row / 64)
+            nulls_[col].resize(row / 64 + 1, 0);
+        nulls_[col][row / 64] |= uint64_t{1} << (row % 64);
+        if (row < table_.size() && col < table_[row].size())
+            table_[row][col].clear();
+    }
+    // Copy one row of another result with the same columns, NULLs included
+    void append_row(const QueryResult& other, size_t row) {
+        Cells cells(other.width(row));
+        for (size_t c = 0; c < cells.size(); ++c) cells[c] = other.cellView(row, c);
+        append_cells(cells);
+    }
+
+    // Renders a box table. Only the first max_rows rows are printed (0 = all), column widths
+    // come from at most sample_rows of them and cells wider than max_col_width are cut with
+    // "…". Output is assembled in one buffer and written with a single os.write().
+    struct PrintOptions {
+        size_t max_rows = 50;
+        size_t max_col_width = 40;
+        size_t sample_rows = 1000;
+    };
+
+    void print(std::ostream& os = std::cout) const { print(os, PrintOptions{}); }
+
+    void print(std::ostream& os, const PrintOptions& opts) const {
+        if (columns_.empty()) {
+            os << "(no columns)\n";
+            return;
+        }
+
+        const size_t ncols = columns_.size();
+        const size_t shown = opts.max_rows ? std::min(rows(), opts.max_rows) : rows();
+        const size_t sampled = std::min(shown, opts.sample_rows);
+        const size_t limit = opts.max_col_width ? opts.max_col_width : SIZE_MAX;
+
+        std::vector<size_t> widths(ncols);
+        for (size_t c = 0; c < ncols; ++c) widths[c] = std::min(displayWidth(columns_[c]), limit);
+        for (size_t r = 0; r < sampled; ++r) {
+            for (size_t c = 0; c < ncols; ++c) {
+                size_t w = is_null(r, c) ? kNull.size() : displayWidth(view(r, c));
+                widths[c] = std::max(widths[c], std::min(w, limit));
+            }
+        }
+
+        std::string out;
+        size_t line = 1;
+        for (size_t w : widths) line += w + 5;  // "│" and "┬" are 3 bytes
+        out.reserve(line * (shown + 4) + 64);
+
+        auto rule = [&](const char* left, const char* mid, const char* right) {
+            out += left;
+            for (size_t c = 0; c < ncols; ++c) {
+                out.append(widths[c] + 2, '-');
+                out += c + 1 < ncols ? mid : right;
+            }
+            out += '\n';
+        };
+        auto rowLine = [&](auto&& value) {
+            out += "│";
+            for (size_t c = 0; c < ncols; ++c) {
+                out += ' ';
+                appendCell(out, value(c), widths[c]);
+                out += " │";
+            }
+            out += '\n';
+        };
+
+        rule("┌", "┬", "┐");
+        rowLine([&](size_t c) -> std::string_view { return columns_[c]; });
+        rule("├", "┼", "┤");
+        for (size_t r = 0; r < shown; ++r) {
+            rowLine([&](size_t c) -> std::string_view {
+                return is_null(r, c) ? std::string_view(kNull) : view(r, c);
+            });
+        }
+        rule("└", "┴", "┘");
+
+        if (shown < rows())
+            out += "… " + std::to_string(rows() - shown) + " more rows\n";
+        out += std::to_string(rows()) + " rows returned.\n";
+        os.write(out.data(), static_cast<std::streamsize>(out.size()));
+    }
+
+  private:
+    inline static const std::string kNull = "NULL";
+
+    static constexpr uint32_t kNullLength = UINT32_MAX;
+
+    // Terminal columns taken by s: one per UTF-8 code point, two for escaped control chars
+    static size_t displayWidth(std::string_view s) {
+        size_t w = 0;
+        for (unsigned char ch : s) {
+            if ((ch & 0xC0) != 0x80)
+                w += ch < 0x20 ? 2 : 1;
+        }
+        return w;
+    }
+
+    // Appends s padded or truncated to exactly width columns, never splitting a code point
+    static void appendCell(std::string& out, std::string_view s, size_t width) {
+        const bool cut = displayWidth(s) > width;
+        const size_t budget = cut ? (width ? width - 1 : 0) : width;
+        size_t used = 0;
+        for (size_t i = 0; i < s.size();) {
+            unsigned char ch = s[i];
+            size_t len = ch < 0x80 ? 1 : ch < 0xE0 ? 2 : ch < 0xF0 ? 3 : 4;
+            size_t w = ch < 0x20 ? 2 : 1;
+            if (used + w > budget)
+                break;
+            if (ch == '\n')
+                out += "\\n";
+            else if (ch == '\r')
+                out += "\\r";
+            else if (ch == '\t')
+                out += "\\t";
+            else if (ch < 0x20)
+                out += "\\?";
+            else
+                out.append(s.data() + i, std::min(len, s.size() - i));
+            used += w;
+            i += len;
+        }
+        if (cut && width) {
+            out += "…";
+            ++used;
+        }
+        out.append(width - used, ' ');
+    }
+
+    // Spilled row layout: u32 cell count, then per cell a u32 length (kNullLength for NULL)
+    // followed by the bytes
+    size_t width(size_t row) const {
+        if (row < table_.size())
+            return table_[row].size();
+        uint32_t n = 0;
+        std::memcpy(&n, spill_->data() + spilled_[row - table_.size()], 4);
+        return n;
+    }
+
+    std::optional<std::string_view> cellView(size_t row, size_t col) const {
+        if (row < table_.size()) {
+            if (col >= table_[row].size() || is_null(row, col))
+                return std::nullopt;
+            return std::string_view(table_[row][col]);
+        }
+        if (row >= rows() || col >= width(row))
+            return std::nullopt;
+        const char* p = spill_->data() + spilled_[row - table_.size()] + 4;
+        for (size_t c = 0;; ++c) {
+            uint32_t len = 0;
+            std::memcpy(&len, p, 4);
+            p += 4;
+            if (c == col)
+                return len == kNullLength ? std::nullopt
+                                          : std::optional<std::string_view>({p, len});
+            if (len != kNullLength)
+                p += len;
+        }
+    }
+
+    template <typename T, typename Parse>
+    std::optional<T> typedCell(size_t row, size_t col, Parse parse) const {
+        T value;
+        if (auto cell = cellView(row, col); cell && parse(*cell, value))
+            return value;
+        return std::nullopt;
+    }
+
+    // Cells are gathered kParseBatch at a time, so the parser runs over short arrays
+    static constexpr size_t kParseBatch = 1024;
+
+    template <typename T, typename Parse>
+    void parseRange(size_t col, size_t first, size_t n, T* values, uint8_t* valid,
+                    Parse parse) const {
+        Cells cells(std::min(n, kParseBatch));
+        for (size_t done = 0; done < n; done += cells.size()) {
+            const size_t len = std::min(n - done, cells.size());
+            for (size_t i = 0; i < len; ++i) cells[i] = cellView(first + done + i, col);
+            parse(cells.data(), len, values + done, valid + done);
+        }
+    }
+
+    template <typename T, typename Parse>
+    TypedColumn<T> typedColumn(size_t col, Parse parse) const {
+        TypedColumn<T> column;
+        column.values.resize(rows());
+        column.valid.resize(rows());
+        parseRange(col, 0, rows(), column.values.data(), column.valid.data(), parse);
+        return column;
+    }
+
+    static size_t rowBytes(const Row& row) {
+        size_t bytes = sizeof(Row);
+        for (const auto& cell : row) bytes += sizeof(std::string) + cell.size();
+        return bytes;
+    }
+
+    static size_t stringHeap(const std::string& s) {
+        const char* self = reinterpret_cast<const char*>(&s);
+        return s.data() >= self && s.data() < self + sizeof(s) ? 0 : s.capacity() + 1;
+    }
+    static size_t stringsHeap(const std::vector<std::string>& v) {
+        size_t bytes = v.capacity() * sizeof(std::string);
+        for (const auto& s : v) bytes += stringHeap(s);
+        return bytes;
+    }
+
+    // True when row goes to the spill file: past the policy's own limit, or when the
+    // process-wide soft limit asks for it. A rejected result keeps no further rows.
+    bool spillNext(const Row& row) {
+        if (spill_)
+            return true;
+        if (rejected_)
+            return false;
+        const size_t next = memory_bytes_ + rowBytes(row);
+        if (policy_.memory_limit == 0 || next <= policy_.memory_limit) {
+            auto admit = lease_.grow(next);
+            if (admit == MemoryAccountant::Admit::Ok)
+                return false;
+            if (admit == MemoryAccountant::Admit::Reject) {
+                rejected_ = true;
+                return false;
+            }
+            if (spill_failed_) {
+                lease_.force(next);
+                return false;
+            }
+        }
+        spill_ = SpillFile::create(policy_.dir);
+        if (!spill_) {
+            // No temp file: keep everything in memory
+            policy_.memory_limit = 0;
+            spill_failed_ = true;
+            lease_.force(next);
+        }
+        return spill_ != nullptr;
+    }
+
+    // Encodes into a local buffer first: cells may point into spill_, which append() remaps.
+    // Out of file space the row is dropped and the result marked, like a rejected one.
+    void spillRow(const Cells& cells) {
+        if (spill_error_)
+            return;
+        std::string buf;
+        auto put = [&buf](uint32_t v) { buf.append(reinterpret_cast<const char*>(&v), 4); };
+        put(static_cast<uint32_t>(cells.size()));
+        for (const auto& cell : cells) {
+            put(cell ? static_cast<uint32_t>(cell->size()) : kNullLength);
+            if (cell)
+                buf.append(cell->data(), cell->size());
+        }
+        uint64_t at = ownSpill() ? spill_->append(buf.data(), buf.size()) : UINT64_MAX;
+        if (at == UINT64_MAX) {
+            spill_error_ = true;
+            return;
+        }
+        spilled_.push_back(at);
+    }
+
+    // Copies share the spill file until one of them changes it: append() remaps the file
+    // under the others' views and nullSpilled() rewrites their last row. That one first
+    // moves to a private copy; false when the copy cannot be made.
+    bool ownSpill() {
+        if (spill_.use_count() <= 1)
+            return true;
+        std::shared_ptr<SpillFile> own = SpillFile::create(policy_.dir);
+        if (!own)
+            return false;
+        if (spill_->size() && own->append(spill_->data(), spill_->size()) == UINT64_MAX)
+            return false;
+        spill_ = std::move(own);
+        return true;
+    }
+
+    void nullSpilled(size_t index, size_t col) {
+        if (index + 1 != spilled_.size())
+            return;
+        if (!ownSpill()) {
+            spill_error_ = true;
+            return;
+        }
+        size_t row = table_.size() + index;
+        std::vector<std::optional<std::string>> owned(std::max(width(row), col + 1));
+        for (size_t c = 0; c < width(row); ++c)
+            if (c != col && cellView(row, c))
+                owned[c] = std::string(*cellView(row, c));
+        Cells cells(owned.begin(), owned.end());
+
+        // Reclaim the old encoding when nothing was appended to the file after it
+        const char* start = spill_->data() + spilled_[index];
+        const char* p = start + 4;
+        for (size_t c = 0; c < width(row); ++c) {
+            uint32_t len = 0;
+            std::memcpy(&len, p, 4);
+            p += 4 + (len == kNullLength ? 0 : len);
+        }
+        if (spilled_[index] + static_cast<uint64_t>(p - start) == spill_->size())
+            spill_->truncate(spilled_[index]);
+        spilled_.pop_back();
+        spillRow(cells);
+    }
+
+    Table table_;
+    std::vector<std::string> columns_;
+    std::vector<ColumnType> types_;             // empty means all Text
+    std::vector<std::vector<uint64_t>> nulls_;  // per-column bitmap, allocated on first NULL
+    SpillPolicy policy_;
+    size_t memory_bytes_ = 0;           // estimate for table_, charged through lease_
+    MemoryLease lease_;
+    bool rejected_ = false;
+    bool spill_failed_ = false;  // no spill file could be created, rows stay in memory
+    bool spill_error_ = false;   // the spill file could not grow, rows were dropped
+    std::shared_ptr<SpillFile> spill_;  // shared by copies until one writes, see ownSpill()
+    std::vector<uint64_t> spilled_;     // file offset of each row after table_
+};
@@ -1,103 +1,479 @@
-#pragma once
-#include <optional>
-#include <sstream>
-#include <string>
-#include <vector>
-
-class QueryBuilder {
-  public:
-    QueryBuilder& table(const std::string& t) {
-        _table = t;
-        return *this;
-    }
-
-    QueryBuilder& select(const std::string& col) {
-        _selects.push_back(col);
-        return *this;
-    }
-
-    QueryBuilder& join(const std::string& joinTable, const std::string& onLeft,
-                       const std::string& onRight, const std::string& type = "INNER") {
-        std::ostringstream os;
-        os << type << " JOIN " << joinTable << " ON " << onLeft << " = " << onRight;
-        _joins.push_back(os.str());
-        return *this;
-    }
-
-    QueryBuilder& leftJoin(const std::string& joinTable, const std::string& onLeft,
-                           const std::string& onRight) {
-        return join(joinTable, onLeft, onRight, "LEFT");
-    }
-
-    QueryBuilder& rightJoin(const std::string& joinTable, const std::string& onLeft,
-                            const std::string& onRight) {
-        return join(joinTable, onLeft, onRight, "RIGHT");
-    }
-
-    QueryBuilder& where(const std::string& cond) {
-        _wheres.push_back(cond);
-        return *this;
-    }
-
-    QueryBuilder& orderBy(const std::string& expr) {
-        _orderBy = expr;
-        return *this;
-    }
-
-    QueryBuilder& limit(int n) {
-        _limit = n;
-        return *this;
-    }
-
-    QueryBuilder& offset(int n) {
-        _offset = n;
-        return *this;
-    }
-
-    std::string str() const {
-        std::ostringstream os;
-        os << "SELECT ";
-        if (_selects.empty())
-            os << "*";
-        else {
-            for (size_t i = 0; i < _selects.size(); ++i) {
-                if (i)
-                    os << ", ";
-                os << _selects[i];
-            }
-        }
-
-        os << " FROM " << _table;
-
-        for (auto& j : _joins) os << " " << j;
-
-        if (!_wheres.empty()) {
-            os << " WHERE ";
-            for (size_t i = 0; i < _wheres.size(); ++i) {
-                if (i)
-                    os << " AND ";
-                os << _wheres[i];
-            }
-        }
-
-        if (_orderBy)
-            os << " ORDER BY " << *_orderBy;
-
-        if (_limit)
-            os << " LIMIT " << *_limit;
-
-        if (_offset)
-            os << " OFFSET " << *_offset;
-
-        return os.str();
-    }
-
-  private:
-    std::string _table;
-    std::vector<std::string> _selects;
-    std::vector<std::string> _joins;
-    std::vector<std::string> _wheres;
-    std::optional<std::string> _orderBy;
-    std::optional<int> _limit;
-    std::optional<int> _offset;
-};
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "cancellation.h"
+
+class QueryBuilder {
+  public:
+    using Param = std::optional<std::string>;  // empty = SQL NULL
+    using Params = std::vector<Param>;
+
+    // Placeholder syntax for bound parameters: SQLite takes ?, PostgreSQL $1, $2, ...
+    enum class ParamStyle { Question, Numbered };
+
+    enum class Kind { Select, Insert, Update, Delete };
+
+    struct Join {
+        std::string table;  // may carry an alias, e.g. "orders o"
+        std::string onLeft;
+        std::string onRight;
+        std::string type;  // INNER, LEFT or RIGHT
+    };
+
+    QueryBuilder& table(const std::string& t) {
+        _table = t;
+        _precompiled.reset();
+        return *this;
+    }
+
+    // INSERT INTO table (columns) VALUES ..., one values() call per row with one value per
+    // column; all values are bound
+    QueryBuilder& insertInto(const std::string& t, std::vector<std::string> columns) {
+        _kind = Kind::Insert;
+        _table = t;
+        _columns = std::move(columns);
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& values(Params row) {
+        _rows.push_back(std::move(row));
+        _precompiled.reset();
+        return *this;
+    }
+
+    // Upsert: INSERT ... ON CONFLICT (columns), followed by doUpdate() or doNothing(). The
+    // conflict columns need a unique index on both PostgreSQL and SQLite (3.24+).
+    QueryBuilder& onConflict(std::vector<std::string> columns) {
+        _conflict = Conflict{std::move(columns), {}};
+        _precompiled.reset();
+        return *this;
+    }
+
+    // SET column = excluded.column for each column; empty = every inserted column outside the
+    // conflict target. Needs an onConflict() target: DO UPDATE without one is not valid SQL.
+    QueryBuilder& doUpdate(std::vector<std::string> columns = {}) {
+        if (!_conflict)
+            _conflict = Conflict{};
+        if (columns.empty())
+            for (const auto& col : _columns)
+                if (std::find(_conflict->columns.begin(), _conflict->columns.end(), col) ==
+                    _conflict->columns.end())
+                    columns.push_back(col);
+        _conflict->updates = std::move(columns);
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& doNothing() {
+        if (!_conflict)
+            _conflict = Conflict{};
+        _conflict->updates.clear();
+        _precompiled.reset();
+        return *this;
+    }
+
+    // UPDATE table SET column = value, ... WHERE ...; values are bound
+    QueryBuilder& update(const std::string& t) {
+        _kind = Kind::Update;
+        _table = t;
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& set(const std::string& column, Param value) {
+        _sets.emplace_back(column, std::move(value));
+        _precompiled.reset();
+        return *this;
+    }
+
+    // DELETE FROM table WHERE ...
+    QueryBuilder& deleteFrom(const std::string& t) {
+        _kind = Kind::Delete;
+        _table = t;
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& select(const std::string& col) {
+        _selects.push_back(col);
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& join(const std::string& joinTable, const std::string& onLeft,
+                       const std::string& onRight, const std::string& type = "INNER") {
+        _joins.push_back(Join{joinTable, onLeft, onRight, type});
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& leftJoin(const std::string& joinTable, const std::string& onLeft,
+                           const std::string& onRight) {
+        return join(joinTable, onLeft, onRight, "LEFT");
+    }
+
+    QueryBuilder& rightJoin(const std::string& joinTable, const std::string& onLeft,
+                            const std::string& onRight) {
+        return join(joinTable, onLeft, onRight, "RIGHT");
+    }
+
+    QueryBuilder& where(const std::string& cond) {
+        _wheres.push_back(cond);
+        _precompiled.reset();
+        return *this;
+    }
+
+    // column = ? with value bound, ANDed after the where() conditions
+    QueryBuilder& whereEquals(const std::string& column, std::string value) {
+        _whereEquals.emplace_back(column, std::move(value));
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& orderBy(const std::string& expr) {
+        _orderBy = expr;
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& limit(int n) {
+        _limit = n;
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& offset(int n) {
+        _offset = n;
+        _precompiled.reset();
+        return *this;
+    }
+
+    // Keyset pagination: only rows ordered after lastValues on columns (before them when
+    // descending), rendered as `(a, b) > (?, ?)` with the values bound as parameters; one
+    // value per column. Without an explicit orderBy the query is ordered by the same columns.
+    QueryBuilder& seekAfter(std::vector<std::string> columns, std::vector<std::string> lastValues,
+                            bool descending = false) {
+        _seek = Seek{std::move(columns), std::move(lastValues), descending};
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& clearValues() {
+        _rows.clear();
+        _precompiled.reset();
+        return *this;
+    }
+
+    QueryBuilder& clearOffset() {
+        _offset.reset();
+        _precompiled.reset();
+        return *this;
+    }
+
+    // Routing hint for sharded databases: value of the shard key this query touches
+    QueryBuilder& shard(const std::string& key) {
+        _shardKey = key;
+        return *this;
+    }
+
+    // Limit on the time the backend may spend running this query, counted from when it starts;
+    // a query that runs out fails with QueryStatus::TimedOut
+    QueryBuilder& timeout(std::chrono::milliseconds limit) {
+        _timeout = limit;
+        return *this;
+    }
+
+    // The query fails with QueryStatus::Cancelled once token.cancel() is called
+    QueryBuilder& cancelledBy(CancellationToken token) {
+        _cancellation = std::move(token);
+        return *this;
+    }
+
+    // Statement text str() returns as is, per ParamStyle, instead of rendering it. The builder
+    // must still describe the same statement, which backends without SQL read; orm/table.h
+    // produces both at compile time. Both views must outlive the builder. Any later call that
+    // changes the statement drops the text; rebind() keeps it.
+    QueryBuilder& precompiled(std::string_view question, std::string_view numbered) {
+        _precompiled = std::make_pair(question, numbered);
+        return *this;
+    }
+
+    // Replaces the bound values, in getParams() order, and keeps the statement: a builder set
+    // up once serves every call of the same shape. False, leaving the builder as it was, when
+    // params does not hold one value per placeholder or has a NULL for a whereEquals() or
+    // seekAfter() value.
+    bool rebind(Params params) {
+        size_t nullable = _sets.size();
+        for (const auto& row : _rows) nullable += row.size();
+        const size_t total = nullable + _whereEquals.size() + (_seek ? _seek->values.size() : 0);
+        if (params.size() != total ||
+            std::any_of(params.begin() + static_cast<std::ptrdiff_t>(nullable), params.end(),
+                        [](const Param& value) { return !value; }))
+            return false;
+
+        auto next = params.begin();
+        for (auto& row : _rows)
+            for (auto& value : row) value = std::move(*next++);
+        for (auto& [column, value] : _sets) value = std::move(*next++);
+        for (auto& [column, value] : _whereEquals) value = std::move(**next++);
+        if (_seek)
+            for (auto& value : _seek->values) value = std::move(**next++);
+        return true;
+    }
+
+    Kind getKind() const { return _kind; }
+    const std::string& getTable() const { return _table; }
+    const std::vector<std::string>& getInsertColumns() const { return _columns; }
+    const std::vector<Params>& getInsertRows() const { return _rows; }
+    const std::vector<std::pair<std::string, Param>>& getSets() const { return _sets; }
+    const std::vector<std::string>* getConflictColumns() const {
+        return _conflict ? &_conflict->columns : nullptr;
+    }
+    // Columns overwritten on conflict; empty means DO NOTHING
+    const std::vector<std::string>* getConflictUpdates() const {
+        return _conflict ? &_conflict->updates : nullptr;
+    }
+    const std::vector<std::string>& getSelects() const { return _selects; }
+    const std::vector<Join>& getJoins() const { return _joins; }
+    const std::vector<std::string>& getWheres() const { return _wheres; }
+    const std::vector<std::pair<std::string, std::string>>& getWhereEquals() const {
+        return _whereEquals;
+    }
+    const std::optional<std::string>& getOrderBy() const { return _orderBy; }
+    const std::optional<int>& getLimit() const { return _limit; }
+    const std::optional<int>& getOffset() const { return _offset; }
+    const std::optional<std::string>& getShardKey() const { return _shardKey; }
+    const std::optional<std::chrono::milliseconds>& getTimeout() const { return _timeout; }
+    const std::optional<CancellationToken>& getCancellation() const { return _cancellation; }
+    const std::vector<std::string>* getSeekColumns() const {
+        return _seek ? &_seek->columns : nullptr;
+    }
+    const std::vector<std::string>* getSeekValues() const {
+        return _seek ? &_seek->values : nullptr;
+    }
+    bool isSeekDescending() const { return _seek && _seek->descending; }
+    // orderBy, or the seek columns when only seekAfter() was given
+    std::optional<std::string> getEffectiveOrderBy() const {
+        if (_orderBy || !_seek)
+            return _orderBy;
+        std::string order;
+        for (size_t i = 0; i < _seek->columns.size(); ++i)
+            order += (i ? ", " : "") + _seek->columns[i] + (_seek->descending ? " DESC" : "");
+        return order;
+    }
+
+    // False when there is no statement to render: no table, an INSERT without rows or with a
+    // row whose length differs from its columns, an UPDATE without set(), a doUpdate() without
+    // an onConflict() target, a seekAfter() without one value per column
+    bool isValid() const {
+        if (_table.empty())
+            return false;
+        if (_kind == Kind::Update && _sets.empty())
+            return false;
+        if (_conflict && !_conflict->updates.empty() && _conflict->columns.empty())
+            return false;
+        if (_kind == Kind::Insert &&
+            (_columns.empty() || _rows.empty() ||
+             std::any_of(_rows.begin(), _rows.end(),
+                         [this](const Params& row) { return row.size() != _columns.size(); })))
+            return false;
+        return !_seek || (!_seek->columns.empty() && _seek->columns.size() == _seek->values.size());
+    }
+
+    // Values for the placeholders of str(), in order
+    Params getParams() const {
+        Params params;
+        for (const auto& row : _rows) params.insert(params.end(), row.begin(), row.end());
+        for (const auto& [column, value] : _sets) params.push_back(value);
+        for (const auto& [column, value] : _whereEquals) params.push_back(value);
+        if (_seek)
+            params.insert(params.end(), _seek->values.begin(), _seek->values.end());
+        return params;
+    }
+
+    // Multi-row INSERTs split so no statement binds more than maxParams values; other
+    // statements come back unchanged
+    std::vector<QueryBuilder> split(size_t maxParams) const {
+        if (_kind != Kind::Insert || _columns.empty() ||
+            _rows.size() * _columns.size() <= maxParams)
+            return {*this};
+        size_t perChunk = std::max<size_t>(1, maxParams / _columns.size());
+        std::vector<QueryBuilder> chunks;
+        for (size_t first = 0; first < _rows.size(); first += perChunk) {
+            QueryBuilder chunk = *this;
+            size_t last = std::min(_rows.size(), first + perChunk);
+            chunk._rows.assign(_rows.begin() + first, _rows.begin() + last);
+            chunk._precompiled.reset();  // written for all the rows
+            chunks.push_back(std::move(chunk));
+        }
+        return chunks;
+    }
+
+    // Empty when !isValid(), which backends then reject as an invalid statement
+    std::string str(ParamStyle style = ParamStyle::Question) const {
+        if (_table.empty())
+            return "";
+        if (_precompiled)
+            return std::string(style == ParamStyle::Question ? _precompiled->first
+                                                             : _precompiled->second);
+        if (!isValid())
+            return "";
+
+        size_t nextParam = 0;
+        auto placeholder = [&]() {
+            ++nextParam;
+            return style == ParamStyle::Question ? std::string("?")
+                                                 : "$" + std::to_string(nextParam);
+        };
+
+        std::ostringstream os;
+        if (_kind == Kind::Insert) {
+            os << "INSERT INTO " << _table << " (";
+            for (size_t i = 0; i < _columns.size(); ++i) os << (i ? ", " : "") << _columns[i];
+            os << ") VALUES ";
+            for (size_t r = 0; r < _rows.size(); ++r) {
+                os << (r ? ", (" : "(");
+                for (size_t i = 0; i < _rows[r].size(); ++i)
+                    os << (i ? ", " : "") << placeholder();
+                os << ")";
+            }
+            if (_conflict)
+                appendConflict(os);
+            return os.str();
+        }
+
+        if (_kind == Kind::Update) {
+            os << "UPDATE " << _table << " SET ";
+            for (size_t i = 0; i < _sets.size(); ++i)
+                os << (i ? ", " : "") << _sets[i].first << " = " << placeholder();
+            appendWhere(os, placeholder);
+            return os.str();
+        }
+
+        if (_kind == Kind::Delete) {
+            os << "DELETE FROM " << _table;
+            appendWhere(os, placeholder);
+            return os.str();
+        }
+
+        os << "SELECT ";
+        if (_selects.empty())
+            os << "*";
+        else {
+            for (size_t i = 0; i < _selects.size(); ++i) {
+                if (i)
+                    os << ", ";
+                os << _selects[i];
+            }
+        }
+
+        os << " FROM " << _table;
+
+        for (auto& j : _joins)
+            os << " " << j.type << " JOIN " << j.table << " ON " << j.onLeft << " = " << j.onRight;
+
+        appendWhere(os, placeholder);
+
+        if (auto order = getEffectiveOrderBy())
+            os << " ORDER BY " << *order;
+
+        if (_limit)
+            os << " LIMIT " << *_limit;
+
+        if (_offset)
+            os << " OFFSET " << *_offset;
+
+        return os.str();
+    }
+
+  private:
+    struct Seek {
+        std::vector<std::string> columns;
+        std::vector<std::string> values;
+        bool descending;
+    };
+
+    struct Conflict {
+        std::vector<std::string> columns;
+        std::vector<std::string> updates;
+    };
+
+    void appendConflict(std::ostringstream& os) const {
+        os << " ON CONFLICT";
+        if (!_conflict->columns.empty()) {
+            os << " (";
+            for (size_t i = 0; i < _conflict->columns.size(); ++i)
+                os << (i ? ", " : "") << _conflict->columns[i];
+            os << ")";
+        }
+        if (_conflict->updates.empty()) {
+            os << " DO NOTHING";
+            return;
+        }
+        os << " DO UPDATE SET ";
+        for (size_t i = 0; i < _conflict->updates.size(); ++i)
+            os << (i ? ", " : "") << _conflict->updates[i] << " = excluded."
+               << _conflict->updates[i];
+    }
+
+    template <typename Placeholder>
+    void appendWhere(std::ostringstream& os, Placeholder& placeholder) const {
+        if (_wheres.empty() && _whereEquals.empty() && !_seek)
+            return;
+        os << " WHERE ";
+        for (size_t i = 0; i < _wheres.size(); ++i) {
+            if (i)
+                os << " AND ";
+            os << _wheres[i];
+        }
+        for (size_t i = 0; i < _whereEquals.size(); ++i) {
+            if (i || !_wheres.empty())
+                os << " AND ";
+            os << _whereEquals[i].first << " = " << placeholder();
+        }
+        if (_seek) {
+            if (!_wheres.empty() || !_whereEquals.empty())
+                os << " AND ";
+            os << seekColumns() << (_seek->descending ? " < " : " > ");
+            std::string values;
+            for (size_t i = 0; i < _seek->values.size(); ++i)
+                values += (i ? ", " : "") + placeholder();
+            os << (_seek->values.size() == 1 ? values : "(" + values + ")");
+        }
+    }
+
+    std::string seekColumns() const {
+        std::string cols;
+        for (size_t i = 0; i < _seek->columns.size(); ++i)
+            cols += (i ? ", " : "") + _seek->columns[i];
+        return _seek->columns.size() == 1 ? cols : "(" + cols + ")";
+    }
+
+    Kind _kind = Kind::Select;
+    std::string _table;
+    std::vector<std::string> _columns;                 // INSERT column list
+    std::vector<Params> _rows;                         // INSERT VALUES rows
+    std::vector<std::pair<std::string, Param>> _sets;  // UPDATE assignments
+    std::optional<Conflict> _conflict;                 // INSERT ... ON CONFLICT
+    std::vector<std::string> _selects;
+    std::vector<Join> _joins;
+    std::vector<std::string> _wheres;
+    std::vector<std::pair<std::string, std::string>> _whereEquals;  // bound column = value
+    std::optional<std::string> _orderBy;
+    std::optional<int> _limit;
+    std::optional<int> _offset;
+    std::optional<std::string> _shardKey;
+    std::optional<Seek> _seek;
+    std::optional<std::chrono::milliseconds> _timeout;
+    std::optional<CancellationToken> _cancellation;
+    std::optional<std::pair<std::string_view, std::string_view>> _precompiled;
+};
@@ -0,0 +1,489 @@
+#include "sharded_database.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <future>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+#include "cell_parse.h"
+#include "spdlog/fmt/bundled/format.h"
+
+namespace {
+    uint64_t hashKey(const std::string& s) {
+        uint64_t h = 1469598103934665603ULL;  // FNV-1a
+        for (unsigned char c : s) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        // splitmix64 finalizer spreads neighbouring keys around the ring
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        return h ^ (h >> 31);
+    }
+
+    std::string trim(const std::string& s) {
+        size_t b = s.find_first_not_of(" \t\n");
+        size_t e = s.find_last_not_of(" \t\n");
+        return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+    }
+
+    std::string unqualified(const std::string& name) {
+        size_t dot = name.rfind('.');
+        return dot == std::string::npos ? name : name.substr(dot + 1);
+    }
+
+    std::optional<double> asNumber(std::string_view s) {
+        double v = 0;
+        auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+        if (ec != std::errc() || end != s.data() + s.size() || s.empty())
+            return std::nullopt;
+        return v;
+    }
+
+    // Range bounds: numbers compare numerically, anything else lexicographically
+    int compareValues(std::string_view a, std::string_view b) {
+        auto na = asNumber(a), nb = asNumber(b);
+        if (na && nb)
+            return *na < *nb ? -1 : (*na > *nb ? 1 : 0);
+        return a.compare(b) < 0 ? -1 : (a == b ? 0 : 1);
+    }
+
+    // The shards' own order for a column of type: numeric columns by value, anything else by
+    // bytes (SQLite's BINARY collation, PostgreSQL's "C")
+    int compareTyped(std::string_view a, std::string_view b, ColumnType type) {
+        if (type == ColumnType::Int64) {
+            int64_t x = 0, y = 0;
+            if (parseInt64(a, x) && parseInt64(b, y))
+                return x < y ? -1 : (x > y ? 1 : 0);
+        } else if (type == ColumnType::Double) {
+            double x = 0, y = 0;
+            if (parseDouble(a, x) && parseDouble(b, y))
+                return x < y ? -1 : (x > y ? 1 : 0);
+        }
+        return a.compare(b) < 0 ? -1 : (a == b ? 0 : 1);
+    }
+
+    // `5`, `-1.5`: a number the shard key can be compared with as is
+    bool isNumberLiteral(const std::string& s) {
+        size_t digits = 0, dots = 0;
+        for (size_t i = !s.empty() && s[0] == '-' ? 1 : 0; i < s.size(); ++i) {
+            if (s[i] == '.')
+                ++dots;
+            else if (std::isdigit(static_cast<unsigned char>(s[i])))
+                ++digits;
+            else
+                return false;
+        }
+        return digits > 0 && dots <= 1;
+    }
+
+    // The value of cond when it is exactly `key = 5` or `t.key = 'text'`; anything else
+    // (`key = 5 OR key = 6`, `key = t.other`, `key = 5 + 1`) does not pin the key
+    std::optional<std::string> keyLiteral(const std::string& cond, const std::string& key) {
+        size_t eq = cond.find('=');
+        if (eq == std::string::npos)
+            return std::nullopt;
+        std::string column = trim(cond.substr(0, eq));
+        std::string value = trim(cond.substr(eq + 1));
+        bool identifier = !column.empty() &&
+                          std::all_of(column.begin(), column.end(), [](unsigned char c) {
+                              return std::isalnum(c) || c == '_' || c == '.';
+                          });
+        if (!identifier || unqualified(column) != key)
+            return std::nullopt;
+        if (isNumberLiteral(value))
+            return value;
+        if (value.size() < 2 || value.front() != '\'' || value.back() != '\'')
+            return std::nullopt;
+        // One quoted string: inner quotes only as '' escapes
+        std::string text;
+        for (size_t i = 1; i + 1 < value.size(); ++i) {
+            if (value[i] == '\'') {
+                if (i + 2 >= value.size() || value[i + 1] != '\'')
+                    return std::nullopt;
+                ++i;
+            }
+            text += value[i];
+        }
+        return text;
+    }
+
+    struct OrderTerm {
+        size_t column;
+        bool descending;
+        bool nulls_first;
+    };
+
+    // Map "u.score DESC, id NULLS FIRST" onto result column indexes; empty if a term is not
+    // selected. NULLs default to the end nulls_last names for ASC, the other end for DESC.
+    std::optional<std::vector<OrderTerm>> orderTerms(const std::string& orderBy,
+                                                     const std::vector<std::string>& columns,
+                                                     bool nulls_last) {
+        std::vector<OrderTerm> terms;
+        size_t start = 0;
+        while (start <= orderBy.size()) {
+            size_t comma = orderBy.find(',', start);
+            std::string term = trim(orderBy.substr(
+                start, comma == std::string::npos ? std::string::npos : comma - start));
+            start = comma == std::string::npos ? orderBy.size() + 1 : comma + 1;
+            if (term.empty())
+                continue;
+
+            bool desc = false;
+            std::optional<bool> nullsFirst;
+            size_t space = term.find_first_of(" \t");
+            std::string expr = term.substr(0, space);
+            if (space != std::string::npos) {
+                std::string dir = trim(term.substr(space));
+                std::transform(dir.begin(), dir.end(), dir.begin(), ::toupper);
+                desc = dir.rfind("DESC", 0) == 0;
+                if (dir.find("NULLS FIRST") != std::string::npos)
+                    nullsFirst = true;
+                else if (dir.find("NULLS LAST") != std::string::npos)
+                    nullsFirst = false;
+            }
+
+            auto it = std::find_if(columns.begin(), columns.end(), [&](const std::string& c) {
+                return c == expr || unqualified(c) == unqualified(expr);
+            });
+            if (it == columns.end())
+                return std::nullopt;
+            terms.push_back({static_cast<size_t>(it - columns.begin()), desc,
+                             nullsFirst.value_or(desc == nulls_last)});
+        }
+        return terms;
+    }
+
+    // Status of a fanned-out operation: a cancelled or timed-out shard explains the failure
+    QueryStatus combined(const std::vector<QueryStatus>& statuses) {
+        QueryStatus result = QueryStatus::Ok;
+        for (QueryStatus s : statuses) {
+            if (s == QueryStatus::Cancelled || s == QueryStatus::TimedOut)
+                return s;
+            if (s == QueryStatus::Failed)
+                result = s;
+        }
+        return result;
+    }
+}  // namespace
+
+ShardedDatabase::ShardedDatabase(std::vector<std::unique_ptr<IDatabase>> shards,
+                                 ShardingPolicy policy, ILogger* logger)
+    : IDatabase(ConnectionConfig{}, logger), policy_(std::move(policy)) {
+    for (auto& shard : shards) addShard(std::move(shard));
+}
+
+void ShardedDatabase::addShard(std::unique_ptr<IDatabase> shard) {
+    shards_.push_back(std::move(shard));
+    addRingPoints(shards_.size() - 1);
+}
+
+void ShardedDatabase::addRingPoints(size_t shard) {
+    for (int v = 0; v < policy_.virtual_nodes; ++v)
+        ring_[hashKey(fmt::format("shard-{}#{}", shard, v))] = shard;
+}
+
+size_t ShardedDatabase::shardFor(const std::string& key) const {
+    if (shards_.empty() || (policy_.kind == ShardingPolicy::Kind::Hash && ring_.empty()))
+        throw std::logic_error("ShardedDatabase has no shards on its ring");
+
+    if (policy_.kind == ShardingPolicy::Kind::Range) {
+        const auto& bounds = policy_.range_bounds;
+        for (size_t i = 0; i < bounds.size() && i + 1 < shards_.size(); ++i)
+            if (compareValues(key, bounds[i]) < 0)
+                return i;
+        return std::min(bounds.size(), shards_.size() - 1);
+    }
+
+    auto it = ring_.lower_bound(hashKey(key));
+    return it == ring_.end() ? ring_.begin()->second : it->second;
+}
+
+std::optional<std::string> ShardedDatabase::routingKey(const QueryBuilder& qb) const {
+    if (qb.getShardKey())
+        return qb.getShardKey();
+    if (policy_.key.empty())
+        return std::nullopt;
+
+    for (const auto& [column, value] : qb.getWhereEquals())
+        if (unqualified(column) == policy_.key)
+            return value;
+    // Conditions are AND-ed, so one that pins the key is enough
+    for (const auto& cond : qb.getWheres())
+        if (auto value = keyLiteral(cond, policy_.key))
+            return value;
+    return std::nullopt;
+}
+
+bool ShardedDatabase::open() {
+    if (shards_.empty() || (policy_.kind == ShardingPolicy::Kind::Hash && ring_.empty())) {
+        logger_->error(fmt::format("ShardedDatabase needs shards and, hashed, virtual_nodes > 0 "
+                                   "(has {} shards, {} virtual nodes).",
+                                   shards_.size(), policy_.virtual_nodes));
+        return false;
+    }
+    std::vector<std::future<bool>> opened;
+    for (auto& shard : shards_)
+        opened.push_back(std::async(std::launch::async, [&shard] { return shard->open(); }));
+
+    bool ok = true;
+    for (auto& f : opened) ok = f.get() && ok;
+    return ok;
+}
+
+void ShardedDatabase::close() {
+    for (auto& shard : shards_) shard->close();
+}
+
+bool ShardedDatabase::is_open() const {
+    return !shards_.empty() && std::all_of(shards_.begin(), shards_.end(),
+                                           [](const auto& shard) { return shard->is_open(); });
+}
+
+bool ShardedDatabase::insert(const QueryBuilder& qb) {
+    if (auto key = routingKey(qb))
+        return shards_[shardFor(*key)]->insert(qb);
+
+    auto parts = partitionRows(qb);
+    if (!parts)
+        return false;
+    std::vector<std::future<bool>> done;
+    std::vector<QueryStatus> statuses(parts->size());
+    for (auto& [shard, part] : *parts)
+        done.push_back(std::async(std::launch::async, [this, shard = shard, &part = part,
+                                                       &status = statuses[done.size()]] {
+            bool ok = shards_[shard]->insert(part);
+            status = lastStatus();
+            return ok;
+        }));
+    bool ok = true;
+    for (auto& f : done) ok = f.get() && ok;
+    setStatus(combined(statuses));
+    return ok;
+}
+
+std::optional<size_t> ShardedDatabase::upsert(const QueryBuilder& qb) {
+    if (auto key = routingKey(qb))
+        return shards_[shardFor(*key)]->upsert(qb);
+
+    auto parts = partitionRows(qb);
+    if (!parts)
+        return std::nullopt;
+    std::vector<std::future<std::optional<size_t>>> done;
+    std::vector<QueryStatus> statuses(parts->size());
+    for (auto& [shard, part] : *parts)
+        done.push_back(std::async(std::launch::async, [this, shard = shard, &part = part,
+                                                       &status = statuses[done.size()]] {
+            auto n = shards_[shard]->upsert(part);
+            status = lastStatus();
+            return n;
+        }));
+    std::optional<size_t> affected = 0;
+    for (auto& f : done) {
+        auto n = f.get();
+        affected = affected && n ? std::optional<size_t>(*affected + *n) : std::nullopt;
+    }
+    setStatus(combined(statuses));
+    return affected;
+}
+
+// Multi-row VALUES: each row goes to the shard owning its key column. Shards commit
+// independently, so a failure on one shard leaves the others' rows in place.
+std::optional<std::map<size_t, QueryBuilder>> ShardedDatabase::partitionRows(
+    const QueryBuilder& qb) const {
+    const auto& columns = qb.getInsertColumns();
+    auto keyColumn = std::find(columns.begin(), columns.end(), policy_.key);
+    if (qb.getKind() != QueryBuilder::Kind::Insert || policy_.key.empty() ||
+        keyColumn == columns.end()) {
+        logger_->error("Sharded insert needs a shard key.");
+        return std::nullopt;
+    }
+    size_t keyIndex = keyColumn - columns.begin();
+
+    std::map<size_t, QueryBuilder> parts;
+    for (const auto& row : qb.getInsertRows()) {
+        if (keyIndex >= row.size() || !row[keyIndex]) {
+            logger_->error(fmt::format("Sharded insert into {} has a NULL shard key.",
+                                       qb.getTable()));
+            return std::nullopt;
+        }
+        size_t shard = shardFor(*row[keyIndex]);
+        auto it = parts.find(shard);
+        if (it == parts.end()) {
+            it = parts.emplace(shard, qb).first;
+            it->second.clearValues();
+        }
+        it->second.values(row);
+    }
+    return parts;
+}
+
+bool ShardedDatabase::prepare(const QueryBuilder& qb) {
+    std::vector<std::future<bool>> prepared;
+    for (auto& shard : shards_)
+        prepared.push_back(
+            std::async(std::launch::async, [&shard, &qb] { return shard->prepare(qb); }));
+
+    bool ok = true;
+    for (auto& f : prepared) ok = f.get() && ok;
+    return ok;
+}
+
+bool ShardedDatabase::update(const QueryBuilder& qb) {
+    if (auto key = routingKey(qb))
+        return shards_[shardFor(*key)]->update(qb);
+    return forEachShard(qb, &IDatabase::update);
+}
+
+bool ShardedDatabase::remove(const QueryBuilder& qb) {
+    if (auto key = routingKey(qb))
+        return shards_[shardFor(*key)]->remove(qb);
+    return forEachShard(qb, &IDatabase::remove);
+}
+
+bool ShardedDatabase::forEachShard(const QueryBuilder& qb,
+                                   bool (IDatabase::*op)(const QueryBuilder&)) {
+    std::vector<std::future<bool>> done;
+    std::vector<QueryStatus> statuses(shards_.size());
+    for (auto& shard : shards_)
+        done.push_back(std::async(std::launch::async,
+                                  [&shard, &qb, op, &status = statuses[done.size()]] {
+                                      bool ok = ((*shard).*op)(qb);
+                                      status = lastStatus();
+                                      return ok;
+                                  }));
+
+    bool ok = true;
+    for (auto& f : done) ok = f.get() && ok;
+    setStatus(combined(statuses));
+    return ok;
+}
+
+QueryResult ShardedDatabase::select(const QueryBuilder& qb) {
+    if (auto key = routingKey(qb))
+        return shards_[shardFor(*key)]->select(qb);
+    QueryResult merged = fanOut(qb);
+    if (merged.rejected()) {
+        logger_->error(merged.spill_error()
+                           ? "Sharded SELECT failed, its spill file cannot grow."
+                           : "Sharded SELECT rejected, process memory over its soft limit.");
+        setStatus(QueryStatus::Failed);
+        return QueryResult();
+    }
+    return merged;
+}
+
+QueryResult ShardedDatabase::fanOut(const QueryBuilder& qb) {
+    // Every shard must return its first offset+limit rows for the global window to be exact
+    QueryBuilder perShard = qb;
+    size_t offset = static_cast<size_t>(qb.getOffset().value_or(0));
+    if (qb.getLimit())
+        perShard.limit(*qb.getLimit() + static_cast<int>(offset));
+    perShard.clearOffset();
+
+    std::vector<std::future<QueryResult>> pending;
+    std::vector<QueryStatus> statuses(shards_.size());
+    for (auto& shard : shards_)
+        pending.push_back(std::async(std::launch::async,
+                                     [&shard, &perShard, &status = statuses[pending.size()]] {
+                                         QueryResult result = shard->select(perShard);
+                                         status = lastStatus();
+                                         return result;
+                                     }));
+
+    std::vector<QueryResult> parts;
+    std::vector<std::string> columns;
+    std::vector<ColumnType> types;
+    for (auto& f : pending) {
+        parts.push_back(f.get());
+        if (columns.empty()) {
+            columns = parts.back().columns();
+            types = parts.back().column_types();
+        }
+    }
+    setStatus(combined(statuses));
+    // Rows of the other shards would pass for the whole answer, and the global window be wrong
+    for (size_t s = 0; s < statuses.size(); ++s) {
+        if (statuses[s] != QueryStatus::Ok) {
+            logger_->error(fmt::format("Sharded SELECT failed on shard {}.", s));
+            return QueryResult();
+        }
+    }
+
+    // Without its sort columns the merge cannot honour ORDER BY, nor LIMIT/OFFSET after it
+    std::optional<std::vector<OrderTerm>> terms;
+    if (std::optional<std::string> orderBy = qb.getEffectiveOrderBy()) {
+        terms = orderTerms(*orderBy, columns, policy_.nulls_last);
+        if (!terms) {
+            logger_->error(fmt::format("Sharded SELECT cannot merge on ORDER BY {}: it is not "
+                                       "in the select list.",
+                                       *orderBy));
+            setStatus(QueryStatus::Failed);
+            return QueryResult();
+        }
+    }
+
+    size_t limit = qb.getLimit() ? static_cast<size_t>(*qb.getLimit()) : SIZE_MAX;
+    QueryResult merged({}, columns);
+    merged.set_column_types(std::move(types));
+    if (!parts.empty())
+        merged.set_spill_policy(parts.front().spill_policy());
+    auto emit = [&](size_t part, size_t row) {
+        if (offset > 0) {
+            --offset;
+            return true;
+        }
+        if (merged.rows() >= limit)
+            return false;
+        merged.append_row(parts[part], row);
+        return true;
+    };
+
+    if (!terms) {
+        for (size_t p = 0; p < parts.size(); ++p)
+            for (size_t r = 0; r < parts[p].rows(); ++r)
+                if (!emit(p, r))
+                    return merged;
+        return merged;
+    }
+
+    // k-way merge over the already sorted shard results
+    using Cursor = std::pair<size_t, size_t>;  // (part, row)
+    auto after = [&](const Cursor& a, const Cursor& b) {
+        for (const auto& t : *terms) {
+            const QueryResult& pa = parts[a.first];
+            const QueryResult& pb = parts[b.first];
+            bool nullA = pa.is_null(a.second, t.column), nullB = pb.is_null(b.second, t.column);
+            if (nullA || nullB) {
+                if (nullA == nullB)
+                    continue;
+                return nullA != t.nulls_first;
+            }
+            int c = compareTyped(pa.view(a.second, t.column), pb.view(b.second, t.column),
+                                 merged.column_type(t.column));
+            if (c != 0)
+                return t.descending ? c < 0 : c > 0;
+        }
+        return a.first > b.first;
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(after)> heap(after);
+    for (size_t p = 0; p < parts.size(); ++p)
+        if (!parts[p].empty())
+            heap.push({p, 0});
+
+    while (!heap.empty()) {
+        auto [p, r] = heap.top();
+        heap.pop();
+        if (!emit(p, r))
+            break;
+        if (r + 1 < parts[p].rows())
+            heap.push({p, r + 1});
+    }
+    return merged;
+}
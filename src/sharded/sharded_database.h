@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "database.h"
+
+struct ShardingPolicy {
+    enum class Kind { Hash, Range };
+
+    Kind kind = Kind::Hash;
+    std::string key;                       // shard key column, matched against `key = value`
+    int virtual_nodes = 64;                // Hash: points per shard on the consistent-hash ring
+    std::vector<std::string> range_bounds;  // Range: shard i holds keys < range_bounds[i]
+    // Where the shards sort NULL for ORDER BY ... ASC without NULLS FIRST/LAST: last on
+    // PostgreSQL, first on SQLite and MemoryDatabase. createSharded() sets it from the shards.
+    bool nulls_last = false;
+};
+
+// Routes each query to one shard by its shard key, or fans a key-less select out to every
+// shard in parallel and merges the results (k-way merge on ORDER BY, global LIMIT/OFFSET).
+// A query is routed only when its key is pinned to one value: shardKey(), whereEquals(key)
+// or a where() condition that is exactly `key = literal`.
+class ShardedDatabase : public IDatabase {
+  public:
+    ShardedDatabase(std::vector<std::unique_ptr<IDatabase>> shards, ShardingPolicy policy,
+                    ILogger* logger);
+
+    bool open() override;
+    void close() override;
+    bool is_open() const override;
+
+    bool insert(const QueryBuilder& qb) override;
+    bool update(const QueryBuilder& qb) override;
+    bool remove(const QueryBuilder& qb) override;
+    QueryResult select(const QueryBuilder& qb) override;
+    std::optional<size_t> upsert(const QueryBuilder& qb) override;
+    // On every shard, in parallel
+    bool prepare(const QueryBuilder& qb) override;
+
+    // Hash policy only moves ~1/N of the keys to the new shard
+    void addShard(std::unique_ptr<IDatabase> shard);
+    size_t shardCount() const { return shards_.size(); }
+    size_t shardFor(const std::string& key) const;
+
+  private:
+    std::optional<std::string> routingKey(const QueryBuilder& qb) const;
+    std::optional<std::map<size_t, QueryBuilder>> partitionRows(const QueryBuilder& qb) const;
+    bool forEachShard(const QueryBuilder& qb, bool (IDatabase::*op)(const QueryBuilder&));
+    QueryResult fanOut(const QueryBuilder& qb);
+    void addRingPoints(size_t shard);
+
+    std::vector<std::unique_ptr<IDatabase>> shards_;
+    ShardingPolicy policy_;
+    std::map<uint64_t, size_t> ring_;
+};
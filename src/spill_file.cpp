@@ -0,0 +1,65 @@
+#include "spill_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace {
+    constexpr uint64_t kInitialCapacity = uint64_t{1} << 20;
+}  // namespace
+
+std::shared_ptr<SpillFile> SpillFile::create(const std::string& dir) {
+    std::error_code ec;
+    std::string base = dir.empty() ? std::filesystem::temp_directory_path(ec).string() : dir;
+    if (base.empty())
+        base = "/tmp";
+    std::string path = base + "/database_armory_spill_XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+
+    int fd = ::mkstemp(name.data());
+    if (fd < 0)
+        return nullptr;
+    ::unlink(name.data());
+    return std::shared_ptr<SpillFile>(new SpillFile(fd));
+}
+
+SpillFile::~SpillFile() {
+    if (map_)
+        ::munmap(map_, capacity_);
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+bool SpillFile::reserve(uint64_t capacity) {
+    if (capacity <= capacity_)
+        return true;
+    uint64_t grown = capacity_ ? capacity_ : kInitialCapacity;
+    while (grown < capacity) grown *= 2;
+
+    // Allocate the blocks now: a store into a mapped hole on a full disk raises SIGBUS
+    if (::posix_fallocate(fd_, static_cast<off_t>(capacity_),
+                          static_cast<off_t>(grown - capacity_)) != 0)
+        return false;
+    void* map = ::mmap(nullptr, grown, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED)
+        return false;
+    if (map_)
+        ::munmap(map_, capacity_);
+    map_ = static_cast<char*>(map);
+    capacity_ = grown;
+    return true;
+}
+
+uint64_t SpillFile::append(const void* bytes, size_t n) {
+    if (!reserve(size_ + n))
+        return UINT64_MAX;
+    uint64_t at = size_;
+    std::memcpy(map_ + at, bytes, n);
+    size_ += n;
+    return at;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Append-only temporary file mapped into memory, used by QueryResult to hold rows beyond its
+// in-memory budget. The file is unlinked as soon as it is created, so it disappears with the
+// last descriptor even if the process dies. Pointers from data() are invalidated by append().
+class SpillFile {
+  public:
+    // Creates the file in dir (system temp directory when empty); nullptr on failure
+    static std::shared_ptr<SpillFile> create(const std::string& dir);
+    ~SpillFile();
+
+    // Returns the offset the bytes were written at, or UINT64_MAX when the file cannot grow,
+    // a full disk included: the file's blocks are allocated before they are mapped
+    uint64_t append(const void* bytes, size_t n);
+    // Drops everything from size onwards; used to rewrite the last row in place
+    void truncate(uint64_t size) {
+        if (size < size_)
+            size_ = size;
+    }
+
+    const char* data() const { return map_; }
+    uint64_t size() const { return size_; }
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+  private:
+    explicit SpillFile(int fd) : fd_(fd) {}
+    bool reserve(uint64_t capacity);
+
+    int fd_ = -1;
+    char* map_ = nullptr;
+    uint64_t size_ = 0;
+    uint64_t capacity_ = 0;
+};
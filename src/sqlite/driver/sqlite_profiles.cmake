@@ -0,0 +1,36 @@
+# Compile options of the SQLite amalgamation, picked with -DDATABASE_ARMORY_SQLITE_PROFILE=<name>
+#   default  serialized threading, the options the library has always been built with
+#   perf     the throughput options recommended in https://sqlite.org/compile.html, in
+#            multi-thread mode: the library never uses one connection from two threads at
+#            once (readers are lent to one caller, the writer sits behind write_mutex_ or
+#            the writer thread), so SQLite's per-connection mutexes only cost time
+set(DATABASE_ARMORY_SQLITE_PROFILE "default" CACHE STRING "SQLite compile profile: default or perf")
+set_property(CACHE DATABASE_ARMORY_SQLITE_PROFILE PROPERTY STRINGS default perf)
+
+function(sqlite_profile_definitions profile out)
+    set(common
+        SQLITE_ENABLE_JSON1
+        SQLITE_ENABLE_FTS5
+        SQLITE_OMIT_LOAD_EXTENSION
+    )
+    if(profile STREQUAL "default")
+        set(${out} SQLITE_THREADSAFE=1 ${common} PARENT_SCOPE)
+    elseif(profile STREQUAL "perf")
+        set(${out}
+            SQLITE_THREADSAFE=2
+            ${common}
+            SQLITE_DEFAULT_MEMSTATUS=0
+            SQLITE_DEFAULT_WAL_SYNCHRONOUS=1
+            SQLITE_LIKE_DOESNT_MATCH_BLOBS
+            SQLITE_MAX_EXPR_DEPTH=0
+            SQLITE_OMIT_DEPRECATED
+            SQLITE_OMIT_SHARED_CACHE
+            SQLITE_USE_ALLOCA
+            SQLITE_ENABLE_STAT4
+            PARENT_SCOPE
+        )
+    else()
+        message(FATAL_ERROR
+                "Unknown DATABASE_ARMORY_SQLITE_PROFILE '${profile}', expected default or perf")
+    endif()
+endfunction()
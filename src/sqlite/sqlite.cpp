@@ -1,126 +1,664 @@
-#include "sqlite.h"
-
-#include <iostream>
-#include <stdexcept>
-#include <utility>
-
-SQLite::SQLite(ConnectionConfig cfg, ILogger* logger)
-    : IDatabase(std::move(cfg), std::move(logger)) {}
-
-SQLite::~SQLite() {
-    close();
-}
-
-bool SQLite::open() {
-    if (is_open()){
-        logger_->info("SQLite database already opened.");
-        return true;
-    }
-    logger_->info(fmt::format("Trying to open SQLite database at path: {}", config_.path));
-   
-
-
-
-    // config.path should contain the SQLite DB file path
-    int rc = sqlite3_open(config_.path.c_str(), &db_);
-    if (rc != SQLITE_OK) {
-        // std::cerr << "Cannot open SQLite database: " << sqlite3_errmsg(db_) << std::endl;
-        logger_->error(fmt::format("Cannot open SQLite database: {}", sqlite3_errmsg(db_)));
-        close();
-        return false;
-    }
-    logger_->info("SQLite database opened successfully.");
-    return true;
-}
-
-void SQLite::close() {
-    if (db_) {
-        logger_->info("Closing SQLite database connection.");
-        sqlite3_close(db_);
-        db_ = nullptr;
-    }
-}
-
-bool SQLite::is_open() const {
-    return db_ != nullptr;
-}
-
-bool SQLite::insert(const QueryBuilder& qb) {
-    logger_->info(fmt::format("Executing INSERT: {}", qb.str()));
-    return executeQuery(qb, false);
-}
-
-QueryResult SQLite::select(const QueryBuilder& qb) {
-    logger_->info(fmt::format("Executing SELECT: {}", qb.str()));
-    QueryResult result;
-    executeQuery(qb, true, &result);
-    return result;
-}
-
-bool SQLite::update(const QueryBuilder& qb) {
-    logger_->info(fmt::format("Executing UPDATE: {}", qb.str()));
-    return executeQuery(qb, false);
-}
-
-bool SQLite::remove(const QueryBuilder& qb) {
-    logger_->info(fmt::format("Executing DELETE: {}", qb.str()));
-    return executeQuery(qb, false);
-}
-
-bool SQLite::executeQuery(const QueryBuilder& qb, bool returnsData, QueryResult* result) {
-    if (!is_open() && !open()) {
-        return false;
-    }
-
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare_v2(db_, qb.str().c_str(), -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        // std::cerr << "SQL error (prepare): " << sqlite3_errmsg(db_) << std::endl;
-        logger_->error(fmt::format("SQL error (prepare): {}", sqlite3_errmsg(db_)));
-        return false;
-    }
-
-    if (returnsData) {
-        // Fetch column names
-        int colCount = sqlite3_column_count(stmt);
-        std::vector<std::string> columns;
-        for (int i = 0; i < colCount; ++i) {
-            const char* name = sqlite3_column_name(stmt, i);
-            columns.emplace_back(name ? name : "");
-        }
-
-        // Fetch rows
-        QueryResult::Table table;
-        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-            QueryResult::Row row;
-            for (int i = 0; i < colCount; ++i) {
-                const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
-                row.emplace_back(text ? text : "");
-            }
-            table.push_back(std::move(row));
-        }
-
-        if (rc != SQLITE_DONE) {
-            // std::cerr << "SQL error (step): " << sqlite3_errmsg(db_) << std::endl;
-            logger_->error(fmt::format("SQL error (step): {}", sqlite3_errmsg(db_)));
-            sqlite3_finalize(stmt);
-            return false;
-        }
-
-        *result = QueryResult(std::move(table), std::move(columns));
-    } else {
-        // Non-SELECT query
-        rc = sqlite3_step(stmt);
-        if (rc != SQLITE_DONE) {
-            std::cerr << "SQL error (step): " << sqlite3_errmsg(db_) << std::endl;
-            sqlite3_finalize(stmt);
-            return false;
-        }
-    }
-
-    sqlite3_finalize(stmt);
-
-    logger_->info("SQLite query executed successfully.");
-
-    return true;
-}
+#include "sqlite.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    // Column affinity rules from https://www.sqlite.org/datatype3.html
+    std::optional<ColumnType> declaredType(const char* decl) {
+        if (!decl || !*decl)
+            return std::nullopt;
+        std::string t(decl);
+        for (auto& c : t) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        if (t.find("INT") != std::string::npos)
+            return ColumnType::Int64;
+        if (t.find("CHAR") != std::string::npos || t.find("CLOB") != std::string::npos ||
+            t.find("TEXT") != std::string::npos)
+            return ColumnType::Text;
+        if (t.find("BLOB") != std::string::npos)
+            return ColumnType::Blob;
+        if (t.find("REAL") != std::string::npos || t.find("FLOA") != std::string::npos ||
+            t.find("DOUB") != std::string::npos)
+            return ColumnType::Double;
+        if (t.find("BOOL") != std::string::npos)
+            return ColumnType::Bool;
+        return ColumnType::Text;
+    }
+
+    ColumnType storageType(int type) {
+        switch (type) {
+            case SQLITE_INTEGER:
+                return ColumnType::Int64;
+            case SQLITE_FLOAT:
+                return ColumnType::Double;
+            case SQLITE_BLOB:
+                return ColumnType::Blob;
+            default:
+                return ColumnType::Text;
+        }
+    }
+
+    // VM instructions between two checks of the deadline and cancellation token
+    constexpr int kProgressOps = 1000;
+
+    // Stops the running statement on conn through the progress handler once qb's deadline
+    // passes or its token is cancelled; the statement then fails with SQLITE_INTERRUPT
+    class Interrupter {
+      public:
+        Interrupter(sqlite3* conn, const QueryBuilder& qb,
+                    std::chrono::steady_clock::time_point start) {
+            if (!qb.getTimeout() && !qb.getCancellation())
+                return;
+            conn_ = conn;
+            if (qb.getCancellation())
+                token_ = &*qb.getCancellation();
+            if (qb.getTimeout())
+                deadline_ = start + *qb.getTimeout();
+            sqlite3_progress_handler(conn_, kProgressOps, &Interrupter::check, this);
+        }
+        ~Interrupter() {
+            if (conn_)
+                sqlite3_progress_handler(conn_, 0, nullptr, nullptr);
+        }
+
+        // Cancelled or TimedOut when the handler stopped the statement, Failed otherwise
+        QueryStatus failure() const { return reason_; }
+
+      private:
+        static int check(void* self) {
+            auto* in = static_cast<Interrupter*>(self);
+            if (in->token_ && in->token_->cancelled())
+                in->reason_ = QueryStatus::Cancelled;
+            else if (in->deadline_ && std::chrono::steady_clock::now() >= *in->deadline_)
+                in->reason_ = QueryStatus::TimedOut;
+            else
+                return 0;
+            return 1;
+        }
+
+        sqlite3* conn_ = nullptr;
+        const CancellationToken* token_ = nullptr;
+        std::optional<std::chrono::steady_clock::time_point> deadline_;
+        QueryStatus reason_ = QueryStatus::Failed;
+    };
+}  // namespace
+
+SQLite::SQLite(ConnectionConfig cfg, ILogger* logger)
+    : IDatabase(std::move(cfg), std::move(logger)) {}
+
+SQLite::~SQLite() {
+    close();
+}
+
+bool SQLite::open() {
+    if (config_.lazy_connect && !is_open()) {
+        logger_->info("SQLite open deferred to the first query.");
+        connect_pending_ = true;
+        return true;
+    }
+    return connect();
+}
+
+bool SQLite::connect() {
+    std::lock_guard<std::mutex> lock(open_mutex_);
+    if (is_open()){
+        logger_->info("SQLite database already opened.");
+        return true;
+    }
+    logger_->info(fmt::format("Trying to open SQLite database at path: {}", config_.path));
+   
+
+
+
+    // config.path should contain the SQLite DB file path
+    sqlite3* conn = nullptr;
+    int rc = sqlite3_open(config_.path.c_str(), &conn);
+    if (rc != SQLITE_OK) {
+        // std::cerr << "Cannot open SQLite database: " << sqlite3_errmsg(db_) << std::endl;
+        logger_->error(fmt::format("Cannot open SQLite database: {}", sqlite3_errmsg(conn)));
+        sqlite3_close(conn);
+        return false;
+    }
+    std::vector<sqlite3*> readers;
+    if (config_.sqlite_readers > 0 && !openReaders(conn, readers)) {
+        for (sqlite3* reader : readers) sqlite3_close(reader);
+        sqlite3_close(conn);
+        return false;
+    }
+    sqlite3_update_hook(conn, &SQLite::onUpdate, this);
+    sqlite3_commit_hook(conn, &SQLite::onCommit, this);
+    sqlite3_rollback_hook(conn, &SQLite::onRollback, this);
+    if (config_.sqlite_writer_thread) {
+        writer_ = std::make_unique<SQLiteWriter>(conn, logger_, 256,
+                                                 [this] { publishChanges(); });
+    }
+    {
+        std::lock_guard<std::mutex> readers_lock(readers_mutex_);
+        readers_ = readers;
+        idle_readers_ = std::move(readers);
+    }
+    db_ = conn;
+    open_.store(true, std::memory_order_release);
+    logger_->info("SQLite database opened successfully.");
+    connect_pending_ = false;
+    for (const auto& sql : deferred_prepares_) compileEverywhere(sql);
+    deferred_prepares_.clear();
+    return true;
+}
+
+bool SQLite::prepare(const QueryBuilder& qb) {
+    {
+        std::lock_guard<std::mutex> lock(open_mutex_);
+        if (!is_open() && connect_pending_) {
+            deferred_prepares_.push_back(qb.str());
+            return true;
+        }
+    }
+    if (!is_open()) {
+        logger_->error("Cannot prepare: SQLite database not open.");
+        return false;
+    }
+    return compileEverywhere(qb.str());
+}
+
+bool SQLite::compileEverywhere(const std::string& sql) {
+    auto compile = [this, &sql](sqlite3* conn) {
+        sqlite3_stmt* stmt = nullptr;
+        int rc = sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr);
+        if (rc != SQLITE_OK)
+            logger_->error(fmt::format("SQL error (prepare): {}", sqlite3_errmsg(conn)));
+        sqlite3_finalize(stmt);
+        return rc == SQLITE_OK;
+    };
+
+    std::lock_guard<std::mutex> lock(compile_mutex_);
+    bool ok;
+    if (writer_) {
+        ok = writer_->submit(compile, false).get();
+    } else {
+        std::lock_guard<std::mutex> write_lock(write_mutex_);
+        ok = compile(db_);
+    }
+    // Take every reader so each one has compiled it once
+    std::vector<sqlite3*> taken;
+    for (size_t i = 0; i < readers_.size(); ++i) taken.push_back(acquireReader());
+    for (sqlite3* conn : taken) {
+        ok = compile(conn) && ok;
+        releaseReader(conn);
+    }
+    return ok;
+}
+
+bool SQLite::openReaders(sqlite3* writer, std::vector<sqlite3*>& readers) {
+    if (config_.path.empty() || config_.path == ":memory:") {
+        logger_->info("SQLite in-memory database cannot be shared, readers disabled.");
+        return true;
+    }
+
+    // WAL lets readers run concurrently with the single writer
+    char* err = nullptr;
+    if (sqlite3_exec(writer, "PRAGMA journal_mode=WAL;", nullptr, nullptr, &err) != SQLITE_OK) {
+        logger_->error(fmt::format("Cannot enable WAL mode: {}", err ? err : "unknown error"));
+        sqlite3_free(err);
+        return false;
+    }
+
+    for (int i = 0; i < config_.sqlite_readers; ++i) {
+        sqlite3* conn = nullptr;
+        int rc = sqlite3_open_v2(config_.path.c_str(), &conn,
+                                 SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+        if (rc != SQLITE_OK) {
+            logger_->error(fmt::format("Cannot open SQLite reader: {}", sqlite3_errmsg(conn)));
+            sqlite3_close(conn);
+            return false;
+        }
+        sqlite3_busy_timeout(conn, 5000);
+        readers.push_back(conn);
+    }
+    logger_->info(fmt::format("Opened {} SQLite reader connections.", readers.size()));
+    return true;
+}
+
+sqlite3* SQLite::acquireReader() {
+    std::unique_lock<std::mutex> lock(readers_mutex_);
+    readers_cv_.wait(lock, [this] { return !idle_readers_.empty(); });
+    sqlite3* conn = idle_readers_.back();
+    idle_readers_.pop_back();
+    return conn;
+}
+
+void SQLite::releaseReader(sqlite3* conn) {
+    {
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        idle_readers_.push_back(conn);
+    }
+    readers_cv_.notify_one();
+}
+
+void SQLite::close() {
+    std::lock_guard<std::mutex> open_lock(open_mutex_);
+    open_ = false;
+    connect_pending_ = false;
+    writer_.reset();  // drains queued writes before the connection goes away
+    {
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        for (sqlite3* conn : readers_) sqlite3_close(conn);
+        readers_.clear();
+        idle_readers_.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(changes_mutex_);
+        pending_changes_.clear();
+    }
+    if (db_) {
+        logger_->info("Closing SQLite database connection.");
+        sqlite3_close(db_);
+        db_ = nullptr;
+    }
+}
+
+bool SQLite::is_open() const {
+    return open_.load(std::memory_order_acquire);
+}
+
+bool SQLite::insert(const QueryBuilder& qb) {
+    logger_->info(fmt::format("Executing INSERT: {}", qb.str()));
+    return executeQuery(qb, nullptr);
+}
+
+std::future<bool> SQLite::insert_async(const QueryBuilder& qb) {
+    logger_->info(fmt::format("Queueing INSERT: {}", qb.str()));
+    return submitWrite(qb);
+}
+
+std::future<bool> SQLite::update_async(const QueryBuilder& qb) {
+    logger_->info(fmt::format("Queueing UPDATE: {}", qb.str()));
+    return submitWrite(qb);
+}
+
+std::future<bool> SQLite::remove_async(const QueryBuilder& qb) {
+    logger_->info(fmt::format("Queueing DELETE: {}", qb.str()));
+    return submitWrite(qb);
+}
+
+std::future<bool> SQLite::submitWrite(const QueryBuilder& qb) {
+    if (!writer_) {
+        std::promise<bool> done;
+        done.set_value(executeQuery(qb, nullptr));
+        return done.get_future();
+    }
+    return writer_->submit(
+        [this, qb](sqlite3* conn) { return executeQuery(conn, qb, nullptr); });
+}
+
+std::optional<size_t> SQLite::upsert(const QueryBuilder& qb) {
+    logger_->info(fmt::format("Executing UPSERT: {}", qb.str()));
+    size_t changed = 0;
+    if (!executeQuery(qb, nullptr, &changed))
+        return std::nullopt;
+    return changed;
+}
+
+QueryResult SQLite::select(const QueryBuilder& qb) {
+    logger_->info(fmt::format("Executing SELECT: {}", qb.str()));
+    ResultCollector collector({config_.result_memory_limit, config_.spill_dir});
+    if (!readQuery(qb, collector)) {
+        if (collector.result().spill_error())
+            logger_->error(fmt::format("SELECT failed, its spill file cannot grow: {}", qb.str()));
+        else if (collector.result().rejected())
+            logger_->error(fmt::format("SELECT rejected, process memory over its soft limit: {}",
+                                       qb.str()));
+        return QueryResult();
+    }
+    return collector.take();
+}
+
+bool SQLite::stream(const QueryBuilder& qb, IRowSink& sink) {
+    logger_->info(fmt::format("Streaming SELECT: {}", qb.str()));
+    return readQuery(qb, sink);
+}
+
+bool SQLite::readQuery(const QueryBuilder& qb, IRowSink& sink) {
+    if (!is_open() && !connect()) {
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+    // readers_ is fixed from the moment is_open() turns true until close()
+    if (readers_.empty())
+        return executeQuery(qb, &sink);
+
+    sqlite3* conn = acquireReader();
+    bool ok = executeQuery(conn, qb, &sink);
+    releaseReader(conn);
+    return ok;
+}
+
+bool SQLite::update(const QueryBuilder& qb) {
+    logger_->info(fmt::format("Executing UPDATE: {}", qb.str()));
+    return executeQuery(qb, nullptr);
+}
+
+bool SQLite::remove(const QueryBuilder& qb) {
+    logger_->info(fmt::format("Executing DELETE: {}", qb.str()));
+    return executeQuery(qb, nullptr);
+}
+
+bool SQLite::executeQuery(const QueryBuilder& qb, IRowSink* sink, size_t* changed) {
+    if (!is_open() && !connect()) {
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+
+    if (writer_) {
+        // Writes join the writer's batch transaction, reads run outside of it. The status is
+        // thread-local, so it is carried back from the writer thread.
+        QueryStatus status = QueryStatus::Failed;
+        auto job = [&](sqlite3* conn) {
+            bool done = executeQuery(conn, qb, sink, changed);
+            status = lastStatus();
+            return done;
+        };
+        bool ok = writer_->submit(job, sink == nullptr).get();
+        // A job that succeeded can still fail with its batch's COMMIT
+        setStatus(ok ? QueryStatus::Ok : status == QueryStatus::Ok ? QueryStatus::Failed : status);
+        return ok;
+    }
+
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        ok = executeQuery(db_, qb, sink, changed);
+    }
+    if (!sink)
+        publishChanges();
+    return ok;
+}
+
+bool SQLite::executeQuery(sqlite3* conn, const QueryBuilder& qb, IRowSink* sink,
+                          size_t* changed) {
+    if (!sink) {
+        auto maxParams = sqlite3_limit(conn, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+        std::vector<QueryBuilder> chunks = qb.split(static_cast<size_t>(maxParams));
+        if (chunks.size() > 1)
+            return executeChunks(conn, chunks, changed);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (qb.getCancellation() && qb.getCancellation()->cancelled()) {
+        setStatus(QueryStatus::Cancelled);
+        return false;
+    }
+    setStatus(QueryStatus::Failed);  // until the statement has run
+    std::string sql = qb.str();
+    if (sql.empty()) {
+        logger_->error("SQL error: the query builder has no valid statement to run");
+        return false;
+    }
+    // A bare DELETE FROM t takes the truncate optimization, which skips the update hook
+    if (tracking_ && qb.getKind() == QueryBuilder::Kind::Delete && qb.getWheres().empty() &&
+        !qb.getSeekColumns())
+        sql += " WHERE 1";
+    const size_t mark = sink ? 0 : changeMark();
+    Interrupter interrupter(conn, qb, start);
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        // std::cerr << "SQL error (prepare): " << sqlite3_errmsg(conn) << std::endl;
+        logger_->error(fmt::format("SQL error (prepare): {}", sqlite3_errmsg(conn)));
+        return false;
+    }
+    // Finalized on every path, a sink that throws included
+    std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt*)> finalize(stmt, &sqlite3_finalize);
+    const QueryBuilder::Params params = qb.getParams();
+    if (!bindParams(conn, stmt, params))
+        return false;
+
+    size_t rows = 0;
+    if (sink) {
+        if (!fetchRows(conn, stmt, *sink, rows)) {
+            setStatus(interrupter.failure());
+            return false;
+        }
+    } else {
+        // Non-SELECT query
+        rc = sqlite3_step(stmt);
+        if (rc != SQLITE_DONE) {
+            std::cerr << "SQL error (step): " << sqlite3_errmsg(conn) << std::endl;
+            finalize.reset();
+            discardChangesSince(mark);
+            setStatus(interrupter.failure());
+            return false;
+        }
+        rows = static_cast<size_t>(sqlite3_changes(conn));
+        if (changed)
+            *changed += rows;
+    }
+
+    finalize.reset();
+    recordQuery(sql, params, start, rows);
+    setStatus(QueryStatus::Ok);
+
+    logger_->info("SQLite query executed successfully.");
+
+    return true;
+}
+
+// All chunks or none: a savepoint nests inside the writer thread's batch transaction too.
+// A timeout covers all chunks together.
+bool SQLite::executeChunks(sqlite3* conn, const std::vector<QueryBuilder>& chunks,
+                           size_t* changed) {
+    if (sqlite3_exec(conn, "SAVEPOINT armory_chunks", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        logger_->error(fmt::format("SQL error (savepoint): {}", sqlite3_errmsg(conn)));
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const size_t mark = changeMark();
+    size_t total = 0;
+    for (QueryBuilder chunk : chunks) {
+        if (auto limit = chunk.getTimeout()) {
+            auto spent = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+            chunk.timeout(std::max(*limit - spent, std::chrono::milliseconds(0)));
+        }
+        if (!executeQuery(conn, chunk, nullptr, &total)) {
+            discardChangesSince(mark);
+            sqlite3_exec(conn, "ROLLBACK TO armory_chunks; RELEASE armory_chunks", nullptr,
+                         nullptr, nullptr);
+            return false;
+        }
+    }
+    if (sqlite3_exec(conn, "RELEASE armory_chunks", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        setStatus(QueryStatus::Failed);
+        return false;
+    }
+    if (changed)
+        *changed += total;
+    return true;
+}
+
+bool SQLite::bindParams(sqlite3* conn, sqlite3_stmt* stmt, const QueryBuilder::Params& params) {
+    for (size_t i = 0; i < params.size(); ++i) {
+        const int index = static_cast<int>(i) + 1;
+        // Bound as text; column affinity still makes comparisons with INTEGER columns numeric
+        int rc = params[i] ? sqlite3_bind_text(stmt, index, params[i]->data(),
+                                               static_cast<int>(params[i]->size()),
+                                               SQLITE_TRANSIENT)
+                           : sqlite3_bind_null(stmt, index);
+        if (rc != SQLITE_OK) {
+            logger_->error(fmt::format("SQL error (bind): {}", sqlite3_errmsg(conn)));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SQLite::fetchRows(sqlite3* conn, sqlite3_stmt* stmt, IRowSink& sink, size_t& rows) {
+    // Fetch column names
+    int colCount = sqlite3_column_count(stmt);
+    std::vector<std::string> columns;
+    for (int i = 0; i < colCount; ++i) {
+        const char* name = sqlite3_column_name(stmt, i);
+        columns.emplace_back(name ? name : "");
+    }
+
+    // Declared column types; expressions take the storage class of their first value,
+    // so the sink is started only once the first row is available
+    std::vector<std::optional<ColumnType>> types(colCount);
+    for (int i = 0; i < colCount; ++i) types[i] = declaredType(sqlite3_column_decltype(stmt, i));
+
+    int rc = sqlite3_step(stmt);
+    std::vector<ColumnType> resolved;
+    for (int i = 0; i < colCount; ++i) {
+        if (!types[i] && rc == SQLITE_ROW)
+            types[i] = storageType(sqlite3_column_type(stmt, i));
+        resolved.push_back(types[i].value_or(ColumnType::Text));
+    }
+    if (!sink.begin(columns, resolved))
+        return false;
+
+    // Fetch rows, cells point into SQLite's buffers until the next step
+    IRowSink::Cells cells(colCount);
+    for (; rc == SQLITE_ROW; rc = sqlite3_step(stmt)) {
+        for (int i = 0; i < colCount; ++i) {
+            // Type must be read before sqlite3_column_text converts the value
+            if (sqlite3_column_type(stmt, i) == SQLITE_NULL) {
+                cells[i].reset();
+                continue;
+            }
+            const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+            size_t len = text ? static_cast<size_t>(sqlite3_column_bytes(stmt, i)) : 0;
+            cells[i] = std::string_view(text ? text : "", len);
+        }
+        if (!sink.row(cells))
+            return false;
+        ++rows;
+    }
+
+    if (rc != SQLITE_DONE) {
+        // std::cerr << "SQL error (step): " << sqlite3_errmsg(conn) << std::endl;
+        logger_->error(fmt::format("SQL error (step): {}", sqlite3_errmsg(conn)));
+        return false;
+    }
+    return sink.end();
+}
+
+SlowQueryLog::PlanFn SQLite::planCapture() const {
+    // A second connection to an in-memory database opens a new, empty one
+    if (config_.path.empty() || config_.path == ":memory:")
+        return nullptr;
+    std::string path = config_.path;
+    return [path](const std::string& sql, const SlowQueryLog::Params&) -> std::string {
+        sqlite3* conn = nullptr;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_open_v2(path.c_str(), &conn, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK ||
+            sqlite3_prepare_v2(conn, ("EXPLAIN QUERY PLAN " + sql).c_str(), -1, &stmt,
+                               nullptr) != SQLITE_OK) {
+            std::string error = std::string("EXPLAIN failed: ") + sqlite3_errmsg(conn);
+            sqlite3_close(conn);
+            return error;
+        }
+
+        // Rows are (id, parent, notused, detail); indent each step under its parent
+        std::string plan;
+        std::map<int, int> depth;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            int id = sqlite3_column_int(stmt, 0);
+            int parent = sqlite3_column_int(stmt, 1);
+            depth[id] = parent && depth.count(parent) ? depth[parent] + 1 : 0;
+            const unsigned char* detail = sqlite3_column_text(stmt, 3);
+            plan += std::string(depth[id] * 2, ' ');
+            plan += detail ? reinterpret_cast<const char*>(detail) : "";
+            plan += '\n';
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_close(conn);
+        return plan;
+    };
+}
+
+uint64_t SQLite::subscribe(ChangeFn fn) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    subscribers_[next_subscriber_] = std::move(fn);
+    tracking_ = true;
+    return next_subscriber_++;
+}
+
+void SQLite::unsubscribe(uint64_t id) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    subscribers_.erase(id);
+    tracking_ = !subscribers_.empty();
+}
+
+uint64_t SQLite::invalidates(ResultCache& cache) {
+    return subscribe([&cache](const std::vector<SQLiteChange>& changes) {
+        std::vector<std::string> tables;
+        for (const auto& change : changes)
+            if (std::find(tables.begin(), tables.end(), change.table) == tables.end())
+                tables.push_back(change.table);
+        for (const auto& table : tables) cache.invalidate(table);
+    });
+}
+
+// The hooks run inside sqlite3_step() on whichever thread holds db_, so they only queue
+void SQLite::onUpdate(void* self, int op, const char*, const char* table, sqlite3_int64 rowid) {
+    auto* db = static_cast<SQLite*>(self);
+    if (!db->tracking_)
+        return;
+    SQLiteChange::Op kind = op == SQLITE_INSERT   ? SQLiteChange::Op::Insert
+                            : op == SQLITE_DELETE ? SQLiteChange::Op::Delete
+                                                  : SQLiteChange::Op::Update;
+    std::lock_guard<std::mutex> lock(db->changes_mutex_);
+    db->pending_changes_.push_back(SQLiteChange{kind, table, static_cast<int64_t>(rowid)});
+}
+
+int SQLite::onCommit(void* self) {
+    auto* db = static_cast<SQLite*>(self);
+    std::lock_guard<std::mutex> lock(db->changes_mutex_);
+    if (!db->pending_changes_.empty())
+        db->committed_changes_.push_back(std::move(db->pending_changes_));
+    db->pending_changes_.clear();
+    return 0;  // non-zero would turn the COMMIT into a ROLLBACK
+}
+
+void SQLite::onRollback(void* self) {
+    auto* db = static_cast<SQLite*>(self);
+    std::lock_guard<std::mutex> lock(db->changes_mutex_);
+    db->pending_changes_.clear();
+}
+
+size_t SQLite::changeMark() {
+    std::lock_guard<std::mutex> lock(changes_mutex_);
+    return pending_changes_.size();
+}
+
+void SQLite::discardChangesSince(size_t mark) {
+    std::lock_guard<std::mutex> lock(changes_mutex_);
+    if (pending_changes_.size() > mark)
+        pending_changes_.resize(mark);
+}
+
+void SQLite::publishChanges() {
+    std::lock_guard<std::recursive_mutex> publishing(publish_mutex_);
+    for (;;) {
+        std::vector<SQLiteChange> changes;
+        {
+            std::lock_guard<std::mutex> lock(changes_mutex_);
+            if (committed_changes_.empty())
+                return;
+            changes = std::move(committed_changes_.front());
+            committed_changes_.pop_front();
+        }
+        std::vector<ChangeFn> subscribers;
+        {
+            std::lock_guard<std::mutex> lock(subscribers_mutex_);
+            for (const auto& [id, fn] : subscribers_) subscribers.push_back(fn);
+        }
+        for (const auto& fn : subscribers) fn(changes);
+    }
+}
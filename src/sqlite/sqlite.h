@@ -1,36 +1,132 @@
-#pragma once
-
-#include <memory>
-#include <string>
-#include <vector>
-
-#include "database.h"
-#include "driver/sqlite3.h"
-#include "spdlog/fmt/bundled/format.h"
-
-
-class SQLite : public IDatabase {
-  public:
-    explicit SQLite(ConnectionConfig cfg, ILogger* logger);
-    ~SQLite() override;
-  
-    bool open() override;
-    void close() override;
-    bool is_open() const override;
-
-    bool insert(const QueryBuilder& qb) override;
-    bool update(const QueryBuilder& qb) override;
-    bool remove(const QueryBuilder& qb) override;
-    QueryResult select(const QueryBuilder& qb) override;
-
-    SQLite(const SQLite&) = delete;
-    SQLite& operator=(const SQLite&) = delete;
-
-    // Movable
-    SQLite(SQLite&&) = default;
-    SQLite& operator=(SQLite&&) = default;
-
-  private:
-    sqlite3* db_ = nullptr;
-    bool executeQuery(const QueryBuilder& qb, bool returnsData, QueryResult* result = nullptr);
-};
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cache/result_cache.h"
+#include "database.h"
+#include "driver/sqlite3.h"
+#include "spdlog/fmt/bundled/format.h"
+#include "sqlite_writer.h"
+
+// One row written by a committed transaction, as reported by sqlite3_update_hook
+struct SQLiteChange {
+    enum class Op { Insert, Update, Delete };
+
+    Op op;
+    std::string table;
+    int64_t rowid;
+};
+
+class SQLite : public IDatabase {
+  public:
+    explicit SQLite(ConnectionConfig cfg, ILogger* logger);
+    ~SQLite() override;
+
+    bool open() override;
+    void close() override;
+    bool is_open() const override;
+
+    bool insert(const QueryBuilder& qb) override;
+    bool update(const QueryBuilder& qb) override;
+    bool remove(const QueryBuilder& qb) override;
+    QueryResult select(const QueryBuilder& qb) override;
+    bool stream(const QueryBuilder& qb, IRowSink& sink) override;
+    std::optional<size_t> upsert(const QueryBuilder& qb) override;
+    // Compiles qb once on the writer and on every reader, which loads the schema on each
+    // connection and reports bad SQL early. Statements are still compiled per call.
+    bool prepare(const QueryBuilder& qb) override;
+
+    // Queue a write; with sqlite_writer_thread the future completes after the batch commits
+    std::future<bool> insert_async(const QueryBuilder& qb);
+    std::future<bool> update_async(const QueryBuilder& qb);
+    std::future<bool> remove_async(const QueryBuilder& qb);
+
+    // Change stream: fn gets the rows of each committed transaction, in commit order, once the
+    // commit has returned. It runs on the committing thread (the writer thread with
+    // sqlite_writer_thread), so it must not wait for writes to this database. Rolled back
+    // statements are not reported, nor are WITHOUT ROWID tables (SQLite has no hook for them).
+    using ChangeFn = std::function<void(const std::vector<SQLiteChange>& changes)>;
+    uint64_t subscribe(ChangeFn fn);
+    void unsubscribe(uint64_t id);
+    // Subscribes cache.invalidate() for every table a committed transaction touched
+    uint64_t invalidates(ResultCache& cache);
+
+    // Non-copyable, non-movable: connections are shared between calling threads
+    SQLite(const SQLite&) = delete;
+    SQLite& operator=(const SQLite&) = delete;
+
+  protected:
+    // EXPLAIN QUERY PLAN through a fresh read-only connection to the same file; none for an
+    // in-memory database
+    SlowQueryLog::PlanFn planCapture() const override;
+
+  private:
+    // open() itself, or the first query after a lazy open(). The connections are opened into
+    // locals and published with open_ once db_, readers_ and writer_ are all in place, so a
+    // thread that sees is_open() never sees them half built.
+    bool connect();
+    // Serialized by compile_mutex_: two callers each holding some of the readers while waiting
+    // for the rest would deadlock
+    bool compileEverywhere(const std::string& sql);
+
+    std::mutex open_mutex_;
+    std::atomic<bool> open_{false};
+    std::atomic<bool> connect_pending_{false};
+    std::vector<std::string> deferred_prepares_;  // prepare() calls before a lazy connect
+    std::mutex compile_mutex_;
+
+    sqlite3* db_ = nullptr;  // writer connection
+    std::mutex write_mutex_;
+    std::unique_ptr<SQLiteWriter> writer_;  // owns db_ while running
+
+    // Read-only connections (WAL mode), each lent to one thread per select()
+    std::vector<sqlite3*> readers_;
+    std::vector<sqlite3*> idle_readers_;
+    std::mutex readers_mutex_;
+    std::condition_variable readers_cv_;
+
+    // Switches writer to WAL and opens config_.sqlite_readers connections into readers
+    bool openReaders(sqlite3* writer, std::vector<sqlite3*>& readers);
+    sqlite3* acquireReader();
+    void releaseReader(sqlite3* conn);
+
+    std::future<bool> submitWrite(const QueryBuilder& qb);
+    bool readQuery(const QueryBuilder& qb, IRowSink& sink);
+    // sink == nullptr for statements that return no rows; changed, when given, is increased by
+    // sqlite3_changes() of each statement
+    bool executeQuery(const QueryBuilder& qb, IRowSink* sink, size_t* changed = nullptr);
+    bool executeQuery(sqlite3* conn, const QueryBuilder& qb, IRowSink* sink,
+                      size_t* changed = nullptr);
+    bool executeChunks(sqlite3* conn, const std::vector<QueryBuilder>& chunks, size_t* changed);
+    bool bindParams(sqlite3* conn, sqlite3_stmt* stmt, const QueryBuilder::Params& params);
+    bool fetchRows(sqlite3* conn, sqlite3_stmt* stmt, IRowSink& sink, size_t& rows);
+
+    // Change tracking on db_: the update hook collects rows in pending_changes_, the commit
+    // hook moves them to committed_changes_ and publishChanges() hands those to subscribers
+    static void onUpdate(void* self, int op, const char* db, const char* table,
+                         sqlite3_int64 rowid);
+    static int onCommit(void* self);
+    static void onRollback(void* self);
+    size_t changeMark();
+    void discardChangesSince(size_t mark);  // after a failed statement or ROLLBACK TO
+    void publishChanges();
+
+    std::atomic<bool> tracking_{false};
+    std::mutex changes_mutex_;
+    std::vector<SQLiteChange> pending_changes_;
+    std::deque<std::vector<SQLiteChange>> committed_changes_;
+    std::recursive_mutex publish_mutex_;  // keeps deliveries in commit order
+    std::mutex subscribers_mutex_;
+    std::map<uint64_t, ChangeFn> subscribers_;
+    uint64_t next_subscriber_ = 0;
+};
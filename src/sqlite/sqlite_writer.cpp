@@ -0,0 +1,144 @@
+#include "sqlite_writer.h"
+
+#include <utility>
+#include <vector>
+
+#include "spdlog/fmt/bundled/format.h"
+
+SQLiteWriter::SQLiteWriter(sqlite3* conn, ILogger* logger, size_t max_batch,
+                           std::function<void()> after_batch)
+    : conn_(conn),
+      logger_(logger),
+      max_batch_(max_batch),
+      after_batch_(std::move(after_batch)),
+      thread_([this] { loop(); }) {}
+
+SQLiteWriter::~SQLiteWriter() {
+    stop();
+}
+
+std::future<bool> SQLiteWriter::submit(Job job, bool transactional) {
+    Request req{std::move(job), transactional, {}};
+    std::future<bool> fut = req.done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            req.done.set_value(false);
+            return fut;
+        }
+        queue_.push_back(std::move(req));
+    }
+    cv_.notify_one();
+    return fut;
+}
+
+void SQLiteWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void SQLiteWriter::loop() {
+    for (;;) {
+        std::deque<Request> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;  // stopping and fully drained
+            while (!queue_.empty() && batch.size() < max_batch_) {
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+        }
+
+        // Group runs of transactional jobs; everything else runs on its own
+        size_t i = 0;
+        while (i < batch.size()) {
+            if (!batch[i].transactional) {
+                complete(batch[i], run(batch[i]));
+                ++i;
+                continue;
+            }
+            size_t end = i;
+            while (end < batch.size() && batch[end].transactional) ++end;
+            runTransaction(batch, i, end);
+            i = end;
+        }
+        if (after_batch_)
+            after_batch_();
+    }
+}
+
+void SQLiteWriter::runTransaction(std::deque<Request>& batch, size_t begin, size_t end) {
+    if (begin == end)
+        return;
+    if (end - begin == 1) {
+        complete(batch[begin], run(batch[begin]));
+        return;
+    }
+
+    if (!exec("BEGIN IMMEDIATE")) {
+        for (size_t i = begin; i < end; ++i) batch[i].done.set_value(false);
+        return;
+    }
+
+    std::vector<Outcome> outcomes(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        exec("SAVEPOINT req");
+        Outcome& outcome = outcomes[i - begin];
+        outcome = run(batch[i]);
+        if (outcome.ok) {
+            exec("RELEASE req");
+            continue;
+        }
+        if (sqlite3_get_autocommit(conn_)) {
+            // SQLite rolled back the whole transaction (an interrupted write, SQLITE_FULL,
+            // SQLITE_IOERR, SQLITE_NOMEM): the jobs before this one are undone, the ones after
+            // it get a transaction of their own
+            logger_->error("SQLite writer batch rolled back by a failed statement");
+            for (size_t j = begin; j < i; ++j) outcomes[j - begin].ok = false;
+            for (size_t j = begin; j <= i; ++j) complete(batch[j], outcomes[j - begin]);
+            runTransaction(batch, i + 1, end);
+            return;
+        }
+        exec("ROLLBACK TO req");
+        exec("RELEASE req");
+    }
+
+    if (!exec("COMMIT")) {
+        exec("ROLLBACK");
+        for (auto& outcome : outcomes) outcome.ok = false;
+    }
+    for (size_t i = begin; i < end; ++i) complete(batch[i], outcomes[i - begin]);
+}
+
+SQLiteWriter::Outcome SQLiteWriter::run(Request& req) {
+    try {
+        return {req.job(conn_), nullptr};
+    } catch (...) {
+        logger_->error("SQLite writer job threw, failing its request");
+        return {false, std::current_exception()};
+    }
+}
+
+void SQLiteWriter::complete(Request& req, const Outcome& outcome) {
+    if (outcome.error)
+        req.done.set_exception(outcome.error);
+    else
+        req.done.set_value(outcome.ok);
+}
+
+bool SQLiteWriter::exec(const char* sql) {
+    char* err = nullptr;
+    if (sqlite3_exec(conn_, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        logger_->error(fmt::format("SQLite writer '{}' failed: {}", sql, err ? err : ""));
+        sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "driver/sqlite3.h"
+#include "log_armory/src/logger.h"
+
+// Single writer actor: one thread owns the write connection and drains a queue of jobs.
+// Consecutive transactional jobs are coalesced into one BEGIN IMMEDIATE ... COMMIT, each
+// wrapped in its own SAVEPOINT so a failing statement does not abort its neighbours.
+// Futures complete only after the surrounding transaction has committed. A job that throws
+// fails like one returning false, and its future rethrows the exception.
+class SQLiteWriter {
+  public:
+    using Job = std::function<bool(sqlite3*)>;
+
+    // after_batch runs on the writer thread once every job of a dequeued batch has completed
+    SQLiteWriter(sqlite3* conn, ILogger* logger, size_t max_batch = 256,
+                 std::function<void()> after_batch = nullptr);
+    ~SQLiteWriter();
+
+    std::future<bool> submit(Job job, bool transactional = true);
+    void stop();
+
+    SQLiteWriter(const SQLiteWriter&) = delete;
+    SQLiteWriter& operator=(const SQLiteWriter&) = delete;
+
+  private:
+    struct Request {
+        Job job;
+        bool transactional;
+        std::promise<bool> done;
+    };
+
+    struct Outcome {
+        bool ok = false;
+        std::exception_ptr error;
+    };
+
+    void loop();
+    Outcome run(Request& req);
+    static void complete(Request& req, const Outcome& outcome);
+    void runTransaction(std::deque<Request>& batch, size_t begin, size_t end);
+    bool exec(const char* sql);
+
+    sqlite3* conn_;
+    ILogger* logger_;
+    size_t max_batch_;
+    std::function<void()> after_batch_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Request> queue_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
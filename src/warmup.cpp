@@ -0,0 +1,36 @@
+#include "warmup.h"
+
+#include <algorithm>
+#include <future>
+
+bool WarmupReport::ready() const {
+    return std::all_of(databases.begin(), databases.end(),
+                       [](const Database& db) { return db.opened && db.failed == 0; });
+}
+
+WarmupReport warmUp(const std::vector<IDatabase*>& databases,
+                    const std::vector<QueryBuilder>& statements) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+
+    std::vector<std::future<WarmupReport::Database>> pending;
+    for (IDatabase* db : databases) {
+        pending.push_back(std::async(std::launch::async, [db, &statements] {
+            const auto begin = Clock::now();
+            WarmupReport::Database entry;
+            entry.opened = db->open();
+            if (entry.opened)
+                for (const auto& qb : statements)
+                    ++(db->prepare(qb) ? entry.prepared : entry.failed);
+            entry.connected = db->is_open();
+            entry.elapsed =
+                std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin);
+            return entry;
+        }));
+    }
+
+    WarmupReport report;
+    for (auto& f : pending) report.databases.push_back(f.get());
+    report.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+    return report;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "database.h"
+
+// Readiness of the databases passed to warmUp(), in the same order
+struct WarmupReport {
+    struct Database {
+        bool opened = false;       // open() succeeded
+        bool connected = false;    // is_open() afterwards; false while a lazy_connect waits
+        size_t prepared = 0;       // statements accepted by prepare()
+        size_t failed = 0;         // statements rejected by prepare()
+        std::chrono::milliseconds elapsed{0};
+    };
+
+    std::vector<Database> databases;
+    std::chrono::milliseconds elapsed{0};  // wall time of the whole warm-up
+
+    // Every database opened and took every statement
+    bool ready() const;
+};
+
+// Opens every database on its own thread, so connection setup (TLS, auth) overlaps instead of
+// adding up, then prepares statements on each. Each database is touched by one thread only.
+// Databases configured with lazy_connect return at once and prepare on their first query.
+WarmupReport warmUp(const std::vector<IDatabase*>& databases,
+                    const std::vector<QueryBuilder>& statements = {});
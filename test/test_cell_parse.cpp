@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cell_parse.h"
+#include "query_result.h"
+
+namespace {
+    using namespace std::chrono;
+
+    template <typename T>
+    bool reference(const std::string& text, T& value) {
+        const char* end = text.data() + text.size();
+        auto [ptr, ec] = std::from_chars(text.data(), end, value);
+        return !text.empty() && ec == std::errc() && ptr == end;
+    }
+
+    void expectSameInt(const std::string& text) {
+        int64_t fast = 0, slow = 0;
+        bool ok = reference(text, slow);
+        EXPECT_EQ(parseInt64(text, fast), ok) << text;
+        if (ok) {
+            EXPECT_EQ(fast, slow) << text;
+        }
+    }
+
+    void expectSameDouble(const std::string& text) {
+        double fast = 0, slow = 0;
+        bool ok = reference(text, slow);
+        EXPECT_EQ(parseDouble(text, fast), ok) << text;
+        if (ok && !std::isnan(slow)) {
+            EXPECT_EQ(std::memcmp(&fast, &slow, sizeof(double)), 0) << text;
+        }
+    }
+
+    CellTime at(int y, unsigned mo, unsigned d, int h = 0, int mi = 0, int s = 0, int us = 0) {
+        return time_point_cast<microseconds>(sys_days{year{y} / mo / d}) + hours{h} +
+               minutes{mi} + seconds{s} + microseconds{us};
+    }
+}  // namespace
+
+TEST(CellParseTest, IntegersMatchFromChars) {
+    for (const char* text :
+         {"0", "-0", "7", "12345678", "-123456789", "1234567890123456", "123456789012345678",
+          "9223372036854775807", "-9223372036854775808", "9223372036854775808",
+          "-9223372036854775809", "99999999999999999999", "0000000000000000000000042", "",
+          "-", "+1", "12a", " 1", "1 ", "1.0", "1234567a9", "--1"})
+        expectSameInt(text);
+
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 10000; ++i) {
+        auto value = static_cast<int64_t>(rng()) >> (rng() % 64);
+        expectSameInt(std::to_string(value));
+    }
+}
+
+TEST(CellParseTest, DoublesMatchFromChars) {
+    for (const char* text :
+         {"0", "-0", "0.0", "-0.0", "1.5", "0.1", "3.14159265358979", "123456789.123456789",
+          "9007199254740993", "9007199254740992.5", "1e10", "-2.5E-3", ".5", "5.", "nan",
+          "inf", "-Infinity", "", "-", "1.2.3", "1,5", "12345678.1234567x",
+          "0.0000000000000000000001", "100000000000000000000"})
+        expectSameDouble(text);
+
+    std::mt19937_64 rng(11);
+    for (int i = 0; i < 20000; ++i) {
+        std::string text = rng() % 2 ? "-" : "";
+        text += std::to_string(rng() % (uint64_t{1} << (rng() % 60)));
+        if (rng() % 4) {
+            std::string fraction = std::to_string(rng() % 100000000000);
+            text += "." + fraction.substr(0, 1 + rng() % fraction.size());
+        }
+        expectSameDouble(text);
+    }
+}
+
+TEST(CellParseTest, Timestamps) {
+    CellTime t;
+    ASSERT_TRUE(parseTimestamp("2024-02-29", t));
+    EXPECT_EQ(t, at(2024, 2, 29));
+    ASSERT_TRUE(parseTimestamp("2024-01-02 03:04:05", t));
+    EXPECT_EQ(t, at(2024, 1, 2, 3, 4, 5));
+    ASSERT_TRUE(parseTimestamp("2024-01-02T03:04:05.25Z", t));
+    EXPECT_EQ(t, at(2024, 1, 2, 3, 4, 5, 250000));
+    ASSERT_TRUE(parseTimestamp("2024-01-02 03:04:05.123456789+05:30", t));
+    EXPECT_EQ(t, at(2024, 1, 1, 21, 34, 5, 123456));
+    ASSERT_TRUE(parseTimestamp("1969-12-31 23:00:00-01", t));
+    EXPECT_EQ(t, at(1970, 1, 1));
+
+    for (const char* text : {"", "2023-02-29", "2024-13-01", "2024-01-02 24:00:00",
+                             "2024-01-02 03:04", "2024-01-02 03:04:05.", "2024-01-02 03:04:05 BC",
+                             "2024-1-02", "2024-01-02 03:04:05+5"})
+        EXPECT_FALSE(parseTimestamp(text, t)) << text;
+}
+
+TEST(CellParseTest, QueryResultTypedColumns) {
+    QueryResult result({}, {"id", "price", "at"});
+    const size_t n = 3000;  // several parse batches
+    for (size_t r = 0; r < n; ++r) {
+        if (r % 7 == 0) {
+            result.append_cells({std::nullopt, std::nullopt, std::nullopt});
+            continue;
+        }
+        result.append_row({std::to_string(r * 1000003), std::to_string(r) + ".25",
+                           "2024-01-01 00:00:" + std::to_string(10 + r % 50)});
+    }
+    result.append_row({"x", "y", "z"});
+
+    EXPECT_EQ(result.as_int64(1, 0), int64_t{1000003});
+    EXPECT_EQ(result.as_double(1, 1), 1.25);
+    EXPECT_EQ(result.as_timestamp(1, 2), at(2024, 1, 1, 0, 0, 11));
+    EXPECT_FALSE(result.as_int64(0, 0));
+    EXPECT_FALSE(result.as_int64(n, 0));
+    EXPECT_FALSE(result.as_int64(n + 1, 0));
+
+    auto ids = result.int64_column(0);
+    auto prices = result.double_column(1);
+    auto times = result.timestamp_column(2);
+    ASSERT_EQ(ids.values.size(), n + 1);
+    ASSERT_EQ(times.valid.size(), n + 1);
+    for (size_t r = 0; r < n; ++r) {
+        ASSERT_EQ(ids.valid[r], r % 7 != 0) << r;
+        EXPECT_EQ(ids.values[r], r % 7 ? static_cast<int64_t>(r * 1000003) : 0);
+        EXPECT_EQ(prices.values[r], r % 7 ? r + 0.25 : 0);
+        EXPECT_EQ(times.valid[r], ids.valid[r]);
+    }
+    EXPECT_FALSE(ids.valid[n] || prices.valid[n] || times.valid[n]);
+}
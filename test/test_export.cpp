@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "export/arrow_ipc.h"
+#include "export/text_writer.h"
+
+namespace {
+    QueryResult sampleResult() {
+        QueryResult r({}, {"id", "name", "score"});
+        r.set_column_types({ColumnType::Int64, ColumnType::Text, ColumnType::Double});
+        for (int i = 0; i < 5; ++i)
+            r.append_row({std::to_string(i), "name" + std::to_string(i), std::to_string(i * 0.5)});
+        r.set_null(2, 1);
+        return r;
+    }
+
+    uint32_t readU32(const std::string& s, size_t at) {
+        uint32_t v = 0;
+        std::memcpy(&v, s.data() + at, 4);
+        return v;
+    }
+}  // namespace
+
+TEST(ArrowIpcTest, StreamHasSchemaBatchesAndEndMarker) {
+    std::ostringstream out;
+    write_arrow_ipc(sampleResult(), out, 2);
+    std::string bytes = out.str();
+
+    // Walk the encapsulated messages: 0xFFFFFFFF, metadata length, metadata, body
+    size_t at = 0, messages = 0;
+    while (at + 8 <= bytes.size()) {
+        ASSERT_EQ(readU32(bytes, at), 0xFFFFFFFFu);
+        uint32_t len = readU32(bytes, at + 4);
+        if (len == 0)
+            break;  // end-of-stream
+        EXPECT_EQ(len % 8, 0u);
+        // Message.bodyLength is the last 8-byte field of the root table
+        uint32_t root = readU32(bytes, at + 8);
+        int32_t vtableOffset = 0;
+        std::memcpy(&vtableOffset, bytes.data() + at + 8 + root, 4);
+        const char* vtable = bytes.data() + at + 8 + root - vtableOffset;
+        uint16_t bodyField = 0;
+        std::memcpy(&bodyField, vtable + 4 + 2 * 3, 2);
+        int64_t body = 0;
+        std::memcpy(&body, bytes.data() + at + 8 + root + bodyField, 8);
+        EXPECT_EQ(body % 8, 0);
+        at += 8 + len + static_cast<size_t>(body);
+        ++messages;
+    }
+    EXPECT_EQ(at + 8, bytes.size());
+    EXPECT_EQ(messages, 1u + 3u);  // schema + ceil(5 / 2) batches
+}
+
+TEST(ArrowIpcTest, EmptyResultWritesSchemaOnly) {
+    std::ostringstream out;
+    write_arrow_ipc(QueryResult({}, {"x"}), out);
+    std::string bytes = out.str();
+    ASSERT_GE(bytes.size(), 16u);
+    EXPECT_EQ(readU32(bytes, bytes.size() - 8), 0xFFFFFFFFu);
+    EXPECT_EQ(readU32(bytes, bytes.size() - 4), 0u);
+}
+
+TEST(ArrowIpcTest, PartlyNumericCellsAreNull) {
+    // SQLite keeps 1.5 as REAL in an INTEGER column; a prefix parse would export 1
+    QueryResult loose({}, {"id", "score"});
+    loose.set_column_types({ColumnType::Int64, ColumnType::Double});
+    loose.append_row({"1.5", "2.5x"});
+    loose.append_row({"2", "0.25"});
+    QueryResult nulls = loose;
+    nulls.set_null(0, 0);
+    nulls.set_null(0, 1);
+
+    std::ostringstream a, b;
+    ASSERT_TRUE(write_arrow_ipc(loose, a));
+    ASSERT_TRUE(write_arrow_ipc(nulls, b));
+    EXPECT_EQ(a.str(), b.str());
+}
+
+TEST(ArrowIpcTest, FailedStreamIsReported) {
+    std::ostringstream out;
+    out.setstate(std::ios::badbit);
+    EXPECT_FALSE(write_arrow_ipc(sampleResult(), out));
+
+    ArrowStreamSink sink(out, 2);
+    EXPECT_FALSE(sink.begin({"x"}, {ColumnType::Int64}));
+    EXPECT_FALSE(sink.row({"1"}) && sink.row({"2"}));
+    EXPECT_FALSE(sink.end());
+}
+
+namespace {
+    // Feed a QueryResult through a row sink the way IDatabase::stream() does
+    void feed(const QueryResult& r, IRowSink& sink) {
+        sink.begin(r.columns(), r.column_types());
+        IRowSink::Cells cells(r.cols());
+        for (size_t i = 0; i < r.rows(); ++i) {
+            for (size_t c = 0; c < r.cols(); ++c)
+                cells[c] = r.is_null(i, c) ? std::nullopt
+                                           : std::optional<std::string_view>(r.view(i, c));
+            sink.row(cells);
+        }
+        sink.end();
+    }
+}  // namespace
+
+TEST(CsvWriterTest, EscapesAndDistinguishesNullFromEmpty) {
+    QueryResult r({}, {"id", "text"});
+    r.append_row({"1", "plain"});
+    r.append_row({"2", "with,comma"});
+    r.append_row({"3", "say \"hi\"\nbye"});
+    r.append_row({"4", ""});
+    r.append_row({"5", ""});
+    r.set_null(4, 1);
+
+    std::ostringstream out;
+    OstreamSink sink(out);
+    CsvWriter csv(sink, CsvOptions{',', true, 16});
+    feed(r, csv);
+    EXPECT_EQ(out.str(),
+              "id,text\r\n1,plain\r\n2,\"with,comma\"\r\n3,\"say \"\"hi\"\"\nbye\"\r\n"
+              "4,\"\"\r\n5,\r\n");
+}
+
+TEST(NdjsonWriterTest, TypesNullsAndEscaping) {
+    QueryResult r({}, {"id", "score", "ok", "name"});
+    r.set_column_types({ColumnType::Int64, ColumnType::Double, ColumnType::Bool, ColumnType::Text});
+    r.append_row({"1", "2.5", "t", "a\"b\\c\x01"});
+    r.append_row({"2", "NaN", "f", ""});
+    r.set_null(1, 3);
+
+    std::ostringstream out;
+    OstreamSink sink(out);
+    NdjsonWriter json(sink);
+    feed(r, json);
+    EXPECT_EQ(out.str(),
+              "{\"id\":1,\"score\":2.5,\"ok\":true,\"name\":\"a\\\"b\\\\c\\u0001\"}\n"
+              "{\"id\":2,\"score\":\"NaN\",\"ok\":false,\"name\":null}\n");
+}
+
+TEST(ArrowStreamSinkTest, BatchesStreamedRows) {
+    std::ostringstream whole, streamed;
+    QueryResult r = sampleResult();
+    write_arrow_ipc(r, whole, 2);
+    ArrowStreamSink sink(streamed, 2);
+    feed(r, sink);
+    EXPECT_EQ(whole.str(), streamed.str());
+}
+
+TEST(QueryResultPrintTest, CapsRowsAndTruncatesWideCells) {
+    QueryResult r({}, {"id", "note"});
+    for (int i = 0; i < 10; ++i) r.append_row({std::to_string(i), std::string(60, 'x')});
+    r.append_row({"10", "line\nbreak"});
+    r.set_null(3, 1);
+
+    QueryResult::PrintOptions opts;
+    opts.max_rows = 4;
+    opts.max_col_width = 8;
+    std::ostringstream out;
+    r.print(out, opts);
+    std::string text = out.str();
+
+    EXPECT_NE(text.find("│ 0  │ xxxxxxx… │"), std::string::npos);
+    EXPECT_NE(text.find("│ 3  │ NULL     │"), std::string::npos);
+    EXPECT_EQ(text.find("│ 4  │"), std::string::npos);
+    EXPECT_NE(text.find("… 7 more rows\n11 rows returned.\n"), std::string::npos);
+
+    std::ostringstream all;
+    r.print(all, QueryResult::PrintOptions{0, 40, 1000});
+    EXPECT_NE(all.str().find("│ 10 │ line\\nbreak"), std::string::npos);
+}
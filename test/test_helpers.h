@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "log_armory/src/factory.h"
+#include "sqlite/driver/sqlite3.h"
+
+// Shared by the test executables, each of which includes it from one translation unit
+
+inline ILogger* testLogger() {
+    static ILogger* logger = LoggerFactory::createLogger(LoggerType::Console);
+    return logger;
+}
+
+// Recreates the SQLite file at path through the raw driver and runs sql on it, any number of
+// ';'-separated statements, so fixtures do not depend on the backend under test
+inline bool createSQLiteFile(const std::string& path, const std::string& sql) {
+    std::remove(path.c_str());
+    sqlite3* db = nullptr;
+    bool ok = sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+              sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+    sqlite3_close(db);
+    return ok;
+}
@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "factory.h"
+#include "keyset_paginator.h"
+#include "querybuilder/query_builder.h"
+#include "test_helpers.h"
+
+namespace {
+    // users(id, name, country_id) and countries(id, code); user 4 has no country
+    void loadFixture(MemoryDatabase& db) {
+        ASSERT_TRUE(db.createTable("users", {"id", "name", "country_id"},
+                                   {ColumnType::Int64, ColumnType::Text, ColumnType::Int64}));
+        ASSERT_TRUE(db.createTable("countries", {"id", "code"}, {ColumnType::Int64}));
+        QueryResult users({{"1", "ann", "10"}, {"2", "bob", "20"}, {"3", "cid", "10"},
+                           {"4", "dee", ""}},
+                          {"id", "name", "country_id"});
+        users.set_null(3, 2);
+        ASSERT_TRUE(db.insertRows("users", users));
+        ASSERT_TRUE(db.insertRows("countries", QueryResult({{"10", "de"}, {"20", "fr"}},
+                                                           {"id", "code"})));
+        ASSERT_TRUE(db.createIndex("users", "id", MemoryDatabase::IndexKind::Hash));
+        ASSERT_TRUE(db.createIndex("users", "name", MemoryDatabase::IndexKind::Ordered));
+    }
+}  // namespace
+
+TEST(MemoryDatabaseTest, PointLookupAndRangeThroughIndexes) {
+    ConnectionConfig cfg;
+    std::unique_ptr<IDatabase> base =
+        DatabaseFactory::createDatabase(DatabaseType::Memory, cfg, testLogger());
+    auto& db = static_cast<MemoryDatabase&>(*base);
+    loadFixture(db);
+    ASSERT_TRUE(db.open());
+
+    QueryBuilder point;
+    point.table("users").select("name").where("id = 3");
+    QueryResult res = db.select(point);
+    ASSERT_EQ(res.rows(), 1u);
+    EXPECT_EQ(res.at(0, 0).value(), "cid");
+
+    QueryBuilder range;
+    range.table("users").select("id").where("name >= 'b'").where("name < 'd'").orderBy("id DESC");
+    res = db.select(range);
+    ASSERT_EQ(res.rows(), 2u);
+    EXPECT_EQ(res.at(0, 0).value(), "3");
+    EXPECT_EQ(res.at(1, 0).value(), "2");
+    EXPECT_EQ(res.column_type(0), ColumnType::Int64);
+
+    QueryBuilder paged;
+    paged.table("users").select("id").orderBy("id").limit(2).offset(1);
+    res = db.select(paged);
+    ASSERT_EQ(res.rows(), 2u);
+    EXPECT_EQ(res.at(0, 0).value(), "2");
+    EXPECT_EQ(res.at(1, 0).value(), "3");
+}
+
+TEST(MemoryDatabaseTest, InnerAndLeftJoins) {
+    MemoryDatabase db(ConnectionConfig{}, testLogger());
+    loadFixture(db);
+    db.open();
+
+    QueryBuilder inner;
+    inner.table("users u")
+        .select("u.name")
+        .select("c.code")
+        .join("countries c", "u.country_id", "c.id")
+        .where("c.code = 'de'")
+        .orderBy("u.name");
+    QueryResult res = db.select(inner);
+    ASSERT_EQ(res.rows(), 2u);
+    EXPECT_EQ(res.columns(), (std::vector<std::string>{"name", "code"}));
+    EXPECT_EQ(res.at(1, 0).value(), "cid");
+
+    QueryBuilder left;
+    left.table("users u")
+        .select("u.id")
+        .select("c.code")
+        .leftJoin("countries c", "c.id", "u.country_id")
+        .where("c.code IS NULL");
+    res = db.select(left);
+    ASSERT_EQ(res.rows(), 1u);
+    EXPECT_EQ(res.at(0, 0).value(), "4");
+    EXPECT_TRUE(res.is_null(0, 1));
+}
+
+TEST(MemoryDatabaseTest, UnsupportedShapesFail) {
+    MemoryDatabase db(ConnectionConfig{}, testLogger());
+    loadFixture(db);
+    db.open();
+
+    QueryBuilder fn;
+    fn.table("users").where("lower(name) = 'ann'");
+    EXPECT_TRUE(db.select(fn).columns().empty());
+
+    QueryBuilder right;
+    right.table("users u").rightJoin("countries c", "u.country_id", "c.id");
+    EXPECT_TRUE(db.select(right).columns().empty());
+
+    QueryBuilder missing;
+    missing.table("nope");
+    EXPECT_TRUE(db.select(missing).columns().empty());
+}
+
+TEST(MemoryDatabaseTest, InsertBuilderMapsColumns) {
+    MemoryDatabase db(ConnectionConfig{}, testLogger());
+    loadFixture(db);
+    db.open();
+
+    QueryBuilder ins;
+    ins.insertInto("users", {"name", "id"}).values({"eve", "5"}).values({"fay", "6"});
+    ASSERT_TRUE(db.insert(ins));
+
+    QueryBuilder qb;
+    qb.table("users").select("name").select("country_id").where("id = 6");
+    QueryResult res = db.select(qb);
+    ASSERT_EQ(res.rows(), 1u);
+    EXPECT_EQ(res.at(0, 0).value(), "fay");
+    EXPECT_TRUE(res.is_null(0, 1));
+
+    QueryBuilder bad;
+    bad.insertInto("users", {"nope"}).values({"1"});
+    EXPECT_FALSE(db.insert(bad));
+    QueryBuilder upd;
+    upd.update("users").set("name", "x");
+    EXPECT_FALSE(db.update(upd));
+}
+
+TEST(MemoryDatabaseTest, ReadersSeeConsistentSnapshotsDuringWrites) {
+    MemoryDatabase db(ConnectionConfig{}, testLogger());
+    ASSERT_TRUE(db.createTable("t", {"id"}, {ColumnType::Int64}));
+    db.open();
+
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        QueryBuilder qb;
+        qb.table("t").select("id").orderBy("id");
+        size_t last = 0;
+        while (!done) {
+            QueryResult res = db.select(qb);
+            // Batches of 10 are published atomically and never shrink
+            EXPECT_EQ(res.rows() % 10, 0u);
+            EXPECT_GE(res.rows(), last);
+            last = res.rows();
+        }
+    });
+    for (int batch = 0; batch < 50; ++batch) {
+        QueryResult rows({}, {"id"});
+        for (int i = 0; i < 10; ++i) rows.append_row({std::to_string(batch * 10 + i)});
+        ASSERT_TRUE(db.insertRows("t", rows));
+    }
+    done = true;
+    reader.join();
+}
+
+TEST(MemoryDatabaseTest, KeysetPaginationDescending) {
+    MemoryDatabase db(ConnectionConfig{}, testLogger());
+    ASSERT_TRUE(db.createTable("t", {"id"}, {ColumnType::Int64}));
+    QueryResult rows({}, {"id"});
+    for (int i = 1; i <= 25; ++i) rows.append_row({std::to_string(i)});
+    ASSERT_TRUE(db.insertRows("t", rows));
+    ASSERT_TRUE(db.createIndex("t", "id", MemoryDatabase::IndexKind::Ordered));
+    db.open();
+
+    QueryBuilder qb;
+    qb.table("t").select("id");
+    KeysetPaginator pages(db, qb, {"id"}, 10, true);
+    std::vector<std::string> seen;
+    while (!pages.done()) {
+        QueryResult page = pages.next();
+        for (size_t r = 0; r < page.rows(); ++r) seen.push_back(page.at(r, 0).value());
+    }
+    ASSERT_EQ(seen.size(), 25u);
+    EXPECT_EQ(seen.front(), "25");
+    EXPECT_EQ(seen[10], "15");
+    EXPECT_EQ(seen.back(), "1");
+}
+
+TEST(MemoryDatabaseTest, Int64KeysPast2To53StayDistinct) {
+    // 2^53 and 2^53 + 1 are the same double
+    for (auto index : {std::optional<MemoryDatabase::IndexKind>(),
+                       std::optional(MemoryDatabase::IndexKind::Hash),
+                       std::optional(MemoryDatabase::IndexKind::Ordered)}) {
+        MemoryDatabase db(ConnectionConfig{}, testLogger());
+        ASSERT_TRUE(db.createTable("t", {"id", "score"}, {ColumnType::Int64, ColumnType::Int64}));
+        ASSERT_TRUE(db.insertRows("t", QueryResult({{"9007199254740992", "1"},
+                                                    {"9007199254740993", "2"},
+                                                    {"7", "1.5"}},
+                                                   {"id", "score"})));
+        if (index) {
+            ASSERT_TRUE(db.createIndex("t", "id", *index));
+        }
+        db.open();
+
+        QueryBuilder point;
+        point.table("t").select("score").where("id = 9007199254740993");
+        QueryResult res = db.select(point);
+        ASSERT_EQ(res.rows(), 1u);
+        EXPECT_EQ(res.at(0, 0).value(), "2");
+
+        QueryBuilder bound;
+        bound.table("t").select("id").whereEquals("id", "9007199254740992");
+        EXPECT_EQ(db.select(bound).rows(), 1u);
+
+        QueryBuilder range;
+        range.table("t").select("id").where("id > 9007199254740992.0").orderBy("id DESC");
+        res = db.select(range);
+        ASSERT_EQ(res.rows(), 1u);
+        EXPECT_EQ(res.at(0, 0).value(), "9007199254740993");
+
+        // A REAL cell in an Int64 column still compares as a number
+        QueryBuilder real;
+        real.table("t").select("id").where("score > 1.25").orderBy("score");
+        res = db.select(real);
+        ASSERT_EQ(res.rows(), 2u);
+        EXPECT_EQ(res.at(0, 0).value(), "7");
+    }
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#ifdef __linux__
+#include <sys/mount.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cache/result_cache.h"
+#include "export/arrow_ipc.h"
+#include "export/row_sink.h"
+#include "factory.h"
+#include "memory_accountant.h"
+#include "query_result.h"
+#include "test_helpers.h"
+
+namespace {
+    // The accountant is process-wide: every test starts and ends with it off
+    class MemoryAccountantTest : public ::testing::Test {
+      protected:
+        void SetUp() override { reset(); }
+        void TearDown() override { reset(); }
+
+        static void reset() {
+            MemoryAccountant::instance().setLimit({});
+            MemoryAccountant::instance().enable(false);
+        }
+
+        static size_t live() { return MemoryAccountant::instance().live(); }
+    };
+
+    QueryResult wideRows(size_t rows, size_t width) {
+        QueryResult result({}, {"id", "payload"});
+        for (size_t r = 0; r < rows; ++r)
+            result.append_row({std::to_string(r), std::string(width, 'x')});
+        return result;
+    }
+}  // namespace
+
+TEST_F(MemoryAccountantTest, MemoryUsageCountsStringCapacity) {
+    QueryResult small({{"a"}}, {"c"});
+    QueryResult large({{std::string(1000, 'a')}}, {"c"});
+    // Only the long cell leaves the small-string buffer
+    EXPECT_GE(large.memory_usage(), small.memory_usage() + 1001);
+    EXPECT_LT(large.memory_usage(), small.memory_usage() + 1100);
+
+    QueryResult grown = wideRows(100, 100);
+    size_t before = grown.memory_usage();
+    EXPECT_GE(before, 100 * (sizeof(QueryResult::Row) + 2 * sizeof(std::string) + 101));
+    // The cleared string keeps its capacity; the NULL bitmaps (one per column) are new
+    grown.set_null(0, 1);
+    EXPECT_EQ(grown.memory_usage(),
+              before + 2 * sizeof(std::vector<uint64_t>) + sizeof(uint64_t));
+}
+
+TEST_F(MemoryAccountantTest, TracksLiveResultsAndCaches) {
+    MemoryAccountant::instance().enable();
+    const size_t base = live();
+    {
+        QueryResult result = wideRows(1000, 200);
+        EXPECT_GE(live() - base, 1000u * 200);
+        const size_t one = live() - base;
+
+        QueryResult copy = result;
+        EXPECT_EQ(live() - base, 2 * one);
+        QueryResult moved = std::move(copy);
+        EXPECT_EQ(live() - base, 2 * one);
+
+        MockDatabase db(ConnectionConfig{}, testLogger());
+        db.open();
+        db.setDefaultResult(result);
+        ResultCache cache(std::chrono::seconds(60));
+        QueryBuilder qb;
+        qb.table("items").select("id");
+        const size_t cached = MemoryAccountant::instance().live(MemoryAccountant::Category::Cache);
+        QueryResult served = cache.select(db, qb);
+        EXPECT_EQ(MemoryAccountant::instance().live(MemoryAccountant::Category::Cache) - cached,
+                  one);
+        cache.clear();
+        EXPECT_EQ(MemoryAccountant::instance().live(MemoryAccountant::Category::Cache), cached);
+    }
+    EXPECT_EQ(live(), base);
+    EXPECT_GT(MemoryAccountant::instance().peak(), base);
+}
+
+TEST_F(MemoryAccountantTest, SoftLimitSpillsOrRejectsLargeResults) {
+    const size_t base = live();
+    MemoryAccountant::Limit limit;
+    limit.soft_bytes = base + 512 * 1024;
+    limit.large_result = 64 * 1024;
+    MemoryAccountant::instance().setLimit(limit);
+
+    // Small results are admitted past the limit, large ones spill their further rows
+    QueryResult held = wideRows(3000, 200);
+    EXPECT_TRUE(held.spilled());
+    EXPECT_EQ(held.rows(), 3000u);
+    EXPECT_LE(live(), limit.soft_bytes);
+    EXPECT_EQ(held.at(2999, 1).value(), std::string(200, 'x'));
+    EXPECT_FALSE(wideRows(10, 10).spilled());
+
+    limit.action = MemoryAccountant::Admit::Reject;
+    MemoryAccountant::instance().setLimit(limit);
+    ResultCollector collector;
+    collector.begin({"id", "payload"}, {});
+    std::string payload(200, 'y');
+    bool accepted = true;
+    for (int r = 0; r < 3000 && accepted; ++r)
+        accepted = collector.row({std::string_view("1"), std::string_view(payload)});
+    EXPECT_FALSE(accepted);
+    EXPECT_TRUE(collector.result().rejected());
+    EXPECT_LT(collector.result().rows(), 3000u);
+}
+
+TEST_F(MemoryAccountantTest, RejectedArrowBatchFailsTheStream) {
+    MemoryAccountant::Limit limit;
+    limit.soft_bytes = live() + 256 * 1024;
+    limit.large_result = 64 * 1024;
+    limit.action = MemoryAccountant::Admit::Reject;
+    MemoryAccountant::instance().setLimit(limit);
+
+    std::ostringstream out;
+    ArrowStreamSink sink(out);
+    ASSERT_TRUE(sink.begin({"id", "payload"}, {ColumnType::Int64, ColumnType::Text}));
+    const std::string payload(100, 'p');
+    bool accepted = true;
+    int rows = 0;
+    for (; rows < 50000 && accepted; ++rows)
+        accepted = sink.row({std::string_view("1"), std::string_view(payload)});
+    EXPECT_FALSE(accepted);
+    EXPECT_LT(rows, 50000);
+    EXPECT_FALSE(sink.end());
+}
+
+TEST_F(MemoryAccountantTest, FullSpillDirectoryFailsTheResult) {
+#ifdef __linux__
+    // A 3 MB tmpfs: the spill file's third doubling does not fit
+    char dir[] = "/tmp/database_armory_full_XXXXXX";
+    ASSERT_NE(::mkdtemp(dir), nullptr);
+    if (::mount("tmpfs", dir, "tmpfs", 0, "size=3m") != 0) {
+        ::rmdir(dir);
+        GTEST_SKIP() << "mounting a size-limited tmpfs needs privileges";
+    }
+    {
+        QueryResult result({}, {"id", "payload"});
+        result.set_spill_policy({16 * 1024, dir});
+        const std::string payload(1000, 'x');
+        for (int r = 0; r < 10000 && !result.rejected(); ++r)
+            result.append_row({std::to_string(r), payload});
+        EXPECT_TRUE(result.spilled());
+        EXPECT_TRUE(result.spill_error());
+        EXPECT_TRUE(result.rejected());
+    }
+    ::umount2(dir, MNT_DETACH);
+    ::rmdir(dir);
+#else
+    GTEST_SKIP() << "needs a size-limited tmpfs";
+#endif
+}
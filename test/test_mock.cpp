@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "factory.h"
+#include "querybuilder/query_builder.h"
+#include "test_helpers.h"
+
+namespace {
+    QueryBuilder usersById(int id) {
+        QueryBuilder qb;
+        qb.table("users").select("name").where("id = " + std::to_string(id));
+        return qb;
+    }
+}  // namespace
+
+TEST(MockDatabaseTest, ServesCannedResultsAndRecordsQueries) {
+    ConnectionConfig cfg;
+    std::unique_ptr<IDatabase> db =
+        DatabaseFactory::createDatabase(DatabaseType::Mock, cfg, testLogger());
+    auto& mock = static_cast<MockDatabase&>(*db);
+    ASSERT_TRUE(db->open());
+
+    mock.addResult("users", QueryResult({{"alice"}, {"bob"}}, {"name"}));
+    mock.addResult(usersById(7).str(), QueryResult({{"carol"}}, {"name"}));
+
+    EXPECT_EQ(db->select(usersById(1)).rows(), 2u);
+    EXPECT_EQ(db->select(usersById(7)).at(0, 0).value(), "carol");
+    QueryBuilder other;
+    other.table("orders").select("id");
+    EXPECT_TRUE(db->select(other).empty());
+    EXPECT_TRUE(db->insert(usersById(2)));
+
+    auto calls = mock.calls();
+    ASSERT_EQ(calls.size(), 4u);
+    EXPECT_EQ(calls[0].op, MockDatabase::Op::Select);
+    EXPECT_EQ(calls[3].op, MockDatabase::Op::Insert);
+    EXPECT_EQ(calls[1].query.str(), usersById(7).str());
+}
+
+TEST(MockDatabaseTest, ErrorInjectionIsReproducibleForASeed) {
+    ConnectionConfig cfg;
+    cfg.mock.error_rate = 0.3;
+    cfg.mock.latency = MockConfig::Latency::Exponential;
+    cfg.mock.latency_us = 5;
+    cfg.mock.seed = 42;
+
+    auto run = [&] {
+        MockDatabase db(cfg, testLogger());
+        db.open();
+        std::vector<bool> outcome;
+        for (int i = 0; i < 200; ++i) outcome.push_back(db.update(usersById(i)));
+        return outcome;
+    };
+    std::vector<bool> first = run();
+    EXPECT_EQ(first, run());
+
+    size_t failures = std::count(first.begin(), first.end(), false);
+    EXPECT_GT(failures, 30u);
+    EXPECT_LT(failures, 90u);
+}
+
+TEST(MockDatabaseTest, ConcurrencyLimitIsEnforced) {
+    ConnectionConfig cfg;
+    cfg.mock.latency = MockConfig::Latency::Fixed;
+    cfg.mock.latency_us = 2000;
+    cfg.mock.max_concurrency = 2;
+    MockDatabase db(cfg, testLogger());
+    db.open();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t)
+        threads.emplace_back([&db, t] { db.select(usersById(t)); });
+    for (auto& th : threads) th.join();
+
+    // 8 calls through 2 slots take at least 4 rounds of 2 ms
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(8));
+    EXPECT_EQ(db.calls().size(), 8u);
+    EXPECT_LE(db.peakConcurrency(), 2);
+    for (const auto& call : db.calls()) EXPECT_EQ(call.latency, std::chrono::microseconds(2000));
+}
+
+TEST(MockDatabaseTest, TimeoutAndCancellationCutLatencyShort) {
+    ConnectionConfig cfg;
+    cfg.mock.latency = MockConfig::Latency::Fixed;
+    cfg.mock.latency_us = 2000000;
+    MockDatabase db(cfg, testLogger());
+    db.open();
+
+    auto start = std::chrono::steady_clock::now();
+    QueryBuilder slow = usersById(1);
+    slow.timeout(std::chrono::milliseconds(10));
+    EXPECT_FALSE(db.update(slow));
+    EXPECT_EQ(IDatabase::lastStatus(), QueryStatus::TimedOut);
+
+    CancellationToken token;
+    QueryBuilder cancelled = usersById(2);
+    cancelled.cancelledBy(token);
+    std::thread canceller([token]() mutable {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        token.cancel();
+    });
+    EXPECT_FALSE(db.update(cancelled));
+    canceller.join();
+    EXPECT_EQ(IDatabase::lastStatus(), QueryStatus::Cancelled);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+
+    MockDatabase fast(ConnectionConfig{}, testLogger());
+    fast.open();
+    EXPECT_TRUE(fast.update(slow));
+    EXPECT_EQ(IDatabase::lastStatus(), QueryStatus::Ok);
+}
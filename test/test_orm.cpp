@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "factory.h"
+#include "memory/memory_database.h"
+#include "orm/repository.h"
+#include "test_helpers.h"
+
+struct Account {
+    int64_t id = 0;
+    std::string name;
+    std::optional<std::string> email;
+    double balance = 0;
+    bool active = false;
+    std::optional<CellTime> closed_at;
+};
+ARMORY_TABLE(Account, "accounts", id, name, email, balance, active, closed_at);
+
+struct Tag {
+    std::optional<std::string> code;
+    std::string label;
+};
+ARMORY_TABLE(Tag, "tags", code, label);
+
+namespace {
+    const char* kPath = "test_orm.db";
+
+    void createAccounts() {
+        createSQLiteFile(kPath,
+                         "CREATE TABLE accounts(id INTEGER PRIMARY KEY, name TEXT NOT NULL, "
+                         "email TEXT, balance REAL, active INTEGER, closed_at TEXT);");
+    }
+
+    using Sql = TableSql<Account>;
+}  // namespace
+
+// The text is checked at compile time; it must also match what the builder renders
+static_assert(Sql::SelectByKey::question.view() ==
+              "SELECT id, name, email, balance, active, closed_at FROM accounts WHERE id = ?");
+static_assert(Sql::Update::numbered.view() ==
+              "UPDATE accounts SET name = $1, email = $2, balance = $3, active = $4, "
+              "closed_at = $5 WHERE id = $6");
+
+TEST(OrmTest, PrecompiledSqlMatchesBuilder) {
+    std::vector<std::string> columns{"id", "name", "email", "balance", "active", "closed_at"};
+    QueryBuilder insert;
+    insert.insertInto("accounts", columns).values(QueryBuilder::Params(6));
+    QueryBuilder update;
+    update.update("accounts");
+    for (size_t i = 1; i < columns.size(); ++i) update.set(columns[i], "x");
+    update.whereEquals("id", "1");
+    QueryBuilder find;
+    find.table("accounts").whereEquals("id", "1");
+    for (const auto& column : columns) find.select(column);
+    QueryBuilder remove;
+    remove.deleteFrom("accounts").whereEquals("id", "1");
+
+    for (auto style : {QueryBuilder::ParamStyle::Question, QueryBuilder::ParamStyle::Numbered}) {
+        EXPECT_EQ(insert.str(style), Sql::Insert::str(style));
+        EXPECT_EQ(update.str(style), Sql::Update::str(style));
+        EXPECT_EQ(find.str(style), Sql::SelectByKey::str(style));
+        EXPECT_EQ(remove.str(style), Sql::Remove::str(style));
+    }
+    EXPECT_EQ(Sql::Select::question.view(),
+              "SELECT id, name, email, balance, active, closed_at FROM accounts");
+
+    Account account{7, "ann", std::nullopt, 2.5, true, CellTime{}};
+    QueryBuilder::Params params = encodeRow(account);
+    ASSERT_EQ(params.size(), 6u);
+    EXPECT_EQ(params[0], "7");
+    EXPECT_FALSE(params[2]);
+    EXPECT_EQ(params[3], "2.5");
+    EXPECT_EQ(params[4], "1");
+    EXPECT_EQ(params[5], "1970-01-01 00:00:00.000000+00");
+}
+
+TEST(OrmTest, CrudOnSQLite) {
+    createAccounts();
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    auto db = DatabaseFactory::createDatabase(DatabaseType::sqlite, cfg, testLogger());
+    ASSERT_TRUE(db->open());
+    Repository<Account> accounts(*db);
+    ASSERT_TRUE(accounts.prepare());
+
+    const CellTime closed = std::chrono::sys_days{std::chrono::year{2024} / 3 / 1} +
+                            std::chrono::microseconds{1500};
+    ASSERT_TRUE(accounts.insert({1, "ann", "ann@mail.com", 10.25, true, std::nullopt}));
+    ASSERT_TRUE(accounts.insert({2, "bob", std::nullopt, -3, false, closed}));
+    EXPECT_FALSE(accounts.insert({1, "dup", std::nullopt, 0, false, std::nullopt}));
+
+    auto bob = accounts.find(2);
+    ASSERT_TRUE(bob);
+    EXPECT_EQ(bob->name, "bob");
+    EXPECT_FALSE(bob->email);
+    EXPECT_EQ(bob->balance, -3);
+    EXPECT_FALSE(bob->active);
+    EXPECT_EQ(bob->closed_at, closed);
+    EXPECT_FALSE(accounts.find(3));
+
+    bob->email = "bob@mail.com";
+    bob->balance = 99.5;
+    ASSERT_TRUE(accounts.update(*bob));
+    EXPECT_EQ(accounts.find(2)->email, "bob@mail.com");
+    EXPECT_EQ(accounts.find(2)->balance, 99.5);
+    EXPECT_EQ(accounts.find(1)->email, "ann@mail.com");
+
+    QueryBuilder filter;
+    filter.where("balance > 0").orderBy("id DESC");
+    auto rows = accounts.select(filter);
+    ASSERT_TRUE(rows);
+    ASSERT_EQ(rows->size(), 2u);
+    EXPECT_EQ((*rows)[0].id, 2);
+    EXPECT_TRUE((*rows)[1].active);
+
+    ASSERT_TRUE(accounts.remove(1));
+    EXPECT_FALSE(accounts.find(1));
+    EXPECT_EQ(accounts.select()->size(), 1u);
+    db->close();
+}
+
+TEST(OrmTest, FindThroughMemoryBackend) {
+    MemoryDatabase db(ConnectionConfig{}, testLogger());
+    ASSERT_TRUE(db.createTable("accounts",
+                               {"id", "name", "email", "balance", "active", "closed_at"},
+                               {ColumnType::Int64, ColumnType::Text, ColumnType::Text,
+                                ColumnType::Double, ColumnType::Int64, ColumnType::Text}));
+    db.open();
+    Repository<Account> accounts(db);
+    ASSERT_TRUE(accounts.insert({1, "ann", std::nullopt, 1, true, std::nullopt}));
+    ASSERT_TRUE(accounts.insert({2, "bob", "bob@mail.com", 2, false, std::nullopt}));
+
+    auto bob = accounts.find(2);
+    ASSERT_TRUE(bob);
+    EXPECT_EQ(bob->email, "bob@mail.com");
+    EXPECT_FALSE(accounts.find(5));
+
+    QueryBuilder filter;
+    filter.whereEquals("name", "ann");
+    auto rows = accounts.select(filter);
+    ASSERT_TRUE(rows);
+    ASSERT_EQ(rows->size(), 1u);
+    EXPECT_EQ((*rows)[0].id, 1);
+}
+
+TEST(OrmTest, NullKeyFailsWithoutMatchingEmptyKey) {
+    MemoryDatabase db(ConnectionConfig{}, testLogger());
+    ASSERT_TRUE(db.createTable("tags", {"code", "label"}, {ColumnType::Text, ColumnType::Text}));
+    db.open();
+    Repository<Tag> tags(db);
+    ASSERT_TRUE(tags.insert({"", "blank"}));
+
+    EXPECT_FALSE(tags.update({std::nullopt, "changed"}));
+    EXPECT_FALSE(tags.find(std::nullopt));
+    EXPECT_FALSE(tags.remove(std::nullopt));
+    auto blank = tags.find(std::string());
+    ASSERT_TRUE(blank);
+    EXPECT_EQ(blank->label, "blank");
+}
@@ -1,65 +1,214 @@
-#include <gtest/gtest.h>
-#include "querybuilder/query_builder.h"
-
-// Basic test: typical complex SELECT
-TEST(QueryBuilderTest, BasicSelectQuery) {
-    QueryBuilder qb;
-    std::string sql = qb.table("users u")
-                       .select("u.id")
-                       .select("u.name")
-                       .select("o.total")
-                       .join("orders o", "u.id", "o.user_id")
-                       .where("u.active = true")
-                       .orderBy("o.total DESC")
-                       .limit(10)
-                       .offset(20)
-                       .str();
-
-    EXPECT_TRUE(sql.find("FROM users u") != std::string::npos);
-    EXPECT_TRUE(sql.find("JOIN orders o") != std::string::npos);
-    EXPECT_TRUE(sql.find("WHERE u.active = true") != std::string::npos);
-    EXPECT_TRUE(sql.find("ORDER BY o.total DESC") != std::string::npos);
-    EXPECT_TRUE(sql.find("LIMIT 10") != std::string::npos);
-    EXPECT_TRUE(sql.find("OFFSET 20") != std::string::npos);
-}
-
-// Empty builder
-TEST(QueryBuilderTest, EmptyQueryBuilderShouldReturnEmptyString) {
-    QueryBuilder qb;
-    std::string sql = qb.str();
-    EXPECT_TRUE(sql.empty() || sql == "");
-}
-
-// Only table
-TEST(QueryBuilderTest, TableOnlyQuery) {
-    QueryBuilder qb;
-    std::string sql = qb.table("posts").str();
-    EXPECT_TRUE(sql.find("posts") != std::string::npos);
-}
-
-// Multiple WHERE clauses
-TEST(QueryBuilderTest, MultipleWhereClauses) {
-    QueryBuilder qb;
-    std::string sql = qb.table("items")
-                       .where("price > 100")
-                       .where("stock > 0")
-                       .str();
-    EXPECT_TRUE(sql.find("price > 100") != std::string::npos);
-    EXPECT_TRUE(sql.find("AND stock > 0") != std::string::npos);
-}
-
-// Complex join chain
-TEST(QueryBuilderTest, MultiJoinQuery) {
-    QueryBuilder qb;
-    std::string sql = qb.table("employees e")
-                       .join("departments d", "e.dept_id", "d.id")
-                       .join("roles r", "e.role_id", "r.id")
-                       .select("e.name")
-                       .select("d.title")
-                       .select("r.level")
-                       .where("r.active = 1")
-                       .str();
-
-    EXPECT_TRUE(sql.find("JOIN departments d") != std::string::npos);
-    EXPECT_TRUE(sql.find("JOIN roles r") != std::string::npos);
-}
+#include <gtest/gtest.h>
+#include "querybuilder/query_builder.h"
+
+// Basic test: typical complex SELECT
+TEST(QueryBuilderTest, BasicSelectQuery) {
+    QueryBuilder qb;
+    std::string sql = qb.table("users u")
+                       .select("u.id")
+                       .select("u.name")
+                       .select("o.total")
+                       .join("orders o", "u.id", "o.user_id")
+                       .where("u.active = true")
+                       .orderBy("o.total DESC")
+                       .limit(10)
+                       .offset(20)
+                       .str();
+
+    EXPECT_TRUE(sql.find("FROM users u") != std::string::npos);
+    EXPECT_TRUE(sql.find("JOIN orders o") != std::string::npos);
+    EXPECT_TRUE(sql.find("WHERE u.active = true") != std::string::npos);
+    EXPECT_TRUE(sql.find("ORDER BY o.total DESC") != std::string::npos);
+    EXPECT_TRUE(sql.find("LIMIT 10") != std::string::npos);
+    EXPECT_TRUE(sql.find("OFFSET 20") != std::string::npos);
+}
+
+// Empty builder
+TEST(QueryBuilderTest, EmptyQueryBuilderShouldReturnEmptyString) {
+    QueryBuilder qb;
+    std::string sql = qb.str();
+    EXPECT_TRUE(sql.empty() || sql == "");
+}
+
+// Only table
+TEST(QueryBuilderTest, TableOnlyQuery) {
+    QueryBuilder qb;
+    std::string sql = qb.table("posts").str();
+    EXPECT_TRUE(sql.find("posts") != std::string::npos);
+}
+
+// Multiple WHERE clauses
+TEST(QueryBuilderTest, MultipleWhereClauses) {
+    QueryBuilder qb;
+    std::string sql = qb.table("items")
+                       .where("price > 100")
+                       .where("stock > 0")
+                       .str();
+    EXPECT_TRUE(sql.find("price > 100") != std::string::npos);
+    EXPECT_TRUE(sql.find("AND stock > 0") != std::string::npos);
+}
+
+// Complex join chain
+TEST(QueryBuilderTest, MultiJoinQuery) {
+    QueryBuilder qb;
+    std::string sql = qb.table("employees e")
+                       .join("departments d", "e.dept_id", "d.id")
+                       .join("roles r", "e.role_id", "r.id")
+                       .select("e.name")
+                       .select("d.title")
+                       .select("r.level")
+                       .where("r.active = 1")
+                       .str();
+
+    EXPECT_TRUE(sql.find("JOIN departments d") != std::string::npos);
+    EXPECT_TRUE(sql.find("JOIN roles r") != std::string::npos);
+}
+
+// Keyset pagination renders a row-value comparison with bound parameters
+TEST(QueryBuilderTest, SeekAfterRendersRowValueComparison) {
+    QueryBuilder qb;
+    qb.table("events")
+        .where("kind = 'click'")
+        .seekAfter({"ts", "id"}, {"2024-01-01", "42"})
+        .limit(50);
+
+    EXPECT_EQ(qb.str(),
+              "SELECT * FROM events WHERE kind = 'click' AND (ts, id) > (?, ?) ORDER BY ts, id "
+              "LIMIT 50");
+    EXPECT_EQ(qb.str(QueryBuilder::ParamStyle::Numbered),
+              "SELECT * FROM events WHERE kind = 'click' AND (ts, id) > ($1, $2) ORDER BY ts, id "
+              "LIMIT 50");
+    ASSERT_EQ(qb.getParams().size(), 2u);
+    EXPECT_EQ(*qb.getParams()[1], "42");
+
+    QueryBuilder desc;
+    desc.table("events").seekAfter({"id"}, {"7"}, true);
+    EXPECT_EQ(desc.str(), "SELECT * FROM events WHERE id < ? ORDER BY id DESC");
+}
+
+// Write statements bind every value; big inserts split by parameter count
+TEST(QueryBuilderTest, InsertUpdateDeleteAndSplit) {
+    QueryBuilder ins;
+    ins.insertInto("users", {"name", "email"})
+        .values({"ann", "ann@mail.com"})
+        .values({"bob", std::nullopt})
+        .values({"cy", "cy@mail.com"});
+    EXPECT_EQ(ins.str(), "INSERT INTO users (name, email) VALUES (?, ?), (?, ?), (?, ?)");
+    EXPECT_EQ(ins.str(QueryBuilder::ParamStyle::Numbered),
+              "INSERT INTO users (name, email) VALUES ($1, $2), ($3, $4), ($5, $6)");
+    ASSERT_EQ(ins.getParams().size(), 6u);
+    EXPECT_FALSE(ins.getParams()[3].has_value());
+
+    auto chunks = ins.split(5);
+    ASSERT_EQ(chunks.size(), 2u);
+    EXPECT_EQ(chunks[0].getInsertRows().size(), 2u);
+    EXPECT_EQ(chunks[1].str(), "INSERT INTO users (name, email) VALUES (?, ?)");
+    EXPECT_EQ(*chunks[1].getParams()[0], "cy");
+    EXPECT_EQ(ins.split(6).size(), 1u);
+
+    QueryBuilder upd;
+    upd.update("users").set("name", "dee").set("email", std::nullopt).where("id = 4");
+    EXPECT_EQ(upd.str(QueryBuilder::ParamStyle::Numbered),
+              "UPDATE users SET name = $1, email = $2 WHERE id = 4");
+    EXPECT_EQ(upd.getParams().size(), 2u);
+
+    QueryBuilder del;
+    del.deleteFrom("users").where("id > 10");
+    EXPECT_EQ(del.str(), "DELETE FROM users WHERE id > 10");
+    EXPECT_TRUE(del.getParams().empty());
+}
+
+TEST(QueryBuilderTest, MismatchedArityRendersNothing) {
+    QueryBuilder empty;
+    empty.insertInto("users", {"name", "email"});
+    EXPECT_FALSE(empty.isValid());
+    EXPECT_EQ(empty.str(), "");
+
+    QueryBuilder uneven;
+    uneven.insertInto("users", {"name", "email"}).values({"ann", "a@x"}).values({"bob"});
+    EXPECT_EQ(uneven.str(), "");
+    uneven.clearValues().values({"bob", std::nullopt});
+    EXPECT_EQ(uneven.str(), "INSERT INTO users (name, email) VALUES (?, ?)");
+
+    QueryBuilder noSet;
+    noSet.update("users").where("id = 1");
+    EXPECT_FALSE(noSet.isValid());
+    EXPECT_EQ(noSet.str(), "");
+    noSet.set("name", "ann");
+    EXPECT_EQ(noSet.str(), "UPDATE users SET name = ? WHERE id = 1");
+
+    QueryBuilder seek;
+    seek.table("events").seekAfter({"ts", "id"}, {"2024-01-01"});
+    EXPECT_EQ(seek.str(), "");
+    seek.seekAfter({}, {});
+    EXPECT_EQ(seek.str(), "");
+}
+
+TEST(QueryBuilderTest, UpsertRendersOnConflict) {
+    QueryBuilder qb;
+    qb.insertInto("stock", {"sku", "warehouse", "qty", "note"})
+        .values({"a1", "w1", "5", std::nullopt})
+        .onConflict({"sku", "warehouse"})
+        .doUpdate();
+    EXPECT_EQ(qb.str(QueryBuilder::ParamStyle::Numbered),
+              "INSERT INTO stock (sku, warehouse, qty, note) VALUES ($1, $2, $3, $4) "
+              "ON CONFLICT (sku, warehouse) DO UPDATE SET qty = excluded.qty, note = "
+              "excluded.note");
+
+    qb.doUpdate({"qty"});
+    EXPECT_EQ(*qb.getConflictUpdates(), std::vector<std::string>{"qty"});
+
+    // Chunks keep the conflict clause
+    qb.values({"b2", "w1", "1", std::nullopt}).doNothing();
+    auto chunks = qb.split(4);
+    ASSERT_EQ(chunks.size(), 2u);
+    EXPECT_EQ(chunks[1].str(),
+              "INSERT INTO stock (sku, warehouse, qty, note) VALUES (?, ?, ?, ?) "
+              "ON CONFLICT (sku, warehouse) DO NOTHING");
+}
+
+TEST(QueryBuilderTest, DoUpdateNeedsConflictTarget) {
+    QueryBuilder qb;
+    qb.insertInto("stock", {"sku", "qty"}).values({"a1", "5"}).doUpdate();
+    EXPECT_FALSE(qb.isValid());
+    EXPECT_EQ(qb.str(), "");
+
+    // DO NOTHING may omit the target
+    qb.doNothing();
+    EXPECT_EQ(qb.str(), "INSERT INTO stock (sku, qty) VALUES (?, ?) ON CONFLICT DO NOTHING");
+
+    qb.onConflict({"sku"}).doUpdate();
+    EXPECT_EQ(qb.str(),
+              "INSERT INTO stock (sku, qty) VALUES (?, ?) ON CONFLICT (sku) DO UPDATE SET "
+              "qty = excluded.qty");
+}
+
+TEST(QueryBuilderTest, PrecompiledTextDroppedOnChangeKeptOnRebind) {
+    QueryBuilder qb;
+    qb.insertInto("t", {"a", "b"}).values({"1", "2"}).precompiled("PRE ?", "PRE $1");
+    EXPECT_EQ(qb.str(), "PRE ?");
+
+    // rebind() keeps the statement; a wrong count or a NULL where one cannot go changes nothing
+    EXPECT_TRUE(qb.rebind({"3", std::nullopt}));
+    EXPECT_EQ(qb.str(QueryBuilder::ParamStyle::Numbered), "PRE $1");
+    EXPECT_EQ(qb.getParams(), (QueryBuilder::Params{"3", std::nullopt}));
+    EXPECT_FALSE(qb.rebind({"4"}));
+    EXPECT_EQ(*qb.getParams()[0], "3");
+
+    QueryBuilder more = qb;
+    more.values({"5", "6"});
+    EXPECT_EQ(more.str(), "INSERT INTO t (a, b) VALUES (?, ?), (?, ?)");
+    auto chunks = more.split(2);
+    ASSERT_EQ(chunks.size(), 2u);
+    EXPECT_EQ(chunks[0].str(), "INSERT INTO t (a, b) VALUES (?, ?)");
+    EXPECT_EQ(qb.split(2)[0].str(), "PRE ?");
+
+    QueryBuilder find;
+    find.table("t").whereEquals("a", "1").seekAfter({"b"}, {"0"}).precompiled("PRE", "PRE");
+    EXPECT_FALSE(find.rebind({"2", std::nullopt}));
+    EXPECT_FALSE(find.rebind({std::nullopt, "1"}));
+    EXPECT_TRUE(find.rebind({"2", "1"}));
+    EXPECT_EQ(find.getWhereEquals()[0].second, "2");
+    find.limit(1);
+    EXPECT_EQ(find.str(), "SELECT * FROM t WHERE a = ? AND b > ? ORDER BY b LIMIT 1");
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache/result_cache.h"
+#include "factory.h"
+#include "postgres/pg_change_listener.h"
+#include "querybuilder/query_builder.h"
+#include "test_helpers.h"
+
+TEST(ResultCacheTest, HitsUntilTtlOrInvalidation) {
+    MockDatabase db(ConnectionConfig{}, testLogger());
+    db.open();
+    db.setDefaultResult(QueryResult({{"1"}}, {"id"}));
+    ResultCache cache(std::chrono::milliseconds(50));
+
+    QueryBuilder users;
+    users.table("public.Users u").select("u.id").seekAfter({"u.id"}, {"10"});
+    QueryBuilder joined;
+    joined.table("orders o").join("users u", "o.user_id", "u.id").select("o.id");
+    QueryBuilder otherPage;
+    otherPage.table("public.Users u").select("u.id").seekAfter({"u.id"}, {"20"});
+
+    cache.select(db, users);
+    cache.select(db, users);
+    cache.select(db, joined);
+    cache.select(db, otherPage);  // bound values are part of the key
+    EXPECT_EQ(db.calls().size(), 3u);
+    EXPECT_EQ(cache.size(), 3u);
+
+    // Schema, alias and case do not matter; the join reads users as well
+    cache.invalidate("USERS");
+    EXPECT_EQ(cache.size(), 0u);
+    cache.select(db, users);
+    EXPECT_EQ(db.calls().size(), 4u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_FALSE(cache.get(users).has_value());
+}
+
+TEST(ResultCacheTest, ListenersAndLruEviction) {
+    MockDatabase db(ConnectionConfig{}, testLogger());
+    db.open();
+    db.setDefaultResult(QueryResult({{"1"}}, {"id"}));
+    ResultCache cache(std::chrono::minutes(10), 2);
+
+    std::vector<std::string> rebuilt;
+    uint64_t id = cache.onInvalidate("orders", [&](const std::string& t) { rebuilt.push_back(t); });
+    cache.invalidate("users");
+    cache.invalidate("orders");
+    cache.clear();
+    cache.removeListener(id);
+    cache.invalidate("orders");
+    EXPECT_EQ(rebuilt, (std::vector<std::string>{"orders", ""}));
+
+    QueryBuilder a, b, c;
+    a.table("a");
+    b.table("b");
+    c.table("c");
+    cache.select(db, a);
+    cache.select(db, b);
+    cache.get(a);  // b is now the least recently used
+    cache.select(db, c);
+    EXPECT_TRUE(cache.get(a).has_value());
+    EXPECT_FALSE(cache.get(b).has_value());
+}
+
+TEST(PgChangeListenerTest, TriggerSqlQuotesNames) {
+    std::string sql = PgChangeListener::triggerSql("public.orders", "order's");
+    EXPECT_NE(sql.find("CREATE OR REPLACE FUNCTION \"armory_notify_order's\"()"),
+              std::string::npos);
+    EXPECT_NE(sql.find("pg_notify('order''s', TG_TABLE_NAME)"), std::string::npos);
+    EXPECT_NE(sql.find("ON public.orders\n    FOR EACH STATEMENT"), std::string::npos);
+}
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "compute/result_ops.h"
+#include "query_result.h"
+
+namespace {
+    using Selection = ResultOps::Selection;
+    using Compare = ResultOps::Compare;
+    using Agg = ResultOps::Agg;
+
+    // region (text), amount (int64), price (double); row 3 has NULL amount and price
+    QueryResult sales() {
+        QueryResult result({}, {"region", "amount", "price"});
+        result.set_column_types({ColumnType::Text, ColumnType::Int64, ColumnType::Double});
+        result.append_row({"east", "10", "1.5"});
+        result.append_row({"west", "-4", "2.25"});
+        result.append_row({"east", "7", "0.5"});
+        result.append_cells({"north", std::nullopt, std::nullopt});
+        result.append_row({"west", "30", "9"});
+        result.append_cells({std::nullopt, "1", "1"});
+        return result;
+    }
+}  // namespace
+
+TEST(ResultOpsTest, FiltersChainAndSkipNulls) {
+    QueryResult result = sales();
+    auto amount = ResultOps::int64s(result, 1);
+    EXPECT_EQ(amount.valid, (std::vector<uint8_t>{1, 1, 1, 0, 1, 1}));
+
+    Selection positive = ResultOps::filter(amount, Compare::Gt, 0);
+    EXPECT_EQ(positive, (Selection{0, 2, 4, 5}));
+    EXPECT_EQ(ResultOps::filter(amount, Compare::Ne, 7), (Selection{0, 1, 4, 5}));
+
+    Selection cheap = ResultOps::filter(ResultOps::doubles(result, 2), Compare::Le, 1.5, &positive);
+    EXPECT_EQ(cheap, (Selection{0, 2, 5}));
+    EXPECT_EQ(ResultOps::filter(result, 0, Compare::Eq, "east", &cheap), (Selection{0, 2}));
+
+    // Typed columns compare numerically: "9" > "10" as text but not as a number
+    EXPECT_EQ(ResultOps::filter(result, 2, Compare::Ge, "2.25"), (Selection{1, 4}));
+    EXPECT_EQ(ResultOps::filter(result, 0, Compare::Lt, "o"), (Selection{0, 2, 3}));
+    EXPECT_TRUE(ResultOps::filter(result, 1, Compare::Eq, "ten").empty());
+
+    QueryResult picked = ResultOps::take(result, ResultOps::filter(result, 0, Compare::Ne, "east"));
+    ASSERT_EQ(picked.rows(), 3u);
+    EXPECT_EQ(picked.view(1, 0), "north");
+    EXPECT_TRUE(picked.is_null(1, 1));
+    EXPECT_EQ(picked.column_type(1), ColumnType::Int64);
+}
+
+TEST(ResultOpsTest, GroupByAggregatesPerKey) {
+    QueryResult result = sales();
+    QueryResult groups = ResultOps::groupBy(result, 0,
+                                            {{Agg::Count},
+                                             {Agg::Count, 1},
+                                             {Agg::Sum, 1},
+                                             {Agg::Min, 2},
+                                             {Agg::Max, 1}});
+    EXPECT_EQ(groups.columns(),
+              (std::vector<std::string>{"region", "count(*)", "count(amount)", "sum(amount)",
+                                        "min(price)", "max(amount)"}));
+    EXPECT_EQ(groups.column_type(3), ColumnType::Int64);
+    EXPECT_EQ(groups.column_type(4), ColumnType::Double);
+
+    // First appearance order, NULL key as its own group
+    ASSERT_EQ(groups.rows(), 4u);
+    EXPECT_EQ(groups.row(0), (QueryResult::Row{"east", "2", "2", "17", "0.5", "10"}));
+    EXPECT_EQ(groups.row(1), (QueryResult::Row{"west", "2", "2", "26", "2.25", "30"}));
+    EXPECT_EQ(groups.view(2, 0), "north");
+    EXPECT_EQ(groups.view(2, 1), "1");
+    EXPECT_EQ(groups.view(2, 2), "0");
+    EXPECT_TRUE(groups.is_null(2, 3));
+    EXPECT_TRUE(groups.is_null(2, 4));
+    EXPECT_TRUE(groups.is_null(3, 0));
+    EXPECT_EQ(groups.view(3, 3), "1");
+
+    Selection east = ResultOps::filter(result, 0, Compare::Eq, "east");
+    QueryResult only = ResultOps::groupBy(result, 0, {{Agg::Sum, 2}}, &east);
+    ASSERT_EQ(only.rows(), 1u);
+    EXPECT_EQ(only.row(0), (QueryResult::Row{"east", "2"}));
+}
+
+TEST(ResultOpsTest, IntegerSumPastInt64BecomesDouble) {
+    const int64_t max = std::numeric_limits<int64_t>::max();
+    QueryResult result({}, {"key", "value"});
+    result.set_column_types({ColumnType::Text, ColumnType::Int64});
+    result.append_row({"big", std::to_string(max)});
+    result.append_row({"small", "2"});
+    result.append_row({"big", std::to_string(max)});
+    result.append_row({"small", "3"});
+
+    QueryResult groups = ResultOps::groupBy(result, 0, {{Agg::Sum, 1}, {Agg::Max, 1}});
+    EXPECT_EQ(groups.column_type(1), ColumnType::Double);
+    EXPECT_EQ(groups.column_type(2), ColumnType::Int64);
+    EXPECT_EQ(groups.as_double(0, 1), 2.0 * static_cast<double>(max));
+    EXPECT_EQ(groups.as_double(1, 1), 5.0);
+    EXPECT_EQ(groups.as_int64(0, 2), max);
+
+    // Each block in range, the merged blocks not
+    Selection split(ResultOps::kBlockRows, 1);
+    split[0] = 0;
+    split.push_back(2);
+    QueryResult merged = ResultOps::groupBy(result, 0, {{Agg::Sum, 1}}, &split);
+    EXPECT_EQ(merged.column_type(1), ColumnType::Double);
+    EXPECT_EQ(merged.as_double(0, 1), 2.0 * static_cast<double>(max));
+    EXPECT_EQ(merged.as_double(1, 1), 2.0 * (ResultOps::kBlockRows - 1));
+
+    // Within range the sum stays exact, even past what a double holds exactly
+    Selection exact{0, 1, 3};
+    QueryResult sums = ResultOps::groupBy(result, 0, {{Agg::Sum, 1}}, &exact);
+    EXPECT_EQ(sums.column_type(1), ColumnType::Int64);
+    EXPECT_EQ(sums.as_int64(0, 1), max);
+}
+
+TEST(ResultOpsTest, TopKPutsNullsLast) {
+    QueryResult result = sales();
+    EXPECT_EQ(ResultOps::topK(result, 1, 3), (Selection{1, 5, 2}));
+    EXPECT_EQ(ResultOps::topK(result, 1, 2, true), (Selection{4, 0}));
+    EXPECT_EQ(ResultOps::topK(result, 2, 10, true), (Selection{4, 1, 0, 5, 2, 3}));
+    EXPECT_EQ(ResultOps::topK(result, 0, 4), (Selection{0, 2, 3, 1}));
+
+    Selection west = ResultOps::filter(result, 0, Compare::Eq, "west");
+    EXPECT_EQ(ResultOps::topK(result, 1, 1, false, &west), (Selection{1}));
+    EXPECT_TRUE(ResultOps::topK(result, 1, 0).empty());
+}
+
+TEST(ResultOpsTest, ParallelBlocksMatchSequentialScan) {
+    const size_t n = ResultOps::kParallelRows * 2 + 123;
+    QueryResult result({}, {"bucket", "value"});
+    result.set_column_types({ColumnType::Int64, ColumnType::Int64});
+    for (size_t r = 0; r < n; ++r) {
+        int64_t value = static_cast<int64_t>((r * 7919) % 100003);
+        result.append_row({std::to_string(r % 5), std::to_string(value)});
+    }
+
+    auto values = ResultOps::int64s(result, 1);
+    Selection expected;
+    for (size_t r = 0; r < n; ++r)
+        if (values.values[r] < 5000)
+            expected.push_back(static_cast<uint32_t>(r));
+    Selection small = ResultOps::filter(values, Compare::Lt, 5000);
+    EXPECT_EQ(small, expected);
+
+    QueryResult groups = ResultOps::groupBy(result, 0, {{Agg::Count}, {Agg::Sum, 1}}, &small);
+    ASSERT_EQ(groups.rows(), 5u);
+    std::vector<std::string> order;
+    for (uint32_t r : expected)
+        if (std::find(order.begin(), order.end(), std::to_string(r % 5)) == order.end())
+            order.push_back(std::to_string(r % 5));
+    int64_t count = 0;
+    int64_t sum = 0;
+    for (size_t g = 0; g < groups.rows(); ++g) {
+        EXPECT_EQ(groups.view(g, 0), order[g]);
+        count += std::stoll(std::string(groups.view(g, 1)));
+        sum += std::stoll(std::string(groups.view(g, 2)));
+    }
+    int64_t expected_sum = 0;
+    for (uint32_t r : expected) expected_sum += values.values[r];
+    EXPECT_EQ(count, static_cast<int64_t>(expected.size()));
+    EXPECT_EQ(sum, expected_sum);
+
+    Selection top = ResultOps::topK(result, 1, 3, true);
+    ASSERT_EQ(top.size(), 3u);
+    EXPECT_EQ(values.values[top[0]], 100002);
+    EXPECT_GE(values.values[top[1]], values.values[top[2]]);
+}
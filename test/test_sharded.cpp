@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "factory.h"
+#include "querybuilder/query_builder.h"
+#include "test_helpers.h"
+
+namespace {
+    // Shard s holds ids s, s+3, s+6, ... with score = id * 10
+    std::vector<std::pair<DatabaseType, ConnectionConfig>> createShards(int shards, int rows) {
+        std::vector<std::pair<DatabaseType, ConnectionConfig>> out;
+        for (int s = 0; s < shards; ++s) {
+            ConnectionConfig cfg;
+            cfg.path = "test_shard_" + std::to_string(s) + ".db";
+            std::string sql = "CREATE TABLE users(id INTEGER PRIMARY KEY, score INTEGER);";
+            for (int id = s; id < rows; id += shards)
+                sql += "INSERT INTO users VALUES (" + std::to_string(id) + ", " +
+                       std::to_string(id * 10) + ");";
+            createSQLiteFile(cfg.path, sql);
+            out.emplace_back(DatabaseType::sqlite, cfg);
+        }
+        return out;
+    }
+}  // namespace
+
+TEST(ShardedDatabaseTest, FanOutMergesOrderedWithGlobalLimitOffset) {
+    ShardingPolicy policy;
+    policy.key = "id";
+    auto db = DatabaseFactory::createSharded(createShards(3, 30), policy, testLogger());
+    ASSERT_TRUE(db->open());
+
+    QueryBuilder qb;
+    qb.table("users u")
+        .select("u.id")
+        .select("u.score")
+        .orderBy("u.score DESC")
+        .limit(5)
+        .offset(4);
+    QueryResult res = db->select(qb);
+    ASSERT_EQ(res.rows(), 5u);
+    for (size_t i = 0; i < res.rows(); ++i) EXPECT_EQ(res.at(i, 0).value(), std::to_string(25 - i));
+
+    // Without the sort column the merge cannot order, nor apply LIMIT/OFFSET after it
+    QueryBuilder hidden;
+    hidden.table("users").select("id").orderBy("score").limit(3);
+    EXPECT_TRUE(db->select(hidden).columns().empty());
+    EXPECT_EQ(IDatabase::lastStatus(), QueryStatus::Failed);
+    db->close();
+}
+
+TEST(ShardedDatabaseTest, FanOutMergeOrdersLikeTheShards) {
+    ShardingPolicy policy;
+    policy.key = "id";
+    auto db = DatabaseFactory::createSharded(createShards(3, 0), policy, testLogger());
+    ASSERT_TRUE(db->open());
+    QueryBuilder ins;
+    ins.insertInto("users", {"id", "score"});
+    for (int id = 0; id < 12; ++id)
+        ins.values({std::to_string(id), id % 4 ? QueryBuilder::Param(std::to_string(id * 5))
+                                               : std::nullopt});
+    ASSERT_TRUE(db->insert(ins));
+
+    // SQLite puts NULLs first ascending and compares text by bytes, so "10" < "5"
+    QueryBuilder asc;
+    asc.table("users").select("id").select("CAST(score AS TEXT) AS s").orderBy("s").limit(6);
+    QueryResult res = db->select(asc);
+    ASSERT_EQ(res.rows(), 6u);
+    for (size_t i = 0; i < 3; ++i) EXPECT_TRUE(res.is_null(i, 1));
+    EXPECT_EQ(res.view(3, 1), "10");
+    EXPECT_EQ(res.view(4, 1), "15");
+    EXPECT_EQ(res.view(5, 1), "25");
+
+    QueryBuilder desc = asc;
+    desc.orderBy("s DESC").limit(3);
+    res = db->select(desc);
+    ASSERT_EQ(res.rows(), 3u);
+    EXPECT_EQ(res.view(0, 1), "55");
+    EXPECT_EQ(res.view(1, 1), "50");
+    EXPECT_EQ(res.view(2, 1), "5");
+
+    QueryBuilder nullsLast = asc;
+    nullsLast.orderBy("s NULLS LAST").limit(20).offset(8);
+    res = db->select(nullsLast);
+    ASSERT_EQ(res.rows(), 4u);
+    EXPECT_EQ(res.view(0, 1), "55");
+    EXPECT_TRUE(res.is_null(3, 1));
+    db->close();
+}
+
+TEST(ShardedDatabaseTest, FanOutWithoutOrderReturnsAllRows) {
+    auto db = DatabaseFactory::createSharded(createShards(3, 30), ShardingPolicy{}, testLogger());
+    ASSERT_TRUE(db->open());
+    QueryBuilder qb;
+    qb.table("users");
+    EXPECT_EQ(db->select(qb).rows(), 30u);
+    db->close();
+}
+
+TEST(ShardedDatabaseTest, FanOutFailsWhenAnyShardFails) {
+    auto shards = createShards(2, 10);
+    createSQLiteFile(shards[1].second.path, "CREATE TABLE other(x INTEGER);");
+    auto db = DatabaseFactory::createSharded(shards, ShardingPolicy{}, testLogger());
+    ASSERT_TRUE(db->open());
+    QueryBuilder qb;
+    qb.table("users");
+    EXPECT_TRUE(db->select(qb).columns().empty());
+    EXPECT_EQ(IDatabase::lastStatus(), QueryStatus::Failed);
+    db->close();
+}
+
+TEST(ShardedDatabaseTest, RangePolicyRoutesByKey) {
+    ShardingPolicy policy;
+    policy.kind = ShardingPolicy::Kind::Range;
+    policy.key = "id";
+    policy.range_bounds = {"100", "200"};
+    ShardedDatabase db({}, policy, testLogger());
+    ConnectionConfig cfg;
+    for (int i = 0; i < 3; ++i)
+        db.addShard(DatabaseFactory::createDatabase(DatabaseType::sqlite, cfg, testLogger()));
+
+    EXPECT_EQ(db.shardFor("5"), 0u);
+    EXPECT_EQ(db.shardFor("150"), 1u);
+    EXPECT_EQ(db.shardFor("200"), 2u);
+    EXPECT_EQ(db.shardFor("100000"), 2u);
+}
+
+TEST(ShardedDatabaseTest, WhereEqualityRoutesToOwningShard) {
+    ShardingPolicy policy;
+    policy.key = "id";
+    auto shards = createShards(3, 30);
+    ShardedDatabase db({}, policy, testLogger());
+    for (const auto& [type, cfg] : shards)
+        db.addShard(DatabaseFactory::createDatabase(type, cfg, testLogger()));
+    ASSERT_TRUE(db.open());
+
+    // Rows were placed round-robin, so a routed lookup only finds ids its shard owns
+    for (int id = 0; id < 30; ++id) {
+        QueryBuilder qb;
+        qb.table("users u").where("u.id = " + std::to_string(id));
+        size_t expected = db.shardFor(std::to_string(id)) == static_cast<size_t>(id % 3) ? 1 : 0;
+        EXPECT_EQ(db.select(qb).rows(), expected);
+    }
+
+    QueryBuilder bound;
+    bound.table("users").whereEquals("id", "7");
+    EXPECT_EQ(db.select(bound).rows(), db.shardFor("7") == 1 ? 1u : 0u);
+
+    // Anything but `key = literal` fans out to every shard
+    QueryBuilder either;
+    either.table("users u").where("u.id = 1 OR u.id = 2");
+    EXPECT_EQ(db.select(either).rows(), 2u);
+    QueryBuilder column;
+    column.table("users").where("id = score / 10");
+    EXPECT_EQ(db.select(column).rows(), 30u);
+    db.close();
+}
+
+TEST(ShardedDatabaseTest, MultiRowInsertSplitsByKeyColumn) {
+    ShardingPolicy policy;
+    policy.key = "id";
+    auto shards = createShards(3, 0);
+    ShardedDatabase db({}, policy, testLogger());
+    for (const auto& [type, cfg] : shards)
+        db.addShard(DatabaseFactory::createDatabase(type, cfg, testLogger()));
+    ASSERT_TRUE(db.open());
+
+    QueryBuilder ins;
+    ins.insertInto("users", {"id", "score"});
+    for (int id = 100; id < 130; ++id) ins.values({std::to_string(id), "1"});
+    ASSERT_TRUE(db.insert(ins));
+
+    // Every row is found again through routed lookups
+    for (int id = 100; id < 130; ++id) {
+        QueryBuilder qb;
+        qb.table("users").where("id = " + std::to_string(id));
+        EXPECT_EQ(db.select(qb).rows(), 1u);
+    }
+
+    // Upserts are split the same way and report the affected rows of every shard
+    ins.values({"130", "1"}).onConflict({"id"}).doUpdate();
+    EXPECT_EQ(db.upsert(ins), std::optional<size_t>(31));
+    db.close();
+}
+
+TEST(ShardedDatabaseTest, ConsistentHashingMovesFewKeysOnResize) {
+    ConnectionConfig cfg;
+    ShardedDatabase db({}, ShardingPolicy{}, testLogger());
+    for (int i = 0; i < 4; ++i)
+        db.addShard(DatabaseFactory::createDatabase(DatabaseType::sqlite, cfg, testLogger()));
+
+    std::vector<size_t> before;
+    for (int k = 0; k < 10000; ++k) before.push_back(db.shardFor("key" + std::to_string(k)));
+
+    db.addShard(DatabaseFactory::createDatabase(DatabaseType::sqlite, cfg, testLogger()));
+    int moved = 0;
+    for (int k = 0; k < 10000; ++k) {
+        size_t now = db.shardFor("key" + std::to_string(k));
+        if (now != before[k]) {
+            EXPECT_EQ(now, 4u);  // keys only move to the new shard
+            ++moved;
+        }
+    }
+    EXPECT_GT(moved, 1000);
+    EXPECT_LT(moved, 3500);
+
+    // No ring points: nothing to route to
+    ShardingPolicy pointless;
+    pointless.virtual_nodes = 0;
+    ShardedDatabase empty({}, pointless, testLogger());
+    empty.addShard(DatabaseFactory::createDatabase(DatabaseType::sqlite, cfg, testLogger()));
+    EXPECT_FALSE(empty.open());
+    EXPECT_THROW(empty.shardFor("key"), std::logic_error);
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <memory>
+
+#include "diagnostics/slow_query_log.h"
+#include "factory.h"
+#include "querybuilder/query_builder.h"
+#include "test_helpers.h"
+
+namespace {
+    const char* kPath = "test_slow_query_log.db";
+
+}  // namespace
+
+TEST(SlowQueryLogTest, FingerprintReplacesLiterals) {
+    std::vector<std::string> params;
+    std::string fp = SlowQueryLog::fingerprint(
+        "SELECT  name FROM t1 WHERE id = 42 AND note = 'it''s'\n AND x > -1.5", &params);
+    EXPECT_EQ(fp, "SELECT name FROM t1 WHERE id = ? AND note = ? AND x > ?");
+    EXPECT_EQ(params, (std::vector<std::string>{"42", "it's", "-1.5"}));
+
+    // Placeholders past any bound value stay unbound, however long their number
+    params.clear();
+    fp = SlowQueryLog::fingerprint("SELECT $1, $0, $99999999999999999999999", &params,
+                                   SlowQueryLog::Params{"a"});
+    EXPECT_EQ(fp, "SELECT $1, $0, $99999999999999999999999");
+    EXPECT_EQ(params, (std::vector<std::string>{"a", "?", "?"}));
+}
+
+TEST(SlowQueryLogTest, RingKeepsNewestRecords) {
+    SlowQueryLog log(std::chrono::microseconds(0), 3);
+    for (int i = 0; i < 5; ++i)
+        log.record("SELECT " + std::to_string(i), {}, std::chrono::microseconds(i), 1, nullptr);
+    auto recent = log.recent();
+    ASSERT_EQ(recent.size(), 3u);
+    EXPECT_EQ(recent.front().id, 2u);
+    EXPECT_EQ(recent.back().params, (std::vector<std::string>{"4"}));
+}
+
+TEST(SlowQueryLogTest, SQLiteQueriesAreRecordedWithPlan) {
+    ASSERT_TRUE(createSQLiteFile(kPath,
+                                 "CREATE TABLE users(id INTEGER PRIMARY KEY, name TEXT);"
+                                 "INSERT INTO users(name) VALUES ('a'), ('b'), ('c');"));
+
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    std::unique_ptr<IDatabase> db =
+        DatabaseFactory::createDatabase(DatabaseType::sqlite, cfg, testLogger());
+    auto log = std::make_shared<SlowQueryLog>(std::chrono::microseconds(0));
+    db->setSlowQueryLog(log);
+    ASSERT_TRUE(db->open());
+
+    QueryBuilder qb;
+    qb.table("users").select("name").where("id > 1");
+    EXPECT_EQ(db->select(qb).rows(), 2u);
+    log->flush();
+
+    auto recent = log->recent();
+    ASSERT_EQ(recent.size(), 1u);
+    EXPECT_EQ(recent[0].fingerprint, "SELECT name FROM users WHERE id > ?");
+    EXPECT_EQ(recent[0].params, (std::vector<std::string>{"1"}));
+    EXPECT_EQ(recent[0].rows, 2u);
+    ASSERT_TRUE(recent[0].plan.has_value());
+    EXPECT_NE(recent[0].plan->find("users"), std::string::npos);
+
+    // Below the threshold nothing is recorded
+    db->setSlowQueryLog(std::make_shared<SlowQueryLog>(std::chrono::seconds(60)));
+    db->select(qb);
+    EXPECT_EQ(log->recent().size(), 1u);
+    db->close();
+    std::remove(kPath);
+
+    // A second connection to :memory: would see an empty database, so no plan is taken
+    ConnectionConfig memory;
+    memory.path = ":memory:";
+    auto inMemory = DatabaseFactory::createDatabase(DatabaseType::sqlite, memory, testLogger());
+    auto memoryLog = std::make_shared<SlowQueryLog>(std::chrono::microseconds(0));
+    inMemory->setSlowQueryLog(memoryLog);
+    ASSERT_TRUE(inMemory->open());
+    QueryBuilder schema;
+    schema.table("sqlite_master").select("name");
+    inMemory->select(schema);
+    memoryLog->flush();
+    ASSERT_EQ(memoryLog->recent().size(), 1u);
+    EXPECT_FALSE(memoryLog->recent()[0].plan.has_value());
+}
@@ -0,0 +1,525 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "cache/result_cache.h"
+#include "export/text_writer.h"
+#include "factory.h"
+#include "keyset_paginator.h"
+#include "querybuilder/query_builder.h"
+#include "sqlite/driver/sqlite3.h"
+#include "sqlite/sqlite_writer.h"
+#include "test_helpers.h"
+
+namespace {
+    const char* kPath = "test_sqlite.db";
+
+    void createUsers(int rows) {
+        std::string sql = "CREATE TABLE users(id INTEGER PRIMARY KEY, name TEXT, email TEXT);";
+        sql += "BEGIN;";
+        for (int i = 1; i <= rows; ++i)
+            sql += "INSERT INTO users(name, email) VALUES ('user" + std::to_string(i) + "', 'user" +
+                   std::to_string(i) + "@mail.com');";
+        ASSERT_TRUE(createSQLiteFile(kPath, sql + "COMMIT;"));
+    }
+}  // namespace
+
+TEST(SQLiteTest, SelectThroughSingleConnection) {
+    createUsers(10);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    auto db = DatabaseFactory::createDatabase(DatabaseType::sqlite, cfg, testLogger());
+    ASSERT_TRUE(db->open());
+
+    QueryBuilder qb;
+    qb.table("users").select("id").select("name").where("id <= 3").orderBy("id");
+    QueryResult res = db->select(qb);
+    ASSERT_EQ(res.rows(), 3u);
+    ASSERT_EQ(res.cols(), 2u);
+    EXPECT_EQ(res.at(2, 1).value(), "user3");
+    EXPECT_EQ(res.column_type(0), ColumnType::Int64);
+    EXPECT_EQ(res.column_type(1), ColumnType::Text);
+    db->close();
+}
+
+TEST(SQLiteTest, ParallelSelectsUseReaderPool) {
+    createUsers(1000);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    cfg.sqlite_readers = 4;
+    auto db = DatabaseFactory::createDatabase(DatabaseType::sqlite, cfg, testLogger());
+    ASSERT_TRUE(db->open());
+
+    std::vector<std::thread> threads;
+    std::vector<size_t> counts(8, 0);
+    for (size_t t = 0; t < counts.size(); ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 50; ++i) {
+                QueryBuilder qb;
+                qb.table("users").where("id > " + std::to_string(t * 100));
+                counts[t] += db->select(qb).rows();
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    for (size_t t = 0; t < counts.size(); ++t) EXPECT_EQ(counts[t], 50 * (1000 - t * 100));
+    db->close();
+}
+
+TEST(SQLiteTest, LazyConnectAndPrepareRaceFromManyThreads) {
+    createUsers(100);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    cfg.sqlite_readers = 3;
+    cfg.sqlite_writer_thread = true;
+    cfg.lazy_connect = true;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+    ASSERT_FALSE(db.is_open());
+
+    // The first queries race to connect; prepare() takes every reader while selects hold some
+    std::vector<std::thread> threads;
+    std::atomic<size_t> rows{0};
+    std::atomic<int> prepared{0};
+    for (int t = 0; t < 6; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 20; ++i) {
+                QueryBuilder qb;
+                qb.table("users").where("id <= " + std::to_string(t + 1));
+                if (t % 2)
+                    prepared += db.prepare(qb);
+                else
+                    rows += db.select(qb).rows();
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    EXPECT_TRUE(db.is_open());
+    EXPECT_EQ(prepared, 60);
+    EXPECT_EQ(rows, 20u * (1 + 3 + 5));
+    db.close();
+    EXPECT_FALSE(db.is_open());
+}
+
+TEST(SQLiteWriterTest, CoalescesConcurrentWritesAndIsolatesFailures) {
+    createUsers(0);
+    sqlite3* conn = nullptr;
+    ASSERT_EQ(sqlite3_open(kPath, &conn), SQLITE_OK);
+
+    std::vector<std::future<bool>> results;
+    {
+        SQLiteWriter writer(conn, testLogger());
+        std::mutex results_mutex;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 100; ++i) {
+                    std::string sql = "INSERT INTO users(id, name) VALUES (" +
+                                      std::to_string(t * 1000 + i) + ", 'w')";
+                    auto fut = writer.submit([sql](sqlite3* c) {
+                        return sqlite3_exec(c, sql.c_str(), nullptr, nullptr, nullptr) ==
+                               SQLITE_OK;
+                    });
+                    std::lock_guard<std::mutex> lock(results_mutex);
+                    results.push_back(std::move(fut));
+                }
+            });
+        }
+        for (auto& th : threads) th.join();
+
+        // Duplicate primary key: only this request fails, the batch still commits
+        auto dup = writer.submit([](sqlite3* c) {
+            return sqlite3_exec(c, "INSERT INTO users(id, name) VALUES (0, 'dup')", nullptr,
+                                nullptr, nullptr) == SQLITE_OK;
+        });
+        EXPECT_FALSE(dup.get());
+    }
+
+    for (auto& fut : results) EXPECT_TRUE(fut.get());
+
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(conn, "SELECT COUNT(*) FROM users", -1, &stmt, nullptr);
+    ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+    EXPECT_EQ(sqlite3_column_int(stmt, 0), 400);
+    sqlite3_finalize(stmt);
+    sqlite3_close(conn);
+}
+
+TEST(SQLiteWriterTest, WriteInterruptedMidBatchFailsWhatWasRolledBack) {
+    createUsers(0);
+    sqlite3* conn = nullptr;
+    ASSERT_EQ(sqlite3_open(kPath, &conn), SQLITE_OK);
+    auto insert = [](int id) {
+        return [id](sqlite3* c) {
+            std::string sql =
+                "INSERT INTO users(id, name) VALUES (" + std::to_string(id) + ", 'w')";
+            return sqlite3_exec(c, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+        };
+    };
+
+    std::future<bool> before, interrupted, after, thrown;
+    {
+        SQLiteWriter writer(conn, testLogger());
+        // Holds the writer thread until the next four are queued, so they form one batch
+        std::promise<void> started, gate;
+        auto blocker = writer.submit(
+            [&started, released = gate.get_future().share()](sqlite3*) {
+                started.set_value();
+                released.wait();
+                return true;
+            },
+            false);
+        started.get_future().wait();
+
+        before = writer.submit(insert(1));
+        // An interrupted write makes SQLite roll back the whole batch transaction
+        interrupted = writer.submit([](sqlite3* c) {
+            sqlite3_progress_handler(c, 1, [](void*) { return 1; }, nullptr);
+            bool ok = sqlite3_exec(c, "INSERT INTO users(id, name) VALUES (2, 'w')", nullptr,
+                                   nullptr, nullptr) == SQLITE_OK;
+            sqlite3_progress_handler(c, 0, nullptr, nullptr);
+            return ok;
+        });
+        after = writer.submit(insert(3));
+        thrown = writer.submit([](sqlite3*) -> bool { throw std::runtime_error("sink failed"); });
+        gate.set_value();
+        EXPECT_TRUE(blocker.get());
+    }
+
+    EXPECT_FALSE(before.get());
+    EXPECT_FALSE(interrupted.get());
+    EXPECT_TRUE(after.get());
+    EXPECT_THROW(thrown.get(), std::runtime_error);
+
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(conn, "SELECT group_concat(id) FROM users", -1, &stmt, nullptr);
+    ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+    EXPECT_STREQ(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), "3");
+    sqlite3_finalize(stmt);
+    sqlite3_close(conn);
+}
+
+TEST(SQLiteTest, SelectThroughWriterThread) {
+    createUsers(5);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    cfg.sqlite_writer_thread = true;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+
+    QueryBuilder qb;
+    qb.table("users");
+    EXPECT_EQ(db.select(qb).rows(), 5u);
+    db.close();
+}
+
+TEST(SQLiteTest, NullCellsAreTrackedInBitmap) {
+    createUsers(3);
+    sqlite3* raw = nullptr;
+    sqlite3_open(kPath, &raw);
+    sqlite3_exec(raw, "UPDATE users SET email = NULL WHERE id = 2; UPDATE users SET name = '' "
+                      "WHERE id = 3;",
+                 nullptr, nullptr, nullptr);
+    sqlite3_close(raw);
+
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+    QueryBuilder qb;
+    qb.table("users").select("name").select("email").orderBy("id");
+    QueryResult res = db.select(qb);
+    ASSERT_EQ(res.rows(), 3u);
+
+    EXPECT_TRUE(res.is_null(1, 1));
+    EXPECT_FALSE(res.at(1, 1).has_value());
+    EXPECT_FALSE(res.is_null(0, 1));
+    EXPECT_EQ(res.at(0, 1).value(), "user1@mail.com");
+    // Empty string is a value, not NULL
+    EXPECT_FALSE(res.is_null(2, 0));
+    EXPECT_EQ(res.at(2, 0).value(), "");
+    db.close();
+}
+
+TEST(SQLiteTest, StreamRowsIntoCsv) {
+    createUsers(3);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+
+    std::ostringstream out;
+    OstreamSink sink(out);
+    CsvWriter csv(sink);
+    QueryBuilder qb;
+    qb.table("users").select("id").select("name").orderBy("id");
+    ASSERT_TRUE(db.stream(qb, csv));
+    EXPECT_EQ(out.str(), "id,name\r\n1,user1\r\n2,user2\r\n3,user3\r\n");
+    db.close();
+}
+
+TEST(SQLiteTest, SelectSpillsPastMemoryLimit) {
+    createUsers(2000);
+    sqlite3* raw = nullptr;
+    sqlite3_open(kPath, &raw);
+    sqlite3_exec(raw, "UPDATE users SET email = NULL WHERE id % 100 = 0;", nullptr, nullptr,
+                 nullptr);
+    sqlite3_close(raw);
+
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    cfg.result_memory_limit = 16 * 1024;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+    QueryBuilder qb;
+    qb.table("users").select("id").select("name").select("email").orderBy("id");
+    QueryResult res = db.select(qb);
+    db.close();
+
+    ASSERT_EQ(res.rows(), 2000u);
+    EXPECT_TRUE(res.spilled());
+    EXPECT_LT(res.memory_rows().size(), res.rows());
+    EXPECT_EQ(res.at(1999, 1).value(), "user2000");
+    EXPECT_TRUE(res.is_null(1999, 2));
+    EXPECT_FALSE(res.at(1999, 2).has_value());
+    EXPECT_EQ(res.at(1998, 2).value(), "user1999@mail.com");
+
+    size_t seen = 0;
+    for (const QueryResult::Row& row : res) {
+        ++seen;
+        EXPECT_EQ(row[0], std::to_string(seen));
+    }
+    EXPECT_EQ(seen, 2000u);
+
+    // Copies share the spill file and stay readable; one that writes moves to its own file
+    QueryResult copy = res;
+    EXPECT_EQ(copy.row(1500)[1], "user1501");
+    std::string_view last = res.view(1999, 1);
+    copy.set_null(1999, 1);
+    copy.append_row({"2001", "extra", "x"});
+    EXPECT_TRUE(copy.is_null(1999, 1));
+    EXPECT_EQ(copy.view(2000, 1), "extra");
+    EXPECT_EQ(last, "user2000");
+    EXPECT_EQ(res.view(1999, 1), "user2000");
+    EXPECT_EQ(res.rows(), 2000u);
+}
+
+TEST(SQLiteTest, KeysetPaginatorWalksWholeTable) {
+    createUsers(250);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+
+    // Composite key: names are not unique in general, the id breaks ties
+    QueryBuilder qb;
+    qb.table("users").select("name");
+    KeysetPaginator pages(db, qb, {"name", "id"}, 100);
+
+    std::vector<std::string> names;
+    int pageCount = 0;
+    while (!pages.done()) {
+        QueryResult page = pages.next();
+        ++pageCount;
+        for (size_t r = 0; r < page.rows(); ++r) names.push_back(page.at(r, 0).value());
+    }
+    db.close();
+
+    EXPECT_EQ(pageCount, 3);
+    ASSERT_EQ(names.size(), 250u);
+    EXPECT_TRUE(std::is_sorted(names.begin(), names.end()));
+    EXPECT_EQ(std::adjacent_find(names.begin(), names.end()), names.end());
+}
+
+TEST(SQLiteTest, BulkInsertSplitsPastVariableLimit) {
+    createUsers(0);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+
+    // 3 x 20000 values is past SQLite's default limit of 32766 bound variables
+    QueryBuilder bulk;
+    bulk.insertInto("users", {"id", "name", "email"});
+    for (int i = 1; i <= 20000; ++i)
+        bulk.values({std::to_string(i), "user" + std::to_string(i), std::nullopt});
+    ASSERT_GT(bulk.getParams().size(), 32766u);
+    ASSERT_TRUE(db.insert(bulk));
+
+    QueryBuilder count;
+    count.table("users").select("COUNT(*)").select("COUNT(email)");
+    QueryResult res = db.select(count);
+    EXPECT_EQ(res.at(0, 0).value(), "20000");
+    EXPECT_EQ(res.at(0, 1).value(), "0");
+
+    // A failing chunk rolls back the chunks before it
+    QueryBuilder dup;
+    dup.insertInto("users", {"id", "name"});
+    for (int i = 30001; i <= 50000; ++i) dup.values({std::to_string(i), "x"});
+    dup.values({"1", "duplicate"});
+    EXPECT_FALSE(db.insert(dup));
+    EXPECT_EQ(db.select(count).at(0, 0).value(), "20000");
+
+    QueryBuilder upd;
+    upd.update("users").set("email", "none").where("id <= 10");
+    ASSERT_TRUE(db.update(upd));
+    QueryBuilder del;
+    del.deleteFrom("users").where("id > 100");
+    ASSERT_TRUE(db.remove(del));
+    res = db.select(count);
+    EXPECT_EQ(res.at(0, 0).value(), "100");
+    EXPECT_EQ(res.at(0, 1).value(), "10");
+    db.close();
+}
+
+TEST(SQLiteTest, UpsertInsertsOrUpdatesByKey) {
+    createUsers(3);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+
+    // id 2 exists and is updated, id 9 is new; email keeps its old value on conflict
+    QueryBuilder qb;
+    qb.insertInto("users", {"id", "name", "email"})
+        .values({"2", "bea", "bea@mail.com"})
+        .values({"9", "ida", std::nullopt})
+        .onConflict({"id"})
+        .doUpdate({"name"});
+    EXPECT_EQ(db.upsert(qb), std::optional<size_t>(2));
+
+    QueryBuilder check;
+    check.table("users").select("name").select("email").where("id IN (2, 9)").orderBy("id");
+    QueryResult res = db.select(check);
+    ASSERT_EQ(res.rows(), 2u);
+    EXPECT_EQ(res.at(0, 0).value(), "bea");
+    EXPECT_EQ(res.at(0, 1).value(), "user2@mail.com");
+    EXPECT_EQ(res.at(1, 0).value(), "ida");
+
+    // DO NOTHING skips existing keys and does not count them
+    QueryBuilder skip;
+    skip.insertInto("users", {"id", "name"})
+        .values({"1", "zed"})
+        .values({"10", "jo"})
+        .onConflict({"id"})
+        .doNothing();
+    EXPECT_EQ(db.upsert(skip), std::optional<size_t>(1));
+
+    QueryBuilder bad;
+    bad.insertInto("users", {"id", "name"}).values({"1", "x"}).onConflict({"name"}).doNothing();
+    EXPECT_EQ(db.upsert(bad), std::nullopt);  // no unique index on name
+
+    QueryBuilder untargeted;
+    untargeted.insertInto("users", {"id", "name"}).values({"1", "x"}).doUpdate();
+    EXPECT_EQ(db.upsert(untargeted), std::nullopt);
+    EXPECT_EQ(db.select(check).at(0, 0).value(), "bea");
+    db.close();
+}
+
+TEST(SQLiteTest, ChangeStreamReportsCommittedRows) {
+    for (bool writerThread : {false, true}) {
+        createUsers(3);
+        ConnectionConfig cfg;
+        cfg.path = kPath;
+        cfg.sqlite_writer_thread = writerThread;
+        SQLite db(cfg, testLogger());
+        ASSERT_TRUE(db.open());
+
+        std::mutex mutex;
+        std::vector<std::vector<SQLiteChange>> seen;
+        uint64_t id = db.subscribe([&](const std::vector<SQLiteChange>& changes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen.push_back(changes);
+        });
+
+        QueryBuilder ins;
+        ins.insertInto("users", {"id", "name"}).values({"10", "a"}).values({"11", "b"});
+        ASSERT_TRUE(db.insert(ins));
+        QueryBuilder dup;
+        dup.insertInto("users", {"id", "name"}).values({"12", "c"}).values({"1", "dup"});
+        EXPECT_FALSE(db.insert(dup));  // row 12 is rolled back with the statement
+        QueryBuilder upd;
+        upd.update("users").set("name", "z").where("id = 2");
+        ASSERT_TRUE(db.update(upd));
+        QueryBuilder all;
+        all.deleteFrom("users");
+        ASSERT_TRUE(db.remove(all));
+        db.close();  // drains the writer thread
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ASSERT_EQ(seen.size(), 3u);
+        ASSERT_EQ(seen[0].size(), 2u);
+        EXPECT_EQ(seen[0][1].op, SQLiteChange::Op::Insert);
+        EXPECT_EQ(seen[0][1].table, "users");
+        EXPECT_EQ(seen[0][1].rowid, 11);
+        ASSERT_EQ(seen[1].size(), 1u);
+        EXPECT_EQ(seen[1][0].op, SQLiteChange::Op::Update);
+        EXPECT_EQ(seen[1][0].rowid, 2);
+        EXPECT_EQ(seen[2].size(), 5u);  // a bare DELETE still reports every row
+        EXPECT_EQ(seen[2][0].op, SQLiteChange::Op::Delete);
+        db.unsubscribe(id);
+    }
+}
+
+TEST(SQLiteTest, ChangeStreamInvalidatesResultCache) {
+    createUsers(3);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+    ResultCache cache(std::chrono::hours(1));
+    db.invalidates(cache);
+
+    QueryBuilder count;
+    count.table("users").select("COUNT(*)");
+    EXPECT_EQ(cache.select(db, count).at(0, 0).value(), "3");
+    QueryBuilder ins;
+    ins.insertInto("users", {"name"}).values({"new"});
+    ASSERT_TRUE(db.insert(ins));
+    EXPECT_EQ(cache.select(db, count).at(0, 0).value(), "4");
+    db.close();
+}
+
+TEST(SQLiteTest, TimeoutAndCancellationInterruptQuery) {
+    createUsers(400);
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    SQLite db(cfg, testLogger());
+    ASSERT_TRUE(db.open());
+
+    // 400^3 joined rows take seconds to count
+    QueryBuilder slow;
+    slow.table("users a, users b, users c").select("COUNT(*)");
+    slow.timeout(std::chrono::milliseconds(20));
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(db.select(slow).columns().empty());
+    EXPECT_EQ(IDatabase::lastStatus(), QueryStatus::TimedOut);
+
+    CancellationToken token;
+    QueryBuilder cancelled;
+    cancelled.table("users a, users b, users c").select("COUNT(*)").cancelledBy(token);
+    std::thread canceller([token]() mutable {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        token.cancel();
+    });
+    EXPECT_TRUE(db.select(cancelled).columns().empty());
+    canceller.join();
+    EXPECT_EQ(IDatabase::lastStatus(), QueryStatus::Cancelled);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+
+    // The connection stays usable
+    QueryBuilder count;
+    count.table("users").select("COUNT(*)").timeout(std::chrono::seconds(5));
+    EXPECT_EQ(db.select(count).at(0, 0).value(), "400");
+    EXPECT_EQ(IDatabase::lastStatus(), QueryStatus::Ok);
+    db.close();
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "factory.h"
+#include "querybuilder/query_builder.h"
+#include "test_helpers.h"
+#include "warmup.h"
+
+namespace {
+    const char* kPath = "test_warmup.db";
+
+    void createUsers() {
+        createSQLiteFile(kPath,
+                         "CREATE TABLE users(id INTEGER PRIMARY KEY, name TEXT);"
+                         "INSERT INTO users(name) VALUES ('alice'), ('bob');");
+    }
+
+    QueryBuilder userById() {
+        QueryBuilder qb;
+        qb.table("users").select("name").where("id = 1");
+        return qb;
+    }
+}  // namespace
+
+TEST(WarmupTest, OpensInParallelAndReportsReadiness) {
+    createUsers();
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    cfg.sqlite_readers = 2;
+    SQLite sqlite(cfg, testLogger());
+    MockDatabase mock(ConnectionConfig{}, testLogger());
+    QueryBuilder missing;
+    missing.table("no_such_table").select("id");
+
+    WarmupReport report = warmUp({&sqlite, &mock}, {userById(), missing});
+    ASSERT_EQ(report.databases.size(), 2u);
+    EXPECT_TRUE(report.databases[0].opened);
+    EXPECT_TRUE(report.databases[0].connected);
+    EXPECT_EQ(report.databases[0].prepared, 1u);
+    EXPECT_EQ(report.databases[0].failed, 1u);
+    EXPECT_EQ(report.databases[1].prepared, 2u);
+    EXPECT_FALSE(report.ready());
+
+    EXPECT_TRUE(warmUp({&sqlite, &mock}, {userById()}).ready());
+    EXPECT_EQ(sqlite.select(userById()).at(0, 0).value(), "alice");
+    sqlite.close();
+}
+
+TEST(WarmupTest, LazyConnectWaitsForFirstQuery) {
+    createUsers();
+    ConnectionConfig cfg;
+    cfg.path = kPath;
+    cfg.lazy_connect = true;
+    SQLite db(cfg, testLogger());
+
+    WarmupReport report = warmUp({&db}, {userById()});
+    ASSERT_EQ(report.databases.size(), 1u);
+    EXPECT_TRUE(report.databases[0].opened);
+    EXPECT_FALSE(report.databases[0].connected);
+    EXPECT_TRUE(report.ready());
+    EXPECT_FALSE(db.is_open());
+
+    EXPECT_EQ(db.select(userById()).at(0, 0).value(), "alice");
+    EXPECT_TRUE(db.is_open());
+    db.close();
+}